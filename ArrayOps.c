@@ -0,0 +1,267 @@
+/* ArrayOps.c */
+
+/*
+   Operations on whole ranges of array elements.
+
+   The natives System.arraycopy and Arrays.fill check their arguments
+   once, then work directly on the elements of an ArrayOfSimple or an
+   ArrayOfRef: a copy is a memmove, and a fill stores one element and
+   then doubles the filled part with memcpy until the range is full.
+
+   The same kernels run the copy and fill loops found by the pre-decoder
+   (see ArrayLoop in ArrayOps.h).  When the interpreter reaches the head
+   of such a loop, RunArrayLoop performs every remaining iteration which
+   cannot throw an exception, in one step, and advances the loop index
+   past them.  The loop then continues normally: it exits at once, or
+   executes the iteration which throws.
+
+   Bulk stores of references call GC_WRITE_BARRIER, as aastore does.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "InterpretLoop.h"
+#include "MyAlloc.h"
+#include "NativeClasses.h"
+#include "ArrayOps.h"
+
+/* statistics */
+static long numCopies = 0, numElementsCopied = 0;
+static long numFills = 0, numElementsFilled = 0;
+static long numLoopRuns = 0, numLoopElements = 0;
+
+
+/* Returns the number of elements of the array obj, and sets *elems and
+   *elemSize to the address and size of its elements; returns -1 if obj
+   is not an array */
+static int arrayElements( void *obj, uint8_t **elems, int *elemSize ) {
+    *elems = NULL;
+    *elemSize = 0;
+    switch(*(uint32_t *)obj) {
+    case CODE_ARRS:
+        *elems = ((ArrayOfSimple *)obj)->u.bval;
+        *elemSize = ((ArrayOfSimple *)obj)->elemSize;
+        return ((ArrayOfSimple *)obj)->size;
+    case CODE_ARRA:
+        *elems = (uint8_t *)((ArrayOfRef *)obj)->elements;
+        *elemSize = sizeof(HeapPointer);
+        return ((ArrayOfRef *)obj)->size;
+    }
+    return -1;
+}
+
+
+/* Stores count copies of an element, whose bits are the low elemSize
+   bytes of value, at elems */
+static void fillElements( uint8_t *elems, int elemSize, int count, int64_t value ) {
+    int filled, n;
+
+    if (count <= 0)
+        return;
+    switch(elemSize) {
+    case 1:
+        memset(elems, (int)value, count);
+        return;
+    case 2:
+        *(int16_t *)elems = (int16_t)value;
+        break;
+    case 4:
+        *(int32_t *)elems = (int32_t)value;
+        break;
+    default:
+        *(int64_t *)elems = value;
+        break;
+    }
+    for( filled = 1;  filled < count;  filled += n ) {
+        n = (filled < count - filled)? filled : count - filled;
+        memcpy(elems + filled*elemSize, elems, n*elemSize);
+    }
+}
+
+
+/* Returns the value of a fill held in one or two stack items */
+static int64_t fillValue( DataItem *d, int elemSize ) {
+    union { int64_t lval;  uint32_t uval[2]; } pair;
+    if (elemSize < 8)
+        return d[0].ival;
+    pair.uval[0] = d[0].uval;
+    pair.uval[1] = d[1].uval;
+    return pair.lval;
+}
+
+
+/* Returns the array loop whose head is at offset pc of method m */
+ArrayLoop *FindArrayLoop( method_info *m, int pc ) {
+    int i;
+    for( i = 0;  i < m->numArrayLoops;  i++ ) {
+        if (m->arrayLoops[i].pc == pc)
+            return &m->arrayLoops[i];
+    }
+    assert(0);
+    return NULL;
+}
+
+
+/* Performs the iterations of the loop, from the current value of its
+   index, which store within the bounds of the arrays */
+void RunArrayLoop( ArrayLoop *loop, DataItem *locals ) {
+    int i = locals[loop->index].ival;
+    int bound, n, elemSize, srcElemSize;
+    uint8_t *dest, *src;
+    void *obj;
+
+    if (loop->boundIsLength) {
+        if (locals[loop->bound].pval == NULL_HEAP_REFERENCE)
+            return;
+        bound = arrayElements(REAL_HEAP_POINTER(locals[loop->bound].pval),
+            &dest, &elemSize);
+    } else
+        bound = locals[loop->bound].ival;
+    if (i < 0 || i >= bound || locals[loop->dest].pval == NULL_HEAP_REFERENCE)
+        return;
+    obj = REAL_HEAP_POINTER(locals[loop->dest].pval);
+    n = arrayElements(obj, &dest, &elemSize);
+    if (n < bound)
+        bound = n;
+    if (loop->kind == LOOP_COPY) {
+        if (locals[loop->src].pval == NULL_HEAP_REFERENCE)
+            return;
+        n = arrayElements(REAL_HEAP_POINTER(locals[loop->src].pval),
+            &src, &srcElemSize);
+        if (srcElemSize != elemSize)
+            return;
+        if (n < bound)
+            bound = n;
+    }
+    n = bound - i;
+    if (n <= 0)
+        return;
+    if (loop->kind == LOOP_COPY)
+        memmove(dest + i*elemSize, src + i*elemSize, n*elemSize);
+    else
+        fillElements(dest + i*elemSize, elemSize, n, fillValue(
+            loop->valueIsLocal? &locals[loop->src] : loop->constant, elemSize));
+    if (*(uint32_t *)obj == CODE_ARRA)
+        GC_WRITE_BARRIER(obj);
+    locals[loop->index].ival = i + n;
+    numLoopRuns++;
+    numLoopElements += n;
+}
+
+
+/* java/lang/System.arraycopy(Object src, int srcPos, Object dest,
+   int destPos, int length) */
+static void systemArraycopy() {
+    int length = JVM_Pop();
+    int destPos = JVM_Pop();
+    HeapPointer destRef = JVM_PopReference();
+    int srcPos = JVM_Pop();
+    HeapPointer srcRef = JVM_PopReference();
+    uint8_t *src, *dest;
+    int srcSize, destSize, srcElemSize, destElemSize;
+    void *srcObj, *destObj;
+
+    if (srcRef == NULL_HEAP_REFERENCE || destRef == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", "arraycopy", "java/lang/System");
+    srcObj = REAL_HEAP_POINTER(srcRef);
+    destObj = REAL_HEAP_POINTER(destRef);
+    srcSize = arrayElements(srcObj, &src, &srcElemSize);
+    destSize = arrayElements(destObj, &dest, &destElemSize);
+    if (srcSize < 0 || destSize < 0
+            || *(uint32_t *)srcObj != *(uint32_t *)destObj
+            || (*(uint32_t *)srcObj == CODE_ARRS &&
+                ((ArrayOfSimple *)srcObj)->typecode != ((ArrayOfSimple *)destObj)->typecode))
+        throwExceptionExternal("ArrayStoreException", "arraycopy", "java/lang/System");
+    if (srcPos < 0 || destPos < 0 || length < 0
+            || srcPos > srcSize - length || destPos > destSize - length)
+        throwExceptionExternal("ArrayIndexOutOfBoundsException", "arraycopy",
+            "java/lang/System");
+    memmove(dest + destPos*destElemSize, src + srcPos*srcElemSize, length*srcElemSize);
+    if (*(uint32_t *)destObj == CODE_ARRA)
+        GC_WRITE_BARRIER(destObj);
+    numCopies++;
+    numElementsCopied += length;
+}
+
+
+/* java/util/Arrays.fill(a, v) and Arrays.fill(a, fromIndex, toIndex, v)
+   for arrays of every type; v occupies one or two stack items */
+static void arraysFill( int valueWords, int ranged ) {
+    DataItem value[2];
+    int from = 0, to = 0, size, elemSize;
+    HeapPointer arrRef;
+    uint8_t *elems;
+    void *obj;
+
+    value[1].uval = 0;
+    if (valueWords == 2)
+        value[1].uval = JVM_Pop();
+    value[0].uval = JVM_Pop();
+    if (ranged) {
+        to = JVM_Pop();
+        from = JVM_Pop();
+    }
+    arrRef = JVM_PopReference();
+    if (arrRef == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", "fill", "java/util/Arrays");
+    obj = REAL_HEAP_POINTER(arrRef);
+    size = arrayElements(obj, &elems, &elemSize);
+    assert(size >= 0);
+    if (!ranged)
+        to = size;
+    else if (from > to)
+        throwExceptionExternal("IllegalArgumentException", "fill", "java/util/Arrays");
+    else if (from < 0 || to > size)
+        throwExceptionExternal("ArrayIndexOutOfBoundsException", "fill",
+            "java/util/Arrays");
+    fillElements(elems + from*elemSize, elemSize, to - from, fillValue(value, elemSize));
+    if (*(uint32_t *)obj == CODE_ARRA)
+        GC_WRITE_BARRIER(obj);
+    numFills++;
+    numElementsFilled += to - from;
+}
+
+static void arraysFill1()       { arraysFill(1, 0); }
+static void arraysFill2()       { arraysFill(2, 0); }
+static void arraysFillRange1()  { arraysFill(1, 1); }
+static void arraysFillRange2()  { arraysFill(2, 1); }
+
+
+void RegisterArrayNatives() {
+    static char *oneWord[] = { "Z", "B", "C", "S", "I", "F", "Ljava/lang/Object;", NULL };
+    static char *twoWords[] = { "J", "D", NULL };
+    static char descr[2][9][2][64];
+    char **types;
+    int w, i;
+
+    RegisterNative("java/lang/System", "arraycopy",
+        "(Ljava/lang/Object;ILjava/lang/Object;II)V", systemArraycopy);
+    for( w = 0;  w < 2;  w++ ) {
+        types = (w == 0)? oneWord : twoWords;
+        for( i = 0;  types[i] != NULL;  i++ ) {
+            snprintf(descr[w][i][0], 64, "([%s%s)V", types[i], types[i]);
+            snprintf(descr[w][i][1], 64, "([%sII%s)V", types[i], types[i]);
+            RegisterNative("java/util/Arrays", "fill", descr[w][i][0],
+                (w == 0)? arraysFill1 : arraysFill2);
+            RegisterNative("java/util/Arrays", "fill", descr[w][i][1],
+                (w == 0)? arraysFillRange1 : arraysFillRange2);
+        }
+    }
+}
+
+
+void PrintArrayOpStatistics() {
+    printf("\nArray Operation Statistics\n==========================\n\n");
+    printf("  Number of arraycopy calls = %ld (%ld elements)\n",
+        numCopies, numElementsCopied);
+    printf("  Number of Arrays.fill calls = %ld (%ld elements)\n",
+        numFills, numElementsFilled);
+    printf("  Number of copy and fill loops run in bulk = %ld (%ld elements)\n",
+        numLoopRuns, numLoopElements);
+}
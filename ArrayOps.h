@@ -0,0 +1,42 @@
+/* ArrayOps.h */
+
+#ifndef ARRAYOPSH
+
+#define ARRAYOPSH
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+
+/* values for the kind field of an ArrayLoop */
+typedef enum {
+    LOOP_FILL,          /* d[i] = v, where v does not change */
+    LOOP_COPY           /* d[i] = s[i] */
+} ArrayLoopKind;
+
+/* A loop of one of these shapes, found by the pre-decoder:
+       L: iload i; <bound>; if_icmpge E
+          aload d; iload i; <value>; <t>astore
+          iinc i 1; goto L
+       E:
+   where <bound> is "aload a; arraylength" or "iload n", and <value> is
+   a load of a local variable or a constant (a fill loop) or is
+   "aload s; iload i; <t>aload" (a copy loop). */
+typedef struct ArrayLoop {
+    u2  pc;             /* offset of L */
+    u1  kind;           /* LOOP_FILL or LOOP_COPY */
+    u1  headLength;     /* # bytes of the iload at L */
+    u1  boundIsLength;  /* true => the bound is the length of array bound */
+    u1  valueIsLocal;   /* true => a fill value is in local src */
+    u2  index;          /* the locals holding i, ... */
+    u2  bound;          /* ... n or a, ... */
+    u2  dest;           /* ... d, ... */
+    u2  src;            /* ... and s or the fill value */
+    DataItem constant[2];   /* a constant fill value */
+} ArrayLoop;
+
+extern ArrayLoop *FindArrayLoop( method_info *m, int pc );
+extern void RunArrayLoop( ArrayLoop *loop, DataItem *locals );
+extern void RegisterArrayNatives();
+extern void PrintArrayOpStatistics();
+
+#endif
@@ -0,0 +1,780 @@
+/* BoundsCheck.c */
+
+/*
+   Removes the null and bounds checks of array accesses which cannot fail.
+
+   After a class has been verified, the bytecode of each method which
+   accesses arrays is analysed by abstract interpretation, much as the
+   verifier analyses types, but tracking facts about int values.  For
+   each local variable and operand stack item, the analysis records
+   whether the value is known to be a constant, whether it is >= 0,
+   whether it is the length of the array held in some local variable a,
+   and whether it is less than the length of that array.  Such facts
+   come from
+       iconst, bipush, sipush, ldc    -- constants
+       arraylength                    -- the length of an array
+       if<cond>, if_icmp<cond>        -- the condition, on each edge
+       iinc, iadd, isub, iand         -- the simple cases
+   and an item on the stack also records the local variable it was loaded
+   from, if it still holds the same value.  A store into a local variable
+   kills every fact which refers to it.  Where paths join, only the facts
+   which hold on every path are kept, and a handler starts with none.
+
+   An <t>aload or <t>astore whose array was loaded from local a and
+   whose index is known to be >= 0 and less than a.length cannot throw;
+   the arraylength which established the bound would already have thrown
+   if a were null.  In the pre-decoded code, such an instruction becomes
+   OP_<t>aload_quick or OP_<t>astore_quick, which the interpreter and
+   the JIT execute without any check.  The typical loop
+       for (i = 0;  i < a.length;  i++) ... a[i] ...
+   needs no checks, nor do the variants where a.length is first saved in
+   a local variable, or where the loop counts down from a.length-1 to 0.
+
+   The same analysis tracks which references are known not to be null:
+   this, the result of new, newarray, anewarray and multianewarray, a
+   String constant, and a reference which has already been dereferenced
+   by an array access, arraylength, getfield, putfield or a method call,
+   or tested by ifnull or ifnonnull.  A store into a local variable
+   forgets what was known about it, as above.  An array access whose
+   array is known not to be null, but whose index is not known to be in
+   bounds, becomes OP_<t>aload_nonnull or OP_<t>astore_nonnull, which
+   check only the index; an arraylength of such an array becomes
+   OP_arraylength_quick.  So in
+       for (i = 0;  i < n;  i++) a[i] = a[i] + b[i];
+   the store into a[i] is not checked for null, nor is any access of
+   this or of an array which was just created.
+
+   Methods which use jsr, ret or wide are not analysed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "ReadClassFile.h"
+#include "OpcodeSignatures.h"
+#include "TraceOptions.h"
+#include "MyAlloc.h"
+#include "BoundsCheck.h"
+
+/* statistics */
+static int numAccesses = 0;         /* # array accesses analysed */
+static int numChecksRemoved = 0;    /* ... which are executed unchecked */
+static int numNullChecks = 0;       /* # accesses and arraylengths analysed */
+static int numNullChecksRemoved = 0;    /* ... which need no null check */
+static int numMethodsSkipped = 0;   /* # methods which were not analysed */
+
+#define NONE (-1)
+
+/* What is known about a value in a local variable or on the stack; the
+   local variables are identified by their indexes, NONE => not known */
+typedef struct {
+    int16_t local;      /* on the stack: the local the value was loaded from */
+    int16_t lengthOf;   /* the local holding an array of this length */
+    int16_t below;      /* the local holding an array longer than this */
+    uint8_t nonNegative;
+    uint8_t isConstant;
+    int32_t constant;
+    uint8_t nonNull;    /* a reference which is known not to be null */
+} Fact;
+
+/* The state of the analysis of one method */
+typedef struct {
+    ClassFile *cf;
+    method_info *m;
+    int numLocals;      /* max_locals; the stack follows the locals */
+    int numSlots;       /* max_locals + max_stack */
+    Fact **facts;       /* the facts before each instruction, NULL => none */
+    int *depth;         /* the stack depth before each instruction */
+    Fact *work;         /* the facts after the instruction being analysed */
+    Fact *saved;        /* a copy of work, while the edges of a branch differ */
+    int changed;        /* true => the facts of some instruction changed */
+    int failed;         /* true => the method cannot be analysed */
+} Analysis;
+
+/* relations tested by a conditional branch, in pairs which negate each other */
+typedef enum { REL_LT, REL_GE, REL_GT, REL_LE, REL_EQ, REL_NE, REL_NONE } Relation;
+
+static Fact unknown = { NONE, NONE, NONE, 0, 0, 0, 0 };
+
+
+static int isArrayAccess( int op ) {
+    return (op >= OP_iaload && op <= OP_saload)
+        || (op >= OP_iastore && op <= OP_sastore);
+}
+
+
+static void setConstant( Fact *f, int32_t c ) {
+    *f = unknown;
+    f->isConstant = 1;
+    f->constant = c;
+    f->nonNegative = c >= 0;
+}
+
+
+/* Updates the facts about a value when c is added to it */
+static void addConstant( Fact *f, int32_t c ) {
+    int64_t v = (int64_t)f->constant + c;
+    int noWrap;
+
+    if (c == 0)
+        return;
+    f->local = NONE;
+    if (c > 0) {
+        /* x < a.length <= INT32_MAX, so x+1 cannot wrap around */
+        noWrap = f->isConstant? v <= INT32_MAX : (f->below != NONE && c == 1);
+        f->nonNegative = f->nonNegative && noWrap;
+        f->below = NONE;
+    } else {
+        noWrap = f->isConstant? v >= INT32_MIN : f->nonNegative;
+        if (!noWrap)
+            f->below = NONE;
+        else if (f->below == NONE)
+            f->below = f->lengthOf;
+        f->nonNegative = 0;
+    }
+    f->lengthOf = NONE;
+    f->isConstant = f->isConstant && noWrap;
+    if (f->isConstant) {
+        f->constant = v;
+        f->nonNegative = v >= 0;
+    }
+}
+
+
+/* Forgets every fact which refers to the value of local x, which is
+   about to change; depth is the current stack depth */
+static void killLocal( Analysis *an, int depth, int x ) {
+    Fact *f = an->work;
+    int i;
+
+    for( i = 0;  i < an->numLocals + depth;  i++, f++ ) {
+        if (f->local == x)    f->local = NONE;
+        if (f->lengthOf == x) f->lengthOf = NONE;
+        if (f->below == x)    f->below = NONE;
+    }
+}
+
+
+/* Stores a value described by v into local x */
+static void storeLocal( Analysis *an, int depth, int x, Fact v ) {
+    killLocal(an, depth, x);
+    if (v.lengthOf == x) v.lengthOf = NONE;
+    if (v.below == x)    v.below = NONE;
+    v.local = NONE;
+    an->work[x] = v;
+}
+
+
+/* Records what is now known about the value of local x: that it is
+   less than the length of the array in local below, and/or that it is
+   non-negative.  Copies of x on the stack are updated too. */
+static void learn( Analysis *an, int depth, int x, int below, int nonNegative ) {
+    Fact *f;
+    int i;
+
+    if (x == NONE)
+        return;
+    for( i = NONE;  i < depth;  i++ ) {
+        f = (i == NONE)? &an->work[x] : &an->work[an->numLocals + i];
+        if (i != NONE && f->local != x)
+            continue;
+        if (below != NONE)
+            f->below = below;
+        if (nonNegative)
+            f->nonNegative = 1;
+    }
+}
+
+
+/* Records that the reference described by f, on the stack, is not null,
+   as is the local variable it was loaded from and any other copy of it */
+static void learnNonNull( Analysis *an, int depth, Fact *f ) {
+    Fact *g = an->work + an->numLocals;
+    int i;
+
+    f->nonNull = 1;
+    if (f->local == NONE)
+        return;
+    an->work[f->local].nonNull = 1;
+    for( i = 0;  i < depth;  i++ ) {
+        if (g[i].local == f->local)
+            g[i].nonNull = 1;
+    }
+}
+
+
+/* Records the consequences of x < y (strict) or x <= y */
+static void lessThan( Analysis *an, int depth, Fact *x, Fact *y, int strict ) {
+    int a = (y->below != NONE)? y->below : strict? y->lengthOf : NONE;
+
+    learn(an, depth, x->local, a, 0);
+    if (x->nonNegative)
+        learn(an, depth, y->local, NONE, 1);
+}
+
+
+/* Records the consequences of x rel y */
+static void relate( Analysis *an, int depth, Relation rel, Fact *x, Fact *y ) {
+    switch(rel) {
+    case REL_LT:  lessThan(an, depth, x, y, 1);  break;
+    case REL_GE:  lessThan(an, depth, y, x, 0);  break;
+    case REL_GT:  lessThan(an, depth, y, x, 1);  break;
+    case REL_LE:  lessThan(an, depth, x, y, 0);  break;
+    case REL_EQ:
+        lessThan(an, depth, x, y, 0);
+        lessThan(an, depth, y, x, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/* Keeps in *f only what is also known in *g; returns true if *f changed */
+static int merge( Fact *f, Fact *g ) {
+    int changed = 0;
+
+    if (f->local != g->local)       { f->local = NONE;  changed = 1; }
+    if (f->lengthOf != g->lengthOf) { f->lengthOf = NONE;  changed = 1; }
+    if (f->below != g->below)       { f->below = NONE;  changed = 1; }
+    if (f->nonNegative && !g->nonNegative) { f->nonNegative = 0;  changed = 1; }
+    if (f->nonNull && !g->nonNull)  { f->nonNull = 0;  changed = 1; }
+    if (f->isConstant && (!g->isConstant || f->constant != g->constant)) {
+        f->isConstant = 0;
+        changed = 1;
+    }
+    return changed;
+}
+
+
+/* Passes the facts in an->work, with depth items on the stack, to the
+   instruction at offset target */
+static void flow( Analysis *an, int target, int depth ) {
+    int n = an->numLocals + depth, i;
+    Fact *f;
+
+    if (target < 0 || target >= an->m->code_length) {
+        an->failed = 1;
+        return;
+    }
+    f = an->facts[target];
+    if (f == NULL) {
+        an->facts[target] = f = SafeMalloc(an->numSlots * sizeof(Fact));
+        memcpy(f, an->work, n * sizeof(Fact));
+        an->depth[target] = depth;
+        an->changed = 1;
+        return;
+    }
+    if (an->depth[target] != depth) {
+        an->failed = 1;
+        return;
+    }
+    for( i = 0;  i < n;  i++ ) {
+        if (merge(&f[i], &an->work[i]))
+            an->changed = 1;
+    }
+}
+
+
+/* Passes the facts to both successors of a conditional branch, adding
+   on each edge the relation between x and y which holds there */
+static void branch( Analysis *an, int depth, Relation taken, Fact *x, Fact *y,
+        int target, int next ) {
+    static Relation negation[] = { REL_GE, REL_LT, REL_LE, REL_GT, REL_NE, REL_EQ, REL_NONE };
+    int n = an->numLocals + depth;
+
+    memcpy(an->saved, an->work, n * sizeof(Fact));
+    relate(an, depth, taken, x, y);
+    flow(an, target, depth);
+    memcpy(an->work, an->saved, n * sizeof(Fact));
+    relate(an, depth, negation[taken], x, y);
+    flow(an, next, depth);
+}
+
+
+static int get2( uint8_t *p ) {
+    return (int16_t)((p[0]<<8) + p[1]);
+}
+
+static int32_t get4( uint8_t *p ) {
+    return (int32_t)(((uint32_t)p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3]);
+}
+
+
+/* Returns the number of stack items occupied by a value of the type
+   whose descriptor begins at s */
+static int typeWords( char *s ) {
+    return (*s == 'V')? 0 : (*s == 'J' || *s == 'D')? 2 : 1;
+}
+
+
+/* Returns the descriptor of the field or method named by the Field,
+   Method or Interface constant at index ix */
+static char *memberDescriptor( ClassFile *cf, int ix ) {
+    int ntIx = cf->cp_item[ix].ss.sval2;
+    return GetUTF8(cf, cf->cp_item[ntIx].ss.sval2);
+}
+
+
+/* Analyses the instruction at offset pc, passing the facts which hold
+   after it to its successors */
+static void analyseInstruction( Analysis *an, int pc ) {
+    ClassFile *cf = an->cf;
+    uint8_t *code = an->m->code, *p = code + pc + 1;
+    int op = code[pc], next = pc + InstructionLength(code, pc);
+    int depth = an->depth[pc], pops = 0, pushes = 0, n, k, ix;
+    Fact *stk = an->work + an->numLocals, x, y;
+    char *descr;
+
+    memcpy(an->work, an->facts[pc], (an->numLocals + depth) * sizeof(Fact));
+    switch(op) {
+    /* constants */
+    case OP_iconst_m1:  case OP_iconst_0:  case OP_iconst_1:  case OP_iconst_2:
+    case OP_iconst_3:   case OP_iconst_4:  case OP_iconst_5:
+        setConstant(&stk[depth++], op - OP_iconst_0);
+        break;
+    case OP_bipush:
+        setConstant(&stk[depth++], (int8_t)p[0]);
+        break;
+    case OP_sipush:
+        setConstant(&stk[depth++], get2(p));
+        break;
+    case OP_ldc:  case OP_ldc_w:
+        ix = (op == OP_ldc)? p[0] : (p[0]<<8) + p[1];
+        stk[depth] = unknown;
+        if (cf->cp_tag[ix] == CP_Integer)
+            setConstant(&stk[depth], cf->cp_item[ix].ival);
+        else if (cf->cp_tag[ix] == CP_String)
+            stk[depth].nonNull = 1;
+        depth++;
+        break;
+    case OP_new:
+        stk[depth] = unknown;
+        stk[depth++].nonNull = 1;
+        break;
+    case OP_aconst_null:
+    case OP_fconst_0:  case OP_fconst_1:  case OP_fconst_2:
+        pushes = 1;
+        break;
+    case OP_lconst_0:  case OP_lconst_1:  case OP_dconst_0:  case OP_dconst_1:
+    case OP_ldc2_w:
+        pushes = 2;
+        break;
+
+    /* local variables */
+    case OP_iload:  case OP_aload:
+    case OP_iload_0:  case OP_iload_1:  case OP_iload_2:  case OP_iload_3:
+    case OP_aload_0:  case OP_aload_1:  case OP_aload_2:  case OP_aload_3:
+        n = (op == OP_iload || op == OP_aload)? p[0] :
+            (op >= OP_aload_0)? op - OP_aload_0 : op - OP_iload_0;
+        x = an->work[n];
+        if (op == OP_aload || op >= OP_aload_0) {
+            x = unknown;
+            x.nonNull = an->work[n].nonNull;
+        }
+        x.local = n;
+        stk[depth++] = x;
+        break;
+    case OP_fload:  case OP_fload_0:  case OP_fload_1:  case OP_fload_2:
+    case OP_fload_3:
+        pushes = 1;
+        break;
+    case OP_lload:  case OP_lload_0:  case OP_lload_1:  case OP_lload_2:
+    case OP_lload_3:
+    case OP_dload:  case OP_dload_0:  case OP_dload_1:  case OP_dload_2:
+    case OP_dload_3:
+        pushes = 2;
+        break;
+    case OP_istore:  case OP_fstore:  case OP_astore:
+    case OP_istore_0:  case OP_istore_1:  case OP_istore_2:  case OP_istore_3:
+    case OP_fstore_0:  case OP_fstore_1:  case OP_fstore_2:  case OP_fstore_3:
+    case OP_astore_0:  case OP_astore_1:  case OP_astore_2:  case OP_astore_3:
+        n = (op == OP_istore || op == OP_fstore || op == OP_astore)? p[0] :
+            (op >= OP_astore_0)? op - OP_astore_0 :
+            (op >= OP_fstore_0)? op - OP_fstore_0 : op - OP_istore_0;
+        x = stk[--depth];
+        y = unknown;
+        if (op == OP_astore || op >= OP_astore_0)
+            y.nonNull = x.nonNull;
+        if (op != OP_istore && (op < OP_istore_0 || op > OP_istore_3))
+            x = y;
+        storeLocal(an, depth, n, x);
+        break;
+    case OP_lstore:  case OP_lstore_0:  case OP_lstore_1:  case OP_lstore_2:
+    case OP_lstore_3:
+    case OP_dstore:  case OP_dstore_0:  case OP_dstore_1:  case OP_dstore_2:
+    case OP_dstore_3:
+        n = (op == OP_lstore || op == OP_dstore)? p[0] :
+            (op >= OP_dstore_0)? op - OP_dstore_0 : op - OP_lstore_0;
+        depth -= 2;
+        storeLocal(an, depth, n, unknown);
+        storeLocal(an, depth, n+1, unknown);
+        break;
+    case OP_iinc:
+        x = an->work[p[0]];
+        addConstant(&x, (int8_t)p[1]);
+        storeLocal(an, depth, p[0], x);
+        break;
+
+    /* arithmetic on ints */
+    case OP_iadd:
+    case OP_isub:
+        y = stk[--depth];
+        x = stk[--depth];
+        if (y.isConstant && (op == OP_iadd || y.constant != INT32_MIN))
+            addConstant(&x, (op == OP_iadd)? y.constant : -y.constant);
+        else if (x.isConstant && op == OP_iadd) {
+            addConstant(&y, x.constant);
+            x = y;
+        } else
+            x = unknown;
+        stk[depth++] = x;
+        break;
+    case OP_iand:
+        /* x & y <= y if y >= 0 */
+        y = stk[--depth];
+        x = stk[--depth];
+        stk[depth] = unknown;
+        if (x.nonNegative || y.nonNegative) {
+            stk[depth].nonNegative = 1;
+            stk[depth].below = y.nonNegative? y.below : x.below;
+            if (stk[depth].below == NONE && x.nonNegative)
+                stk[depth].below = x.below;
+        }
+        depth++;
+        break;
+    case OP_imul:  case OP_idiv:  case OP_irem:  case OP_ishl:  case OP_ishr:
+    case OP_iushr:  case OP_ior:  case OP_ixor:
+    case OP_fadd:  case OP_fsub:  case OP_fmul:  case OP_fdiv:  case OP_frem:
+    case OP_fcmpl:  case OP_fcmpg:
+    case OP_l2i:  case OP_l2f:  case OP_d2i:  case OP_d2f:
+        pops = 2;  pushes = 1;
+        break;
+    case OP_ineg:  case OP_fneg:  case OP_i2b:  case OP_i2c:  case OP_i2s:
+    case OP_i2f:  case OP_f2i:  case OP_instanceof:
+        pops = 1;  pushes = 1;
+        break;
+    case OP_checkcast:
+        break;      /* the reference is unchanged */
+
+    /* arithmetic on longs and doubles */
+    case OP_ladd:  case OP_lsub:  case OP_lmul:  case OP_ldiv:  case OP_lrem:
+    case OP_land:  case OP_lor:  case OP_lxor:
+    case OP_dadd:  case OP_dsub:  case OP_dmul:  case OP_ddiv:  case OP_drem:
+        pops = 4;  pushes = 2;
+        break;
+    case OP_lshl:  case OP_lshr:  case OP_lushr:
+        pops = 3;  pushes = 2;
+        break;
+    case OP_lneg:  case OP_dneg:  case OP_l2d:  case OP_d2l:
+        pops = 2;  pushes = 2;
+        break;
+    case OP_i2l:  case OP_i2d:  case OP_f2l:  case OP_f2d:
+        pops = 1;  pushes = 2;
+        break;
+    case OP_lcmp:  case OP_dcmpl:  case OP_dcmpg:
+        pops = 4;  pushes = 1;
+        break;
+
+    /* arrays */
+    case OP_newarray:  case OP_anewarray:  case OP_multianewarray:
+        depth -= (op == OP_multianewarray)? p[2] : 1;
+        stk[depth] = unknown;
+        stk[depth++].nonNull = 1;
+        break;
+    case OP_arraylength:
+        learnNonNull(an, depth, &stk[depth-1]);
+        x = stk[--depth];
+        stk[depth] = unknown;
+        stk[depth].lengthOf = x.local;
+        stk[depth].nonNegative = 1;
+        depth++;
+        break;
+    case OP_iaload:  case OP_faload:  case OP_aaload:  case OP_baload:
+    case OP_caload:  case OP_saload:
+        learnNonNull(an, depth, &stk[depth-2]);
+        pops = 2;  pushes = 1;
+        break;
+    case OP_laload:  case OP_daload:
+        learnNonNull(an, depth, &stk[depth-2]);
+        pops = 2;  pushes = 2;
+        break;
+    case OP_iastore:  case OP_fastore:  case OP_aastore:  case OP_bastore:
+    case OP_castore:  case OP_sastore:
+        learnNonNull(an, depth, &stk[depth-3]);
+        pops = 3;
+        break;
+    case OP_lastore:  case OP_dastore:
+        learnNonNull(an, depth, &stk[depth-4]);
+        pops = 4;
+        break;
+
+    /* the operand stack */
+    case OP_nop:
+        break;
+    case OP_pop:  case OP_monitorenter:  case OP_monitorexit:
+        pops = 1;
+        break;
+    case OP_pop2:
+        pops = 2;
+        break;
+    case OP_dup:  case OP_dup_x1:  case OP_dup_x2:
+    case OP_dup2:  case OP_dup2_x1:  case OP_dup2_x2:
+        /* copy the top n items, and insert them k items further down */
+        n = (op >= OP_dup2)? 2 : 1;
+        k = op - ((n == 2)? OP_dup2 : OP_dup);
+        if (depth < n + k) {
+            an->failed = 1;
+            return;
+        }
+        for( ix = depth-1;  ix >= depth-n-k;  ix-- )
+            stk[ix+n] = stk[ix];
+        for( ix = 0;  ix < n;  ix++ )
+            stk[depth-n-k+ix] = stk[depth+ix];
+        depth += n;
+        break;
+    case OP_swap:
+        x = stk[depth-1];
+        stk[depth-1] = stk[depth-2];
+        stk[depth-2] = x;
+        break;
+
+    /* fields and methods */
+    case OP_getstatic:  case OP_putstatic:  case OP_getfield:  case OP_putfield:
+        n = typeWords(memberDescriptor(cf, (p[0]<<8) + p[1]));
+        if (op == OP_getstatic)      pushes = n;
+        else if (op == OP_putstatic) pops = n;
+        else if (op == OP_getfield)  { pops = 1;  pushes = n; }
+        else                         pops = 1 + n;
+        if (op == OP_getfield || op == OP_putfield)
+            learnNonNull(an, depth, &stk[depth-pops]);
+        break;
+    case OP_invokevirtual:  case OP_invokespecial:  case OP_invokestatic:
+    case OP_invokeinterface:
+        descr = memberDescriptor(cf, (p[0]<<8) + p[1]);
+        pops = CountParameters((uint8_t *)descr) + (op != OP_invokestatic);
+        pushes = typeWords(strchr(descr, ')') + 1);
+        if (op != OP_invokestatic)
+            learnNonNull(an, depth, &stk[depth-pops]);
+        break;
+
+    /* control transfers */
+    case OP_ifeq:  case OP_ifne:  case OP_iflt:  case OP_ifge:  case OP_ifgt:
+    case OP_ifle:
+    case OP_if_icmpeq:  case OP_if_icmpne:  case OP_if_icmplt:  case OP_if_icmpge:
+    case OP_if_icmpgt:  case OP_if_icmple:
+        if (op >= OP_if_icmpeq) {
+            y = stk[--depth];
+            x = stk[--depth];
+        } else {
+            x = stk[--depth];
+            setConstant(&y, 0);
+            op += OP_if_icmpeq - OP_ifeq;
+        }
+        switch(op) {
+        case OP_if_icmplt:  n = REL_LT;  break;
+        case OP_if_icmpge:  n = REL_GE;  break;
+        case OP_if_icmpgt:  n = REL_GT;  break;
+        case OP_if_icmple:  n = REL_LE;  break;
+        case OP_if_icmpeq:  n = REL_EQ;  break;
+        default:            n = REL_NE;  break;
+        }
+        branch(an, depth, n, &x, &y, pc + get2(p), next);
+        return;
+    case OP_if_acmpeq:  case OP_if_acmpne:
+        depth -= 2;
+        flow(an, pc + get2(p), depth);
+        break;
+    case OP_ifnull:  case OP_ifnonnull:
+        /* the reference is not null on one of the edges */
+        x = stk[--depth];
+        memcpy(an->saved, an->work, (an->numLocals + depth) * sizeof(Fact));
+        if (op == OP_ifnonnull)
+            learnNonNull(an, depth, &x);
+        flow(an, pc + get2(p), depth);
+        memcpy(an->work, an->saved, (an->numLocals + depth) * sizeof(Fact));
+        if (op == OP_ifnull)
+            learnNonNull(an, depth, &x);
+        flow(an, next, depth);
+        return;
+    case OP_goto:
+        flow(an, pc + get2(p), depth);
+        return;
+    case OP_goto_w:
+        flow(an, pc + get4(p), depth);
+        return;
+    case OP_tableswitch:
+    case OP_lookupswitch:
+        depth--;
+        ix = (pc + 4) & ~3;
+        flow(an, pc + get4(code + ix), depth);
+        if (op == OP_tableswitch) {
+            n = get4(code + ix + 8) - get4(code + ix + 4) + 1;
+            for( k = 0;  k < n;  k++ )
+                flow(an, pc + get4(code + ix + 12 + 4*k), depth);
+        } else {
+            n = get4(code + ix + 4);
+            for( k = 0;  k < n;  k++ )
+                flow(an, pc + get4(code + ix + 12 + 8*k), depth);
+        }
+        return;
+    case OP_ireturn:  case OP_lreturn:  case OP_freturn:  case OP_dreturn:
+    case OP_areturn:  case OP_return:  case OP_athrow:
+        return;
+
+    default:
+        /* jsr, ret, wide and anything unexpected */
+        an->failed = 1;
+        return;
+    }
+    depth -= pops;
+    if (depth < 0 || depth + pushes > an->m->max_stack) {
+        an->failed = 1;
+        return;
+    }
+    while(pushes-- > 0)
+        stk[depth++] = unknown;
+    flow(an, next, depth);
+}
+
+
+/* Returns the facts which hold for the array of the array access or
+   arraylength at offset pc, and sets *index to those for its index, or
+   returns NULL if the instruction is never executed */
+static Fact *arrayOperand( Analysis *an, int pc, Fact **index ) {
+    int op = an->m->code[pc], ix;
+    Fact *stk;
+
+    if (an->facts[pc] == NULL)
+        return NULL;
+    stk = an->facts[pc] + an->numLocals;
+    ix = an->depth[pc] - 1;
+    if (op == OP_arraylength) {
+        *index = NULL;
+        return &stk[ix];
+    }
+    /* the index is below the value stored, if any */
+    if (op >= OP_iastore)
+        ix -= (op == OP_lastore || op == OP_dastore)? 2 : 1;
+    *index = &stk[ix];
+    return &stk[ix-1];
+}
+
+
+/* Replaces the array accesses of method m of class ct which cannot throw
+   an exception by their OP_xxx_quick versions, and those whose array
+   cannot be null by their OP_xxx_nonnull versions */
+void EliminateBoundsChecks( ClassType *ct, method_info *m ) {
+    Analysis an;
+    uint8_t *code = m->code, *et;
+    int pc, op, i, accesses = 0, lengths = 0, removed = 0, nullsRemoved = 0;
+    Fact *array, *index;
+
+    for( pc = 0;  pc < m->code_length;  pc += InstructionLength(code, pc) ) {
+        if (isArrayAccess(code[pc]))
+            accesses++;
+        else if (code[pc] == OP_arraylength)
+            lengths++;
+    }
+    if (accesses + lengths == 0)
+        return;
+    numAccesses += accesses;
+    numNullChecks += accesses + lengths;
+
+    an.cf = ct->cf;
+    an.m = m;
+    an.numLocals = m->max_locals;
+    an.numSlots = m->max_locals + m->max_stack;
+    an.facts = SafeCalloc(m->code_length, sizeof(Fact *));
+    an.depth = SafeCalloc(m->code_length, sizeof(int));
+    an.work = SafeMalloc(an.numSlots * sizeof(Fact));
+    an.saved = SafeMalloc(an.numSlots * sizeof(Fact));
+    an.failed = m->max_locals > INT16_MAX;
+    for( i = 0;  i < an.numSlots;  i++ )
+        an.work[i] = unknown;
+    /* this is never null */
+    if ((m->access_flags & ACC_STATIC) == 0 && m->max_locals > 0)
+        an.work[0].nonNull = 1;
+    flow(&an, 0, 0);
+    /* nothing is known where an exception is caught */
+    an.work[0] = unknown;
+    for( i = 0, et = m->exception_table;  i < m->exception_table_length;  i++, et += 8 )
+        flow(&an, (et[4]<<8) + et[5], 1);
+
+    while(an.changed && !an.failed) {
+        an.changed = 0;
+        for( pc = 0;  pc < m->code_length && !an.failed;  pc += InstructionLength(code, pc) ) {
+            if (an.facts[pc] != NULL)
+                analyseInstruction(&an, pc);
+        }
+    }
+
+    if (!an.failed) {
+        for( pc = 0;  pc < m->code_length;  pc += InstructionLength(code, pc) ) {
+            op = code[pc];
+            if (!isArrayAccess(op) && op != OP_arraylength)
+                continue;
+            array = arrayOperand(&an, pc, &index);
+            if (array == NULL)
+                continue;
+            if (op == OP_arraylength) {
+                if (array->nonNull) {
+                    m->quickCode[pc] = OP_arraylength_quick;
+                    nullsRemoved++;
+                }
+            } else if (array->local != NONE && index->nonNegative
+                    && index->below == array->local) {
+                /* the arraylength which established the bound would
+                   already have thrown if the array were null */
+                m->quickCode[pc] = (op <= OP_saload)? op - OP_iaload + OP_iaload_quick
+                    : op - OP_iastore + OP_iastore_quick;
+                removed++;
+                nullsRemoved++;
+            } else if (array->nonNull) {
+                m->quickCode[pc] = (op <= OP_saload)? op - OP_iaload + OP_iaload_nonnull
+                    : op - OP_iastore + OP_iastore_nonnull;
+                nullsRemoved++;
+            }
+        }
+        numChecksRemoved += removed;
+        numNullChecksRemoved += nullsRemoved;
+    } else
+        numMethodsSkipped++;
+
+    if (tracingExecution & TRACE_VERIFY) {
+        if (an.failed)
+            printf("method %s of class %s was not analysed for bounds checks\n",
+                GetUTF8(ct->cf, m->name_index), ct->cf->cname);
+        else
+            printf("%d of %d array bounds checks and %d of %d null checks removed"
+                " from method %s of class %s\n", removed, accesses, nullsRemoved,
+                accesses + lengths, GetUTF8(ct->cf, m->name_index), ct->cf->cname);
+    }
+
+    for( pc = 0;  pc < m->code_length;  pc++ ) {
+        if (an.facts[pc] != NULL)
+            SafeFree(an.facts[pc]);
+    }
+    SafeFree(an.facts);
+    SafeFree(an.depth);
+    SafeFree(an.work);
+    SafeFree(an.saved);
+}
+
+
+/* Report on the bounds and null checks removed */
+void PrintBoundsCheckStatistics() {
+    printf("\nBounds Check Statistics\n=======================\n\n");
+    printf("  Number of array accesses analysed = %d\n", numAccesses);
+    printf("  Number of accesses executed without checks = %d\n", numChecksRemoved);
+    printf("  Number of array accesses and arraylengths analysed for null = %d\n",
+        numNullChecks);
+    printf("  Number of them executed without a null check = %d\n",
+        numNullChecksRemoved);
+    printf("  Number of methods not analysed = %d\n", numMethodsSkipped);
+}
@@ -0,0 +1,13 @@
+/* BoundsCheck.h */
+
+#ifndef BOUNDSCHECKH
+
+#define BOUNDSCHECKH
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+
+extern void EliminateBoundsChecks( ClassType *ct, method_info *m );
+extern void PrintBoundsCheckStatistics();
+
+#endif
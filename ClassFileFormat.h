@@ -82,6 +82,28 @@ typedef struct {
     u2  attributes_count;
     u1  *attributes;
     u4   nArgs;  /* # arguments (including 'this' for an instance method) */
+    struct HandlerIndex *handlerIndex;  /* see Exceptions.c, NULL => none */
+    /* the following fields are filled in by the pre-decoder */
+    u1  *quickCode;  /* copy of code which is executed by the interpreter */
+    u1   inlineKind; /* kind of trivial method, see Predecode.h */
+    u1   inlineTwoWords;  /* true => field accessed is a long or double */
+    u2   inlineSlot; /* index of the field accessed in a ClassInstance */
+    u2   numArrayLoops;             /* # copy and fill loops found */
+    struct ArrayLoop *arrayLoops;   /* see ArrayOps.h */
+    /* the following fields are filled in lazily by the interpreter */
+    u2   numInvokeSites;               /* # invokevirtual ops in the code */
+    struct InvokeSite *invokeSites;    /* their inline caches, by offset */
+    /* the following fields are used by the JIT compiler, see JIT.c */
+    u4   invocationCount;  /* # calls while the method was interpreted */
+    u1   jitState;         /* JIT_NOT_COMPILED, JIT_COMPILED or JIT_FAILED */
+    u1   jitPure;          /* true => no side effects outside its frame */
+    void *jitCode;         /* entry point of the compiled code, if any */
+    int  *jitEntries;      /* machine code offset of each bytecode offset */
+    u4   *loopCounts;      /* # times each backward branch was taken */
+    /* the following fields are used by the event trace and the method
+       profile, see EventTrace.c and MethodProfile.c */
+    u2   traceId;          /* 0 => not numbered yet */
+    struct MethodProfile *profile;  /* NULL => not called yet */
 } method_info;
 
 typedef struct {
@@ -8,11 +8,14 @@
 
    * InvokeMethod  -- begins execution of a method's bytecode once
                       the class has been resolved and method found
-   * InvokeStaticMethod  -- implements JVM op invokestatic
-   * InvokeSpecialMethod -- implements JVM op invokespecial
-   * InvokeVirtualMethod -- implements JVM op invokevirtual
+   * ResolveStaticMethod  -- finds the target of JVM op invokestatic
+   * ResolveSpecialMethod -- finds the target of JVM op invokespecial
+   * ResolveVirtualMethod -- finds the target of JVM op invokevirtual,
+                             using an inline cache at each call site
 
    * LoadClass  -- attempts to load a class from a disk file
+   * IsSubtypeOf, InstanceOf -- implement the type tests of the
+                    JVM ops checkcast and instanceof
 
    * GetStatic  -- implements JVM op getstatic
    * PutStatic  -- implements JVM op getstatic
@@ -25,6 +28,7 @@
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #include "ClassFileFormat.h"
 #include "ReadClassFile.h"
@@ -33,10 +37,35 @@
 #include "NativeClasses.h"
 #include "TraceOptions.h"
 #include "MyAlloc.h"
+#include "OpcodeSignatures.h"
+#include "Verifier.h"
 #include "ClassResolver.h"
+#include "Predecode.h"
+#include "JIT.h"
+#include "Exceptions.h"
+#include "PerfCounters.h"
+#include "Timeline.h"
+#include "Metrics.h"
 
 ClassType *FirstLoadedClass = NULL;  /* list of loaded classes or array types in use */
 
+/* statistics for the inline caches at invokevirtual sites */
+static int  icNumSites = 0;
+static long icHits = 0;
+static long icMisses = 0;
+static long icMegamorphicCalls = 0;
+
+/* statistics for the caches of the checkcast and instanceof ops */
+static long tcHits = 0;
+static long tcMisses = 0;
+
+/* metrics of the classes and calls */
+static long numClassesLoaded = 0;
+static long numStaticInvokes = 0;
+static long numSpecialInvokes = 0;
+static long numVirtualInvokes = 0;
+static long numNativeCalls = 0;
+
 
 /* For a class identified by cf, this returns the number of static (class) variables
    and the number of instance variables */
@@ -63,39 +92,25 @@ static void getNumClassVars( ClassFile *cf, int *numClassVars, int *numInstVars
 
 
 /* Invoke a method whose class has been resolved and the
-   method implementation identified */
+   method implementation identified.
+   This is the entry point used when C code (class initialization,
+   the start of execution or compiled code) calls a Java method.  Calls
+   from one interpreted Java method to another are handled inside the
+   interpreter loop, without recursion in C. */
 void InvokeMethod( ClassType *ct, method_info *m, int isStatic ) {
-    int i;
+    Frame *frame;
     int rw;
-    uint32_t result1, result2;
 
     if (ct == NULL) {
         if (!isStatic) (void)JVM_Pop();
         return;
     }
-    DataItem *locals = JVM_Top + 1 - m->nArgs;  /* points locals at first arg */
-
-    for( i = m->nArgs;  i < m->max_locals;  i++ )
-        JVM_Push(0);
-    rw = InterpretMethod(ct, m, locals);
-    /* pop the method result (if any) off the stack */
-    if (rw > 0) {
-        result1 = JVM_Pop();
-        if (rw > 1)
-            result2 = JVM_Pop();
-    }
-    /* pop local variables off the stack */
-    while(JVM_Top >= locals)  // Bug fix: 02/06/10
-        (void)JVM_Pop();
-    /* pop the instance pointer (this) of the stack, if not static */
-    // if (!isStatic)
-    //    (void)JVM_Pop();
-    /* push the method result back on the stack */
-    if (rw > 0) {
-        if (rw > 1)
-            JVM_Push(result2);
-        JVM_Push(result1);
-    } 
+    frame = JVM_PushFrame(ct, m);
+    if (JitThreshold > 0 && JIT_CountInvocation(ct, m))
+        rw = JIT_Run(frame);
+    else
+        rw = InterpretMethod(frame);
+    JVM_PopFrame(rw);
 }
 
 
@@ -150,19 +165,113 @@ static ClassType *lookupClassAndMethod( ClassType *ct, int ix,
 
 typedef void (*MissingMethodHandler)(char *, char *, char *);
 
-static void GeneralInvoke( ClassType *ct, int ix, int isStatic,
-        int isVirtual, MissingMethodHandler missingFnHandler ) {
+/* Searches class *ctp and then its ancestors for a method with the given
+   name and signature.  If found, *ctp is updated to refer to the class
+   which implements the method. */
+static method_info *findMethod( ClassType **ctp, char *methodName, char *methodDescr ) {
+    ClassType *ct1 = *ctp;
+    method_info *m = NULL;
+
+    while(ct1 != NULL) {
+        /* now we have to find the matching method in the ct1 class */
+        m = SearchClassForMethodByName(ct1->cf, methodName, methodDescr);
+        if (m != NULL)  /* found the method? */
+            break;
+        /* if not, repeat the search with the parent class */
+        ct1 = ct1->parent;
+    }
+    *ctp = ct1;
+    return m;
+}
+
+
+static void unresolvedMethod( char *methodName, char *methodDescr ) {
+    fprintf(stderr, "Unable to resolve reference to method %s"
+        "\nwith signature %s while"
+        "\nexecuting invokevirtual/invokespecial/invokestatic\n",
+        methodName, methodDescr);
+    exit(1);
+}
+
+
+/* Returns the resolution table entry for MethodRef ix of class ct */
+static ResolvedMethod *resolvedMethod( ClassType *ct, int ix ) {
+    if (ct->resolvedMethods == NULL)
+        ct->resolvedMethods = SafeCalloc(ct->cf->constant_pool_count,
+            sizeof(ResolvedMethod));
+    return &ct->resolvedMethods[ix];
+}
+
+
+/* Executes the C function of a native method, timing it for -TM */
+static void callNative( ResolvedMethod *rm ) {
+    uint64_t start;
+
+    numNativeCalls++;
+    if ((tracingExecution & TRACE_METHODS) == 0) {
+        rm->native();
+        return;
+    }
+    start = ProfileClock();
+    rm->native();
+    ProfileNative(rm->profile, ProfileClock() - start);
+}
+
+
+/* The method of a class which cannot be loaded is called by an invoke
+   op which refers to MethodRef ix of class ct.  The C function which
+   implements it is found in the registry of native methods, bound to
+   the MethodRef so that the lookup is not repeated, and executed. */
+static void invokeNative( ClassType *ct, int ix, char *className,
+        char *methodName, char *methodDescr,
+        MissingMethodHandler missingFnHandler ) {
+    NativeMethod fn = FindNative(className, methodName, methodDescr);
+    ResolvedMethod *rm;
+
+    if (fn == NULL) {
+        missingFnHandler(className, methodName, methodDescr);
+        return;
+    }
+    rm = resolvedMethod(ct, ix);
+    rm->native = fn;
+    if (tracingExecution & TRACE_METHODS)
+        rm->profile = NativeProfile(className, methodName, methodDescr);
+    callNative(rm);
+}
+
+
+/* Finds the method to be executed for an invoke op in class ct which
+   refers to the MethodRef entry ix in the constant pool.
+   The result is the method, with *ctp set to the class which implements
+   it, or NULL if the method is implemented in C and has already been
+   executed.
+   The targets of invokestatic and invokespecial ops do not depend on
+   the receiver, so they are remembered in the resolvedMethods table of
+   class ct and found directly on later calls; so are native methods. */
+static method_info *GeneralInvoke( ClassType *ct, int ix, int isVirtual,
+        MissingMethodHandler missingFnHandler, ClassType **ctp ) {
     ClassType *ct1;
     char *className, *methodName, *methodDescr;
     method_info *m;
 
+    if (ct->resolvedMethods != NULL) {
+        ResolvedMethod *rm = &ct->resolvedMethods[ix];
+        if (rm->native != NULL) {
+            callNative(rm);
+            return NULL;
+        }
+        if (!isVirtual && rm->m != NULL) {
+            *ctp = rm->owner;
+            return rm->m;
+        }
+    }
     ct1 = lookupClassAndMethod(ct, ix, &className, &methodName, &methodDescr);
     if (ct1 == NULL) {
-        if (missingFnHandler != NULL)
-            missingFnHandler(className, methodName, methodDescr);
+        invokeNative(ct, ix, className, methodName, methodDescr,
+            missingFnHandler);
         SafeFree(methodName);
         SafeFree(methodDescr);
-        return;
+        return NULL;
     }
     if (isVirtual) {
         int argSize = CountParameters((unsigned char *)methodDescr);
@@ -171,55 +280,205 @@ static void GeneralInvoke( ClassType *ct, int ix, int isStatic,
         assert(theObj->kind == CODE_INST);
         ct1 = theObj->thisClass;  // ct1 is the dynamic type of theObj
     }
-    while(ct1 != NULL) {
-        /* now we have to find the matching method in the ct1 class */
-        m = SearchClassForMethodByName(ct1->cf, methodName, methodDescr);
-        if (m != NULL)  /* found the method? */
-            break;
-        /* if not, repeat the search with the parent class */
-        ct1 = ct1->parent;
+    m = findMethod(&ct1, methodName, methodDescr);
+    if (ct1 == NULL || m == NULL)
+        unresolvedMethod(methodName, methodDescr);
+    if (!isVirtual) {
+        ResolvedMethod *rm = resolvedMethod(ct, ix);
+        rm->owner = ct1;
+        rm->m = m;
     }
-
-    if (ct1 == NULL || m == NULL) {
-        fprintf(stderr, "Unable to resolve reference to method %s"
-            "\nwith signature %s while"
-            "\nexecuting invokevirtual/invokespecial/invokestatic\n",
-            methodName, methodDescr);
-        exit(1);
-    }
-    
-    InvokeMethod(ct1, m, isStatic);
     
     SafeFree(methodName);
     SafeFree(methodDescr);
+    *ctp = ct1;
+    return m;
 }
 
 
-/* Invoke a static method whose class may not have been resolved;
-   the method is identified by the index of a MethodRef entry in
-   the constant pool of the class identified by ct. */
-void InvokeStaticMethod( ClassType *ct, int ix ) {
-    GeneralInvoke(ct, ix, 1, 0, &MissingClassStaticMethod);
+/* Find the static method to invoke, where the class may not have been
+   resolved; the method is identified by the index of a MethodRef entry
+   in the constant pool of the class identified by ct.
+   This function implements the lookup for the InvokeStatic JVM opcode. */
+method_info *ResolveStaticMethod( ClassType *ct, int ix, ClassType **ctp ) {
+    numStaticInvokes++;
+    return GeneralInvoke(ct, ix, 0, &MissingClassStaticMethod, ctp);
 }
 
 
-/* Invoke an instance method whose class may not have been resolved;
-   the method is identified by the index of a MethodRef entry in
-   the constant pool of the class identified by ct.
-   This function implements the InvokeSpecial JVM opcode.
+/* Find the instance method to invoke, where the class may not have been
+   resolved; the method is identified by the index of a MethodRef entry
+   in the constant pool of the class identified by ct.
+   This function implements the lookup for the InvokeSpecial JVM opcode.
 */
-void InvokeSpecialMethod( ClassType *ct, int ix ) {
-    GeneralInvoke(ct, ix, 0, 0, &MissingClassVirtualMethod);
+method_info *ResolveSpecialMethod( ClassType *ct, int ix, ClassType **ctp ) {
+    numSpecialInvokes++;
+    return GeneralInvoke(ct, ix, 0, &MissingClassVirtualMethod, ctp);
+}
+
+
+/* Creates the inline caches for all invokevirtual ops in method m.
+   The caches are kept in order of increasing bytecode offset. */
+static void createInvokeSites( method_info *m ) {
+    int pc, n = 0;
+
+    for( pc = 0;  pc < m->code_length;  pc += InstructionLength(m->code, pc) )
+        if (m->code[pc] == OP_invokevirtual) n++;
+    m->invokeSites = SafeCalloc(n > 0? n : 1, sizeof(InvokeSite));
+    m->numInvokeSites = n;
+    n = 0;
+    for( pc = 0;  pc < m->code_length;  pc += InstructionLength(m->code, pc) ) {
+        if (m->code[pc] != OP_invokevirtual) continue;
+        m->invokeSites[n].offset = pc;
+        m->invokeSites[n].argSize = -1;
+        n++;
+    }
+    icNumSites += n;
+}
+
+
+/* Returns the inline cache for the invokevirtual op at the given
+   offset in method m (found by a binary search) */
+static InvokeSite *findInvokeSite( method_info *m, int offset ) {
+    int lo = 0, hi = m->numInvokeSites - 1;
+
+    if (m->invokeSites == NULL)
+        createInvokeSites(m);
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        InvokeSite *site = &m->invokeSites[mid];
+        if (site->offset == offset)
+            return site;
+        if (site->offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+
+/* Find the virtual method to invoke, where the class may not have been
+   resolved; the method is identified by the index of a MethodRef entry
+   in the constant pool of the class identified by ct.
+   The invokevirtual op is at the given offset in the bytecode of
+   method caller.  The inline cache for that call site is checked
+   first, and only if the receiver's class is not found there do we
+   perform the full method lookup (and then extend the cache).
+   If the class cannot be found, the method is a native method which
+   is executed here (see invokeNative), and the result is NULL.  */
+method_info *ResolveVirtualMethod( ClassType *ct, method_info *caller,
+        int offset, int ix, ClassType **ctp ) {
+    InvokeSite *site;
+    ClassType *ct1;
+    ClassInstance *theObj;
+    char *className, *methodName, *methodDescr;
+    method_info *m;
+    HeapPointer hp;
+    int k;
+
+    numVirtualInvokes++;
+    /* a native method bound to the MethodRef is simply called */
+    if (ct->resolvedMethods != NULL && ct->resolvedMethods[ix].native != NULL) {
+        callNative(&ct->resolvedMethods[ix]);
+        return NULL;
+    }
+    site = findInvokeSite(caller, offset);
+
+    if (site == NULL || site->isNative)
+        return GeneralInvoke(ct, ix, 1, &MissingClassVirtualMethod, ctp);
+    if (site->argSize >= 0) {
+        hp = (JVM_Top - site->argSize)->pval;
+        if (hp != NULL_HEAP_REFERENCE) {
+            theObj = REAL_HEAP_POINTER(hp);
+            for( k = 0;  k < site->numEntries;  k++ ) {
+                if (site->entry[k].receiver == theObj->thisClass) {
+                    icHits++;
+                    *ctp = site->entry[k].owner;
+                    return site->entry[k].m;
+                }
+            }
+        }
+    }
+
+    /* a cache miss, so we perform the full lookup */
+    icMisses++;
+    ct1 = lookupClassAndMethod(ct, ix, &className, &methodName, &methodDescr);
+    if (ct1 == NULL) {
+        /* it's a native method; these are never cached */
+        site->isNative = 1;
+        invokeNative(ct, ix, className, methodName, methodDescr,
+            &MissingClassVirtualMethod);
+        SafeFree(methodName);
+        SafeFree(methodDescr);
+        return NULL;
+    }
+    site->argSize = CountParameters((unsigned char *)methodDescr);
+    hp = (JVM_Top - site->argSize)->pval;
+    if (hp == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", methodName, className);
+    theObj = REAL_HEAP_POINTER(hp);
+    assert(theObj->kind == CODE_INST);
+    ct1 = theObj->thisClass;  // ct1 is the dynamic type of theObj
+    m = findMethod(&ct1, methodName, methodDescr);
+    if (ct1 == NULL || m == NULL)
+        unresolvedMethod(methodName, methodDescr);
+
+    if (site->isMegamorphic) {
+        icMegamorphicCalls++;
+    } else if (site->numEntries < IC_MAX_ENTRIES) {
+        k = site->numEntries++;
+        site->entry[k].receiver = theObj->thisClass;
+        site->entry[k].owner = ct1;
+        site->entry[k].m = m;
+        if ((tracingExecution & TRACE_ICACHE) && k > 0)
+            fprintf(stdout, "inline cache for %s at offset %d is polymorphic"
+                " (%d entries)\n", methodName, offset, k+1);
+    } else {
+        site->isMegamorphic = 1;
+        icMegamorphicCalls++;
+        if (tracingExecution & TRACE_ICACHE)
+            fprintf(stdout, "inline cache for %s at offset %d is megamorphic\n",
+                methodName, offset);
+    }
+
+    SafeFree(methodName);
+    SafeFree(methodDescr);
+    *ctp = ct1;
+    return m;
 }
 
 
-/* Invoke a virtual method whose class may not have been resolved;
-   the method is identified by the index of a MethodRef entry in
-   the constant pool of the class identified by ct.
-   If the class cannot be found, we call MissingClassVirtualMethod
-   in case it is a class/method implemented as a native method.  */
-void InvokeVirtualMethod( ClassType *ct, int ix ) {
-    GeneralInvoke(ct, ix, 0, 1, &MissingClassVirtualMethod);
+/* Registers the metrics of this module (see Metrics.c) */
+void RegisterResolverMetrics() {
+    RegisterCounter("jvm_classes_loaded_total", NULL,
+        "Classes loaded from class files", &numClassesLoaded);
+    RegisterCounter("jvm_invokes_total", "static",
+        "Invoke ops executed, by kind", &numStaticInvokes);
+    RegisterCounter("jvm_invokes_total", "special",
+        "Invoke ops executed, by kind", &numSpecialInvokes);
+    RegisterCounter("jvm_invokes_total", "virtual",
+        "Invoke ops executed, by kind", &numVirtualInvokes);
+    RegisterCounter("jvm_native_calls_total", NULL,
+        "Calls of native methods", &numNativeCalls);
+    RegisterCounter("jvm_inline_cache_hits_total", NULL,
+        "Inline cache hits at invokevirtual sites", &icHits);
+    RegisterCounter("jvm_inline_cache_misses_total", NULL,
+        "Inline cache misses at invokevirtual sites", &icMisses);
+}
+
+
+/* Report on the effectiveness of the inline caches */
+void PrintInlineCacheStatistics() {
+    printf("\nInline Cache Statistics\n=======================\n\n");
+    printf("  Number of invokevirtual sites with caches = %d\n", icNumSites);
+    printf("  Number of cache hits = %ld\n", icHits);
+    printf("  Number of cache misses = %ld\n", icMisses);
+    printf("  Number of calls at megamorphic sites = %ld\n", icMegamorphicCalls);
+    if (icHits + icMisses > 0)
+        printf("  Hit rate = %.2f%%\n", 100.0 * icHits / (icHits + icMisses));
+    printf("  Number of checkcast/instanceof cache hits = %ld\n", tcHits);
+    printf("  Number of checkcast/instanceof cache misses = %ld\n", tcMisses);
 }
 
 
@@ -232,15 +491,24 @@ ClassType *ResolveClassReferenceByName( char *cname ) {
     if (strcmp(cname,"java/lang/Object") == 0)
         return NULL;
     if (cname[0] == '[') {
-        ClassType *cta = ResolveClassReferenceByName(cname+1);
+        ClassType *cta = NULL;
+        if (cname[1] == '[') {
+            cta = ResolveClassReferenceByName(cname+1);
+        } else if (cname[1] == 'L') {   /* strip the L and ; */
+            char *ename = SafeStrdup(cname+2);
+            ename[strlen(ename)-1] = '\0';
+            cta = ResolveClassReferenceByName(ename);
+            SafeFree(ename);
+        }   /* else the elements have a primitive type */
         for( ct1 = FirstLoadedClass;  ct1 != NULL;  ct1 = ct1->nextClass ) {
             if (!ct1->isArrayType) continue;
-            if (cta == ct1->elementType) {  /* already created */
-                return ct1;
+            /* the element types of int[] and String[] are both NULL */
+            if (cta == ct1->elementType && (cta != NULL
+                    || strcmp(cname, ct1->typeDescriptor) == 0)) {
+                return ct1;     /* already created */
             }
         }
-        ct1 = MyHeapAlloc(sizeof(ClassType));
-        ct1->kind = CODE_CLAS;
+        ct1 = MyHeapAlloc(sizeof(ClassType), CODE_CLAS);
         ct1->typeDescriptor = SafeStrdup(cname);
         ct1->isArrayType = 1;
         ct1->elementType = cta;
@@ -280,6 +548,224 @@ ClassType *ResolveClassReference( ClassType *ct, int ix ) {
 }    
 
 
+/* Subtype tests
+
+   Each class has a display of its superclasses: display[i] is the
+   ancestor at depth i, where a class whose parent is java/lang/Object
+   has depth 0, and display[depth] is the class itself.  A class s is
+   then a subclass of t exactly when s->display[t->depth] == t, which
+   takes constant time however deep the hierarchy.  The interfaces
+   which a class implements, directly or by inheritance, are kept in a
+   separate list which is searched when the target is an interface.
+   Classes in the java/... packages are not loaded, so tests against
+   them are made by name.
+*/
+
+/* the supertypes of the objects implemented in C */
+static char *stringSupertypes[] = { "java/lang/Object", "java/lang/String",
+    "java/lang/CharSequence", "java/lang/Comparable", "java/io/Serializable",
+    NULL };
+static char *stringBuilderSupertypes[] = { "java/lang/Object",
+    "java/lang/StringBuilder", "java/lang/CharSequence",
+    "java/lang/Appendable", "java/io/Serializable", NULL };
+static char *printStreamSupertypes[] = { "java/lang/Object",
+    "java/io/PrintStream", NULL };
+static char *arraySupertypes[] = { "java/lang/Object", "java/lang/Cloneable",
+    "java/io/Serializable", NULL };
+
+/* descriptors of the primitive element types, by newarray typecode */
+static char *primitiveDescriptors[] = { "Z", "C", "F", "D", "B", "S", "I", "J" };
+
+
+static int nameInList( char *name, char **list ) {
+    for( ;  *list != NULL;  list++ ) {
+        if (strcmp(name, *list) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+
+static void addInterface( ClassType *ct, ClassType *ict ) {
+    int i;
+    for( i = 0;  i < ct->numInterfaces;  i++ ) {
+        if (ct->interfaces[i] == ict)
+            return;
+    }
+    ct->interfaces[ct->numInterfaces++] = ict;
+}
+
+
+/* Fills in the display and the list of interfaces of a class being
+   loaded, whose parent class is pct.  The interfaces it names are
+   loaded too, except for those in the java/... packages. */
+static void buildSupertypes( ClassType *ct, ClassType *pct ) {
+    ClassFile *cf = ct->cf;
+    ClassType **direct;
+    int i, j, maxInterfaces;
+
+    ct->depth = (pct == NULL)? 0 : pct->depth + 1;
+    ct->display = SafeCalloc(ct->depth + 1, sizeof(ClassType *));
+    if (pct != NULL)
+        memcpy(ct->display, pct->display, ct->depth * sizeof(ClassType *));
+    ct->display[ct->depth] = ct;
+
+    direct = SafeCalloc(cf->interfaces_count + 1, sizeof(ClassType *));
+    maxInterfaces = (pct == NULL)? 0 : pct->numInterfaces;
+    for( i = 0;  i < cf->interfaces_count;  i++ ) {
+        char *iname = GetCPItemAsString(cf, cf->interfaces[i]);
+        direct[i] = ResolveClassReferenceByName(iname);
+        SafeFree(iname);
+        if (direct[i] != NULL)
+            maxInterfaces += 1 + direct[i]->numInterfaces;
+    }
+    ct->interfaces = SafeCalloc(maxInterfaces + 1, sizeof(ClassType *));
+    for( i = 0;  pct != NULL && i < pct->numInterfaces;  i++ )
+        addInterface(ct, pct->interfaces[i]);
+    for( i = 0;  i < cf->interfaces_count;  i++ ) {
+        if (direct[i] == NULL) continue;
+        addInterface(ct, direct[i]);
+        for( j = 0;  j < direct[i]->numInterfaces;  j++ )
+            addInterface(ct, direct[i]->interfaces[j]);
+    }
+    SafeFree(direct);
+}
+
+
+/* Returns true if an array whose elements have type es can be assigned
+   to the array type t.  If es is NULL, esd is the descriptor of the
+   element type, or NULL for a class in the java/... packages. */
+static int arrayIsSubtype( ClassType *es, char *esd, ClassType *t ) {
+    ClassType *et = t->elementType;
+    char *etd = t->typeDescriptor + 1;
+
+    if (et != NULL)
+        return es != NULL && IsSubtypeOf(es, et);
+    if (es != NULL || esd == NULL)
+        return strcmp(etd, "Ljava/lang/Object;") == 0
+            || (es == NULL && etd[0] == 'L');
+    if (strcmp(etd, "Ljava/lang/Object;") == 0)
+        return esd[0] == 'L' || esd[0] == '[';
+    return strcmp(esd, etd) == 0;
+}
+
+
+/* Returns true if class s names the class or interface in the java/...
+   packages as a supertype: as an interface, or as the superclass of its
+   topmost loaded ancestor (such as java/lang/Exception). */
+static int namesJavaSupertype( ClassType *s, char *name ) {
+    ClassType *ct;
+    ClassFile *rootcf = s->display[0]->cf;
+    char *sname;
+    int i, k, found = 0;
+
+    sname = GetCPItemAsString(rootcf, rootcf->super_class);
+    found = JavaClassExtends(sname, name);
+    SafeFree(sname);
+    for( i = 0;  i <= s->depth + s->numInterfaces && !found;  i++ ) {
+        ct = (i <= s->depth)? s->display[i] : s->interfaces[i - s->depth - 1];
+        for( k = 0;  k < ct->cf->interfaces_count && !found;  k++ ) {
+            char *iname = GetCPItemAsString(ct->cf, ct->cf->interfaces[k]);
+            found = strcmp(iname, name) == 0;
+            SafeFree(iname);
+        }
+    }
+    return found;
+}
+
+
+/* Returns true if a value of type s can be assigned to type t, where
+   neither type is in the java/... packages */
+int IsSubtypeOf( ClassType *s, ClassType *t ) {
+    int i;
+
+    if (s == t)
+        return 1;
+    if (t->isArrayType)
+        return s->isArrayType
+            && arrayIsSubtype(s->elementType, s->typeDescriptor+1, t);
+    if (s->isArrayType)
+        return 0;
+    if (t->cf->access_flags & ACC_INTERFACE) {
+        for( i = 0;  i < s->numInterfaces;  i++ ) {
+            if (s->interfaces[i] == t)
+                return 1;
+        }
+        return 0;
+    }
+    return s->depth >= t->depth && s->display[t->depth] == t;
+}
+
+
+/* Returns the cache for the type tests which refer to the Class
+   constant ix of class ct, resolving the class on first use */
+static TypeCheck *typeCheck( ClassType *ct, int ix ) {
+    TypeCheck *tc;
+
+    if (ct->typeChecks == NULL)
+        ct->typeChecks = SafeCalloc(ct->cf->constant_pool_count,
+            sizeof(TypeCheck));
+    tc = &ct->typeChecks[ix];
+    if (!tc->resolved) {
+        tc->target = ResolveClassReference(ct, ix);
+        tc->targetName = GetCPItemAsString(ct->cf, ix);
+        tc->resolved = 1;
+    }
+    return tc;
+}
+
+
+/* Implements the test made by the checkcast and instanceof ops which
+   refer to Class constant ix of class ct: the result is true if the
+   object hp, which is not null, is an instance of that class.  The
+   result for the class of the last instance tested is cached. */
+int InstanceOf( ClassType *ct, int ix, HeapPointer hp ) {
+    TypeCheck *tc = typeCheck(ct, ix);
+    ClassType *t = tc->target;
+    void *obj = REAL_HEAP_POINTER(hp);
+    ClassInstance *ci;
+    ArrayOfRef *arr;
+
+    switch(*(uint32_t *)obj) {
+    case CODE_INST:
+        ci = obj;
+        if (ci->thisClass == NULL)      /* it's System.out */
+            return t == NULL && nameInList(tc->targetName, printStreamSupertypes);
+        if (ci->thisClass == tc->lastClass) {
+            tcHits++;
+            return tc->lastResult;
+        }
+        tcMisses++;
+        tc->lastClass = ci->thisClass;
+        tc->lastResult = (t != NULL)? IsSubtypeOf(ci->thisClass, t)
+            : namesJavaSupertype(ci->thisClass, tc->targetName);
+        return tc->lastResult;
+    case CODE_STRG:
+        return t == NULL && nameInList(tc->targetName, stringSupertypes);
+    case CODE_SBLD:
+        return t == NULL && nameInList(tc->targetName, stringBuilderSupertypes);
+    case CODE_EXCP:
+        return t == NULL && JavaClassExtends(
+            ((ExceptionInstance *)obj)->className, tc->targetName);
+    case CODE_ARRA:
+        if (t == NULL)
+            return nameInList(tc->targetName, arraySupertypes);
+        if (!t->isArrayType)
+            return 0;
+        arr = obj;
+        if (arr->classRef == NULL_HEAP_REFERENCE)
+            return arrayIsSubtype(NULL, NULL, t);
+        return arrayIsSubtype(REAL_HEAP_POINTER(arr->classRef), NULL, t);
+    case CODE_ARRS:
+        if (t == NULL)
+            return nameInList(tc->targetName, arraySupertypes);
+        return t->isArrayType && arrayIsSubtype(NULL,
+            primitiveDescriptors[((ArrayOfSimple *)obj)->typecode - 4], t);
+    }
+    return 0;
+}
+
+
 /* Given the name of a class, we attempt to read it into memory
    from the current directory on the disk.
    The result is a ClassType instance for this class, or
@@ -294,27 +780,41 @@ ClassType *LoadClass( char *cname ) {
     ClassFile *cf;
     method_info *m;
     char *parent;
-    int numClassVars, numInstVars, i;
+    int numClassVars, numInstVars, i, phase;
 
     // We don't support reading classes from any jar files ... so we don't
     // even try with anything in the java class library.
     if (strncmp(cname, "java/", 5) == 0)
         return NULL;
+    TimelineBegin("class", "load %s", cname);
+    TimelineBegin("class", "read %s", cname);
+    phase = PerfEnterPhase(PHASE_READ);
     cf = ReadClassFile(cname);
-    if (cf == NULL)
+    PerfEnterPhase(phase);
+    TimelineEnd();
+    if (cf == NULL) {
+        TimelineEnd();
         return NULL;
+    }
 
-    /* make sure the parent class is loaded too */
+    /* make sure the parent class is loaded too (it may already have been
+       loaded, in which case ReadClassFile would refuse to read it again) */
     parent = GetCPItemAsString(cf,cf->super_class);
-    pct = LoadClass(parent);
+    pct = ResolveClassReferenceByName(parent);
     SafeFree(parent);
 
     if (tracingExecution & TRACE_CLASS_LOADS)
         printf("loading class %s\n", cname);
 
     /* At this point, the bytecode needs to be verified */
-    Verify(cf);
-    
+    if (verifyingClasses) {
+        TimelineBegin("class", "verify %s", cname);
+        phase = PerfEnterPhase(PHASE_VERIFY);
+        Verify(cf);
+        PerfEnterPhase(phase);
+        TimelineEnd();
+    }
+
     getNumClassVars(cf, &numClassVars, &numInstVars);
     // The class itself would be allocated in the Method Area of a real JVM.
     ct1 = SafeMalloc(sizeof(ClassType)+(numClassVars-1)*sizeof(DataItem));
@@ -322,7 +822,9 @@ ClassType *LoadClass( char *cname ) {
     ct1->typeDescriptor = SafeStrdup(cname);
     ct1->cf = cf;
     ct1->parent = pct;
+    buildSupertypes(ct1, pct);
     ct1->numInstanceFields = numInstVars;
+    ct1->numClassFields = numClassVars;
     if (pct != NULL)
         ct1->numInstanceFields += pct->numInstanceFields;
     ct1->nextClass = FirstLoadedClass;
@@ -339,11 +841,22 @@ ClassType *LoadClass( char *cname ) {
         PutStatic(ct1, fi->name_index); // now store it into the field
     }
 
+    /* prepare the methods' bytecode for the interpreter */
+    PredecodeClass(ct1);
+    IndexExceptionHandlers(ct1);
+
     /* Finally, we execute the <clinit> static method */
     m = SearchClassForMethodByName(cf, "<clinit>", "()V");
-    if (m != NULL)  // initialize class variables via call to clinit
+    if (m != NULL) {  // initialize class variables via call to clinit
+        TimelineBegin("clinit", "<clinit> %s", cname);
+        phase = PerfEnterPhase(PHASE_CLINIT);
         InvokeMethod(ct1,m,1);
+        PerfEnterPhase(phase);
+        TimelineEnd();
+    }
 
+    numClassesLoaded++;
+    TimelineEnd();
     return ct1;
 }
 
@@ -430,17 +943,16 @@ static int getOrPutStatic( ClassType *ct, int ix, int doAGet ) {
 }
 
 
-/* Implements both the getfield and putfield JVM ops.
-   The doAGet flag is 0 for putfield, and nozero for getfield.
-   The instance field is identified by item ix in the constant pool
+/* Finds the instance field identified by item ix in the constant pool
    of the class identified by ct.
-   The JVM stack is modified and the class variable is accessed
-   or overwritten as required for the JVM op.
-   The result is 0 if the operation fails (field not found).    */
-static int getOrPutField( ClassType *ct, int ix, int doAGet ) {
+   The result is the index of the field in the instField array of an
+   instance, or -1 if the field is not found.  *itsTwoWordsp is set to
+   1 for a long or double field and to 0 otherwise. */
+static int findInstanceField( ClassType *ct, int ix, char **fnamep,
+        int *itsTwoWordsp ) {
     ClassType *ct1;
     ClassFile *cf;
-    int ntix, fnameIx, ftypeIx, itsTwoWords;
+    int ntix, fnameIx, ftypeIx;
     char c;
     char *fname;  /* the field name */
 
@@ -451,11 +963,8 @@ static int getOrPutField( ClassType *ct, int ix, int doAGet ) {
     fnameIx = cf->cp_item[ntix].ss.sval1;
     ftypeIx = cf->cp_item[ntix].ss.sval2;
     c = cf->cp_item[ftypeIx].sval[2]; /* c = first char of type descriptor */
-    itsTwoWords = (c == 'D' || c == 'J');
-    fname = (char *)(cf->cp_item[fnameIx].sval+2);
-    if (tracingExecution & TRACE_FIELDS)
-        fprintf(stdout,"%s access to instance field %s\n",
-            doAGet? "get" : "put", fname);
+    *itsTwoWordsp = (c == 'D' || c == 'J');
+    *fnamep = fname = (char *)(cf->cp_item[fnameIx].sval+2);
 
     /* now search for an instance field named fname in its owning class */
     ct1 = ResolveClassReference(ct, cf->cp_item[ix].ss.sval1);
@@ -470,29 +979,12 @@ static int getOrPutField( ClassType *ct, int ix, int doAGet ) {
             int fnix = cfp->name_index;
             ConstantPoolItem *cpi = &cf1->cp_item[fnix];
             char *s = (char *)(cpi->sval+2);
-            ClassInstance *objRef;
 
             assert(cf1->cp_tag[fnix] == CP_UTF8);
             if (strcmp(s,fname) == 0) {  /* the same name */
                 if (ct1->parent != 0)
                     fieldCount += ct1->parent->numInstanceFields;
-                if (doAGet) {
-                    objRef = REAL_HEAP_POINTER(JVM_PopReference());
-                    JVM_Push(objRef->instField[fieldCount].uval);
-                    if (itsTwoWords)
-                        JVM_Push(objRef->instField[fieldCount+1].uval);
-                } else if (itsTwoWords) {
-                    uint32_t v1 = JVM_Pop();
-                    uint32_t v2 = JVM_Pop();
-                    objRef = REAL_HEAP_POINTER(JVM_PopReference());
-                    objRef->instField[fieldCount+1].uval = v1;
-                    objRef->instField[fieldCount].uval = v2;
-                } else {
-                    uint32_t v1 = JVM_Pop();
-                    objRef = REAL_HEAP_POINTER(JVM_PopReference());
-                    objRef->instField[fieldCount].uval = v1;
-                }
-                return 1;
+                return fieldCount;
             }
             if ((cfp->access_flags & ACC_STATIC)==0) {  /* it's not static */
                 fieldCount++;
@@ -504,7 +996,62 @@ static int getOrPutField( ClassType *ct, int ix, int doAGet ) {
         /* not found in current class, try the parent */
         ct1 = ct1->parent;
     }
-    return 0;  /* field was not found */
+    return -1;  /* field was not found */
+}
+
+
+/* Implements both the getfield and putfield JVM ops.
+   The doAGet flag is 0 for putfield, and nozero for getfield.
+   The instance field is identified by item ix in the constant pool
+   of the class identified by ct.
+   The JVM stack is modified and the class variable is accessed
+   or overwritten as required for the JVM op.
+   The result is 0 if the operation fails (field not found).
+   A null reference is trapped by the access to the field, in the guard
+   area of the heap, unless the field is too far from the start of the
+   object.  */
+static int getOrPutField( ClassType *ct, int ix, int doAGet ) {
+    int fieldCount, itsTwoWords;
+    char *fname;  /* the field name */
+    ClassInstance *objRef;
+
+    fieldCount = findInstanceField(ct, ix, &fname, &itsTwoWords);
+    if (tracingExecution & TRACE_FIELDS)
+        fprintf(stdout,"%s access to instance field %s\n",
+            doAGet? "get" : "put", fname);
+    if (fieldCount < 0)
+        return 0;  /* field was not found */
+    if (!IN_HEAP_GUARD(offsetof(ClassInstance,instField) + 4*fieldCount)
+            && (JVM_Top - (doAGet? 0 : itsTwoWords? 2 : 1))->pval == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", fname, ct->cf->cname);
+
+    if (doAGet) {
+        objRef = REAL_HEAP_POINTER(JVM_PopReference());
+        JVM_Push(objRef->instField[fieldCount].uval);
+        if (itsTwoWords)
+            JVM_Push(objRef->instField[fieldCount+1].uval);
+    } else if (itsTwoWords) {
+        uint32_t v1 = JVM_Pop();
+        uint32_t v2 = JVM_Pop();
+        objRef = REAL_HEAP_POINTER(JVM_PopReference());
+        objRef->instField[fieldCount+1].uval = v1;
+        objRef->instField[fieldCount].uval = v2;
+    } else {
+        uint32_t v1 = JVM_Pop();
+        objRef = REAL_HEAP_POINTER(JVM_PopReference());
+        objRef->instField[fieldCount].uval = v1;
+    }
+    return 1;
+}
+
+
+/* Returns the index in the instField array of an instance for the field
+   identified by item ix in the constant pool of class ct, or -1 if
+   there is no such field.  *itsTwoWordsp is set to 1 if the field
+   holds a long or double value. */
+int GetFieldSlot( ClassType *ct, int ix, int *itsTwoWordsp ) {
+    char *fname;
+    return findInstanceField(ct, ix, &fname, itsTwoWordsp);
 }
 
 
@@ -8,11 +8,35 @@
 
 extern ClassType *FirstLoadedClass;
 
+/* An inline cache for one invokevirtual site in a method.  It remembers
+   up to IC_MAX_ENTRIES receiver classes together with the method that
+   was found for each of them.  A site which sees more receiver classes
+   than that is marked as megamorphic and is not extended further. */
+#define IC_MAX_ENTRIES 4
+
+typedef struct InvokeSite {
+    uint32_t offset;          /* bytecode offset of the invokevirtual op */
+    int16_t  argSize;         /* # stack slots for the args, -1 if unknown */
+    uint8_t  numEntries;      /* # entries of the cache in use */
+    uint8_t  isMegamorphic;   /* true => too many receiver classes seen */
+    uint8_t  isNative;        /* true => method is implemented in C */
+    struct {
+        ClassType   *receiver;    /* dynamic type of the receiver */
+        ClassType   *owner;       /* class which implements the method */
+        method_info *m;
+    } entry[IC_MAX_ENTRIES];
+} InvokeSite;
+
 extern void InvokeMethod( ClassType *ct, method_info *m, int isStatic );
 
-extern void InvokeStaticMethod( ClassType *ct, int ix );
-extern void InvokeSpecialMethod( ClassType *ct, int ix );
-extern void InvokeVirtualMethod( ClassType *ct, int ix );
+extern method_info *ResolveStaticMethod( ClassType *ct, int ix,
+        ClassType **ctp );
+extern method_info *ResolveSpecialMethod( ClassType *ct, int ix,
+        ClassType **ctp );
+extern method_info *ResolveVirtualMethod( ClassType *ct, method_info *caller,
+        int offset, int ix, ClassType **ctp );
+extern void PrintInlineCacheStatistics();
+extern void RegisterResolverMetrics();
 
 extern method_info *SearchClassForMethodByName(
         ClassFile *cf, char *name, char *signature );
@@ -20,11 +44,14 @@ extern ClassType *ResolveClassReference( ClassType *ct, int ix );
 extern ClassType *ResolveClassReferenceByName( char *name );
 
 extern ClassType *LoadClass( char *cname );
+extern int IsSubtypeOf( ClassType *s, ClassType *t );
+extern int InstanceOf( ClassType *ct, int ix, HeapPointer hp );
 
 extern int GetStatic(ClassType *ct, int ix);
 extern int GetField(ClassType *ct, int ix);
 extern int PutStatic(ClassType *ct, int ix);
 extern int PutField(ClassType *ct, int ix);
+extern int GetFieldSlot( ClassType *ct, int ix, int *itsTwoWordsp );
 
 #endif
 
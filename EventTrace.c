@@ -0,0 +1,208 @@
+/* EventTrace.c */
+
+/*
+   The binary event trace.
+
+   With the -R option, the trace output selected by -To, -Ti, -Ts and
+   -Th is not printed; instead each event is stored as a fixed-size
+   TraceEvent record, with no formatting, in a ring which holds the last
+   EVENT_RING_SIZE events.  The ring is written to the trace file when
+   the program exits, or when it is ended by a signal, and the
+   TraceDecode program renders the file as text.  Since the file may be
+   written by a signal handler, it is written with open() and write()
+   only, and the names at its end are kept ready to be written, each
+   preceded by its length, from the moment they are known.
+
+   Each event is attributed to the method of the top frame.  A method is
+   numbered the first time it has an event, and the file ends with the
+   names of the methods, so that the events need only hold their
+   numbers.  With the -F option, only the events of the methods whose
+   name, as in Class.method, contains the given string are recorded;
+   the test is made once for each method, when it is numbered.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "PrintByteCode.h"
+#include "MyAlloc.h"
+#include "EventTrace.h"
+
+#define EVENT_RING_SIZE   (1<<16)     /* # events kept, a power of 2 */
+#define MAX_TRACED_METHODS 0xFFFE     /* method ids are 1 .. this */
+#define METHOD_NOT_TRACED  0xFFFF     /* id of a method excluded by -F */
+
+int recordingEvents = 0;
+
+static TraceEvent *ring;
+static uint32_t numRecorded = 0;      /* # events ever recorded */
+static char *traceFileName;
+static char *filter;                  /* NULL => record every method */
+static char **methodNames;            /* indexed by method id, see makeName */
+static char *opcodeNames;             /* the names of the 256 opcodes, as
+                                         written to the file, one after
+                                         the other */
+static int opcodeNamesSize;
+static int numMethods = 0;
+static int flushed = 0;
+
+
+/* Makes s, which has room for a uint16_t in front of it, into a name as
+   written to the trace file; the result is the size of the name */
+static int makeName( char *s ) {
+    uint16_t len = strlen(s + sizeof(len));
+
+    memcpy(s, &len, sizeof(len));
+    return sizeof(len) + len;
+}
+
+
+/* Gives the method m of class ct its id, or excludes it from the trace */
+static int numberMethod( ClassType *ct, method_info *m ) {
+    char *name = GetUTF8(ct->cf, m->name_index);
+    char *descr = GetUTF8(ct->cf, m->descriptor_index);
+    char *s;
+
+    s = SafeMalloc(sizeof(uint16_t)
+        + strlen(ct->cf->cname) + strlen(name) + strlen(descr) + 2);
+    sprintf(s + sizeof(uint16_t), "%s.%s", ct->cf->cname, name);
+    if ((filter != NULL && strstr(s + sizeof(uint16_t), filter) == NULL)
+            || numMethods >= MAX_TRACED_METHODS) {
+        SafeFree(s);
+        m->traceId = METHOD_NOT_TRACED;
+        return METHOD_NOT_TRACED;
+    }
+    strcat(s + sizeof(uint16_t), descr);
+    makeName(s);
+    methodNames[numMethods+1] = s;    /* before a flush can see it */
+    numMethods++;
+    m->traceId = numMethods;
+    return numMethods;
+}
+
+
+/* Makes the names of the opcodes, all together, as written to the file */
+static void makeOpcodeNames() {
+    char *s;
+    int i, size = 0;
+
+    for( i = 0;  i < 256;  i++ )
+        size += sizeof(uint16_t) + strlen(GetOpcodeName(i));
+    opcodeNames = SafeMalloc(size + 1);
+    for( opcodeNamesSize = 0, i = 0;  i < 256;  i++ ) {
+        s = opcodeNames + opcodeNamesSize;
+        strcpy(s + sizeof(uint16_t), GetOpcodeName(i));
+        opcodeNamesSize += makeName(s);
+    }
+}
+
+
+/* Records an event of the method in the top frame, if any; pc is used
+   only for EV_OP and EV_INVOKE events */
+void RecordEvent( int kind, int op, int pc, uint32_t value ) {
+    Frame *f = JVM_FrameTop;
+    TraceEvent *e;
+    int id = 0;
+
+    if (f != NULL && f->method != NULL) {
+        id = f->method->traceId;
+        if (id == 0)
+            id = numberMethod(f->thisClass, f->method);
+        if (id == METHOD_NOT_TRACED)
+            return;
+    } else if (filter != NULL)
+        return;
+    e = &ring[numRecorded++ & (EVENT_RING_SIZE-1)];
+    e->kind = kind;
+    e->op = op;
+    e->method = id;
+    e->pc = pc;
+    e->height = JVM_Top - JVM_Stack;
+    e->value = value;
+}
+
+
+/* Writes size bytes from p to fd; the result is false on an error */
+static int writeAll( int fd, void *p, size_t size ) {
+    ssize_t n;
+
+    for( ;  size > 0;  p = (char *)p + n, size -= n ) {
+        n = write(fd, p, size);
+        if (n <= 0)
+            return 0;
+    }
+    return 1;
+}
+
+
+/* Writes the ring to the trace file; only the first call has an effect.
+   This is called by the signal handlers, so it calls no function which
+   is unsafe there. */
+void FlushEventTrace() {
+    TraceFileHeader h;
+    uint32_t first, end, i;
+    uint16_t len;
+    int fd, ok;
+
+    if (!recordingEvents || flushed)
+        return;
+    flushed = 1;
+    fd = open(traceFileName, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    ok = fd >= 0;
+    memcpy(h.magic, "JVMT", 4);
+    h.version = EVENT_TRACE_VERSION;
+    h.numEvents = numRecorded < EVENT_RING_SIZE? numRecorded : EVENT_RING_SIZE;
+    h.numLost = numRecorded - h.numEvents;
+    h.numMethods = numMethods;
+    ok = ok && writeAll(fd, &h, sizeof(h));
+    /* the events are in at most two pieces of the ring */
+    first = (numRecorded - h.numEvents) & (EVENT_RING_SIZE-1);
+    end = (first + h.numEvents > EVENT_RING_SIZE)? EVENT_RING_SIZE : first + h.numEvents;
+    ok = ok && writeAll(fd, &ring[first], (end - first) * sizeof(TraceEvent));
+    ok = ok && writeAll(fd, ring, (h.numEvents - (end - first)) * sizeof(TraceEvent));
+    ok = ok && writeAll(fd, opcodeNames, opcodeNamesSize);
+    for( i = 1;  ok && i <= numMethods;  i++ ) {
+        memcpy(&len, methodNames[i], sizeof(len));
+        ok = writeAll(fd, methodNames[i], sizeof(len) + len);
+    }
+    if (fd >= 0)
+        close(fd);
+    if (!ok) {
+        static char message[] = "unable to write the event trace to ";
+        writeAll(2, message, sizeof(message) - 1);
+        writeAll(2, traceFileName, strlen(traceFileName));
+        writeAll(2, "\n", 1);
+    }
+}
+
+
+/* Writes the trace when the program is ended by sig, then lets sig
+   take its default action */
+static void flushOnSignal( int sig ) {
+    FlushEventTrace();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+
+/* Starts recording the events selected by the trace options in the
+   file fileName; methodFilter may be NULL */
+void InitEventTrace( char *fileName, char *methodFilter ) {
+    recordingEvents = 1;
+    traceFileName = fileName;
+    filter = methodFilter;
+    ring = SafeCalloc(EVENT_RING_SIZE, sizeof(TraceEvent));
+    methodNames = SafeCalloc(MAX_TRACED_METHODS + 1, sizeof(char *));
+    makeOpcodeNames();
+    atexit(FlushEventTrace);
+    signal(SIGINT, flushOnSignal);
+    signal(SIGTERM, flushOnSignal);
+    signal(SIGHUP, flushOnSignal);
+}
@@ -0,0 +1,51 @@
+/* EventTrace.h */
+
+#ifndef EVENTTRACEH
+
+#define EVENTTRACEH
+
+#include <stdint.h>
+
+/* values for the kind field of a TraceEvent */
+typedef enum {
+    EV_OP=1,            /* a bytecode op is executed */
+    EV_INVOKE,          /* an invoke op; value is its MethodRef index */
+    EV_PUSH,            /* value is pushed onto the JVM stack */
+    EV_POP,             /* value is popped from the JVM stack */
+    EV_PUSH_FRAME,      /* a frame is created for the method */
+    EV_POP_FRAME,       /* the frame of the method is removed */
+    EV_ALLOC,           /* value bytes are requested from the heap */
+    EV_GC               /* a collection reclaims value bytes */
+} TraceEventKind;
+
+/* One record of the event trace */
+typedef struct {
+    uint8_t  kind;      /* a TraceEventKind */
+    uint8_t  op;        /* the opcode, for EV_OP and EV_INVOKE */
+    uint16_t method;    /* id of the method of the top frame, 0 => none */
+    uint32_t pc;        /* offset of the op, for EV_OP and EV_INVOKE */
+    uint32_t height;    /* # items on the JVM stack */
+    uint32_t value;
+} TraceEvent;
+
+/* The trace file starts with this header.  The events follow, oldest
+   first, then the names of the 256 opcodes and the names of methods
+   1 to numMethods, each preceded by its length in a uint16_t.  Every
+   number is in the byte order of the machine which wrote the file. */
+typedef struct {
+    char     magic[4];  /* holds the chars 'JVMT' */
+    uint32_t version;   /* EVENT_TRACE_VERSION */
+    uint32_t numEvents;
+    uint32_t numLost;   /* # older events overwritten in the ring */
+    uint32_t numMethods;
+} TraceFileHeader;
+
+#define EVENT_TRACE_VERSION  1
+
+extern int recordingEvents;   /* true => trace output goes to the event trace */
+
+extern void InitEventTrace( char *fileName, char *methodFilter );
+extern void RecordEvent( int kind, int op, int pc, uint32_t value );
+extern void FlushEventTrace();
+
+#endif
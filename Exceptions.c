@@ -0,0 +1,415 @@
+/* Exceptions.c */
+
+/*
+   Throwing and catching exceptions.
+
+   When a class is loaded, the exception table of each method is decoded
+   into a handler index: the offsets of the code are split into ranges
+   at every start_pc and end_pc of the table, and each range lists the
+   handlers which cover it, in the order of the table.  Code which does
+   not throw does no work at all for the handlers that may be active.
+
+   A throw searches the frames from the top of the stack down.  For each
+   frame whose method has handlers, the range containing the frame's pc
+   is found by a binary search, and its handlers are tried in order
+   against the class of the exception.  When one matches, the frames
+   above it are popped, the operand stack of its frame is emptied except
+   for the exception, and execution resumes at the handler in the
+   activation of InterpretMethod which runs that frame (with a longjmp
+   which discards any C calls made since).  Methods with handlers are
+   never compiled, so the frame is always interpreted.  If no handler
+   is found, the exception is reported and the program halts.
+
+   The exceptions thrown by the JVM itself, and the exception classes of
+   java/lang created by the program, are ExceptionInstance objects
+   which record the name of their class.  Exception classes of the
+   program are ordinary classes which extend one of them.
+
+   An access through a null reference which is not checked explicitly
+   faults in the guard area at the start of the heap (see MyAlloc.c).
+   The SIGSEGV handler throws a NullPointerException from the current
+   instruction of the top frame: compiled code is located from the
+   faulting machine instruction (see JIT_LocateFault), and the
+   interpreter sets the pc of its frame before the accesses which rely
+   on the fault.  Since the exception is thrown with a longjmp out of
+   the handler, the handler is installed with SA_NODEFER, so that
+   SIGSEGV is not left blocked.  The same handler first lets the JVM
+   stack grow into the part of its mapping not yet accessible, or
+   reports a stack overflow or underflow (see JVM_StackFault).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <signal.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "ClassResolver.h"
+#include "NativeClasses.h"
+#include "MyAlloc.h"
+#include "JIT.h"
+#include "TraceOptions.h"
+#include "EventTrace.h"
+#include "MethodProfile.h"
+#include "Timeline.h"
+#include "PerfCounters.h"
+#include "Exceptions.h"
+
+/* Each call of InterpretMethod is an activation, which executes the
+   frames from entryFrame up to the entry frame of the next activation.
+   A handler found in one of its frames is reached by a longjmp to env,
+   and the phase of the performance counters is set back to the one in
+   which the activation began, as a <clinit> may have been abandoned. */
+typedef struct Activation {
+    Frame *entryFrame;
+    int phase;                  /* see PerfCounters.c */
+    sigjmp_buf env;
+    struct Activation *prev;
+} Activation;
+
+static Activation *activations = NULL;  /* the innermost activation */
+static int caughtHandlerPc;             /* where the handler reached begins */
+
+/* statistics */
+static long numThrown = 0;
+static long numCaught = 0;
+static long numFramesUnwound = 0;
+static long numNullTraps = 0;
+
+/* The exception classes of java/lang which the JVM knows, with their
+   superclasses */
+static char *javaThrowables[][2] = {
+    { "java/lang/Throwable",                      "java/lang/Object" },
+    { "java/lang/Exception",                      "java/lang/Throwable" },
+    { "java/lang/Error",                          "java/lang/Throwable" },
+    { "java/lang/RuntimeException",               "java/lang/Exception" },
+    { "java/lang/ArithmeticException",            "java/lang/RuntimeException" },
+    { "java/lang/ArrayStoreException",            "java/lang/RuntimeException" },
+    { "java/lang/ClassCastException",             "java/lang/RuntimeException" },
+    { "java/lang/IllegalArgumentException",       "java/lang/RuntimeException" },
+    { "java/lang/NumberFormatException",          "java/lang/IllegalArgumentException" },
+    { "java/lang/IllegalStateException",          "java/lang/RuntimeException" },
+    { "java/lang/IndexOutOfBoundsException",      "java/lang/RuntimeException" },
+    { "java/lang/ArrayIndexOutOfBoundsException", "java/lang/IndexOutOfBoundsException" },
+    { "java/lang/StringIndexOutOfBoundsException","java/lang/IndexOutOfBoundsException" },
+    { "java/lang/NegativeArraySizeException",     "java/lang/RuntimeException" },
+    { "java/lang/NullPointerException",           "java/lang/RuntimeException" },
+    { "java/lang/UnsupportedOperationException",  "java/lang/RuntimeException" },
+    { "java/lang/LinkageError",                   "java/lang/Error" },
+    { "java/lang/IncompatibleClassChangeError",   "java/lang/LinkageError" },
+    { "java/lang/IllegalAccessError",             "java/lang/IncompatibleClassChangeError" },
+    { "java/lang/VirtualMachineError",            "java/lang/Error" },
+    { "java/lang/OutOfMemoryError",               "java/lang/VirtualMachineError" },
+    { "java/lang/StackOverflowError",             "java/lang/VirtualMachineError" },
+    { NULL, NULL }
+};
+
+
+/* Returns the entry of javaThrowables for the class, or -1 */
+static int findThrowable( char *name ) {
+    int i;
+    for( i = 0;  javaThrowables[i][0] != NULL;  i++ ) {
+        if (strcmp(javaThrowables[i][0], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+
+/* Runs the current frame, frame, as a new activation.  The frames are
+   executed by run, which is restarted at the handler whenever one of
+   them catches an exception. */
+int RunActivation( Frame *frame, FrameRunner run ) {
+    Activation activation;
+    uint8_t *pc = frame->method->quickCode;
+    int rw;
+
+    activation.entryFrame = frame;
+    activation.phase = PerfCurrentPhase();
+    activation.prev = activations;
+    activations = &activation;
+    if (sigsetjmp(activation.env, 0) != 0)
+        pc = JVM_FrameTop->method->quickCode + caughtHandlerPc;
+    rw = run(JVM_FrameTop, activation.entryFrame, pc);
+    activations = activation.prev;
+    return rw;
+}
+
+
+/* Returns the JVM's copy of the name of an exception class of
+   java/lang, or NULL if it is not one that the JVM knows */
+char *FindJavaExceptionClass( char *name ) {
+    int i = findThrowable(name);
+    return (i < 0)? NULL : javaThrowables[i][0];
+}
+
+
+/* Returns true if the class name, which is in the java/... packages,
+   is target or one of its subclasses */
+int JavaClassExtends( char *name, char *target ) {
+    int i;
+    for( ; ; ) {
+        if (strcmp(name, target) == 0)
+            return 1;
+        i = findThrowable(name);
+        if (i < 0)
+            return 0;
+        name = javaThrowables[i][1];
+    }
+}
+
+
+HeapPointer NewExceptionInstance( char *className ) {
+    ExceptionInstance *e = MyHeapAlloc(sizeof(ExceptionInstance), CODE_EXCP);
+    e->className = className;
+    return MAKE_HEAP_REFERENCE(e);
+}
+
+
+static int readU2( u1 *p ) {
+    return (p[0]<<8) + p[1];
+}
+
+
+/* Builds the handler index of a method with an exception table */
+static HandlerIndex *buildHandlerIndex( method_info *m ) {
+    int n = m->exception_table_length;
+    HandlerIndex *hi = SafeMalloc(sizeof(HandlerIndex));
+    u2 *bounds = SafeCalloc(2*n, sizeof(u2));
+    int numBounds = 0, i, j, k;
+
+    hi->table = SafeCalloc(n, sizeof(ExceptionHandler));
+    for( i = 0;  i < n;  i++ ) {
+        u1 *p = m->exception_table + 8*i;
+        ExceptionHandler *eh = &hi->table[i];
+        eh->start_pc = readU2(p);
+        eh->end_pc = readU2(p+2);
+        eh->handler_pc = readU2(p+4);
+        eh->catch_type = readU2(p+6);
+        bounds[numBounds++] = eh->start_pc;
+        bounds[numBounds++] = eh->end_pc;
+    }
+    /* sort the boundaries of the ranges, dropping duplicates */
+    for( i = 1;  i < numBounds;  i++ ) {
+        u2 b = bounds[i];
+        for( j = i;  j > 0 && bounds[j-1] > b;  j-- )
+            bounds[j] = bounds[j-1];
+        bounds[j] = b;
+    }
+    for( i = j = 0;  i < numBounds;  i++ ) {
+        if (j == 0 || bounds[j-1] != bounds[i])
+            bounds[j++] = bounds[i];
+    }
+    hi->numRanges = j;
+    hi->ranges = SafeCalloc(j, sizeof(HandlerRange));
+    for( i = 0;  i < hi->numRanges;  i++ ) {
+        HandlerRange *r = &hi->ranges[i];
+        r->startPc = bounds[i];
+        r->handlers = SafeCalloc(n, sizeof(ExceptionHandler *));
+        for( k = 0;  k < n;  k++ ) {
+            ExceptionHandler *eh = &hi->table[k];
+            if (eh->start_pc <= r->startPc && r->startPc < eh->end_pc)
+                r->handlers[r->numHandlers++] = eh;
+        }
+    }
+    SafeFree(bounds);
+    return hi;
+}
+
+
+/* Builds the handler index of every method of a class being loaded */
+void IndexExceptionHandlers( ClassType *ct ) {
+    ClassFile *cf = ct->cf;
+    int i;
+
+    for( i = 0;  i < cf->methods_count;  i++ ) {
+        method_info *m = &cf->methods[i];
+        if (m->exception_table_length > 0)
+            m->handlerIndex = buildHandlerIndex(m);
+    }
+}
+
+
+/* Returns the offset of the handler for exception exc in the method of
+   frame f, which is executing the instruction at pcOffset, or -1 */
+static int findHandler( Frame *f, int pcOffset, HeapPointer exc ) {
+    HandlerIndex *index = f->method->handlerIndex;
+    HandlerRange *r;
+    int lo = 0, hi = index->numRanges - 1, i;
+
+    if (pcOffset < index->ranges[0].startPc)
+        return -1;
+    while(lo < hi) {    /* find the last range starting at or before pcOffset */
+        int mid = (lo + hi + 1) / 2;
+        if (index->ranges[mid].startPc <= pcOffset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    r = &index->ranges[lo];
+    for( i = 0;  i < r->numHandlers;  i++ ) {
+        ExceptionHandler *eh = r->handlers[i];
+        if (eh->catch_type == 0 || InstanceOf(f->thisClass, eh->catch_type, exc))
+            return eh->handler_pc;
+    }
+    return -1;
+}
+
+
+/* Pops the frames above f and continues at the handler in f, whose
+   operand stack holds only the exception */
+static void resumeAtHandler( Frame *f, int handlerPc, HeapPointer exc ) {
+    method_info *m = f->method;
+    Activation *a = activations;
+
+    while(a != NULL && a->entryFrame > f)
+        a = a->prev;
+    if (a == NULL) {
+        fprintf(stderr, "no interpreter activation for an exception handler\n");
+        exit(1);
+    }
+    numCaught++;
+    numFramesUnwound += JVM_FrameTop - f;
+    if (tracingExecution & TRACE_METHODS) {
+        Frame *g;
+        for( g = JVM_FrameTop;  g > f;  g-- )
+            ProfileExit(g);
+    }
+    TimelineUnwind(f);
+    PerfEnterPhase(a->phase);
+    JVM_FrameTop = f;
+    JVM_Top = f->locals - 1 + ((m->max_locals > m->nArgs)? m->max_locals : m->nArgs);
+    JVM_PushReference(exc);
+    activations = a;
+    caughtHandlerPc = handlerPc;
+    siglongjmp(a->env, 1);
+}
+
+
+static void reportUncaught( HeapPointer exc ) {
+    void *obj = REAL_HEAP_POINTER(exc);
+    Frame *f = JVM_FrameTop;
+    char *name;
+
+    if (*(uint32_t *)obj == CODE_EXCP) {
+        name = ((ExceptionInstance *)obj)->className;
+        if (strncmp(name, "java/lang/", 10) == 0)
+            name += 10;
+    } else
+        name = ((ClassInstance *)obj)->thisClass->cf->cname;
+    if (f > JVM_Frames)
+        fprintf(stderr, "Exception %s thrown at offset %d in method %s of class %s\n",
+            name, (int)(f->pc - 1 - f->method->quickCode),
+            GetUTF8(f->thisClass->cf, f->method->name_index),
+            f->thisClass->cf->cname);
+    else
+        fprintf(stderr, "Exception %s thrown\n", name);
+    exit(1);
+}
+
+
+/* Throws the exception exc, which is not null.  The pc of each frame
+   must be the address after the instruction being executed. */
+void ThrowObject( HeapPointer exc ) {
+    Frame *f;
+    int handlerPc;
+
+    numThrown++;
+    JVM_PushReference(exc);     /* it must survive a gc */
+    for( f = JVM_FrameTop;  f > JVM_Frames;  f-- ) {
+        if (f->method->handlerIndex == NULL)
+            continue;
+        handlerPc = findHandler(f, f->pc - 1 - f->method->quickCode, exc);
+        if (handlerPc >= 0)
+            resumeAtHandler(f, handlerPc, exc);
+    }
+    reportUncaught(exc);
+}
+
+
+/* Throws a new exception of one of the classes of java/lang, named
+   without the package, as in "NullPointerException" */
+void ThrowNew( char *kind ) {
+    char name[128];
+    char *className;
+
+    snprintf(name, sizeof(name), "java/lang/%s", kind);
+    className = FindJavaExceptionClass(name);
+    if (className == NULL) {
+        fprintf(stderr, "unknown exception class %s\n", name);
+        exit(1);
+    }
+    ThrowObject(NewExceptionInstance(className));
+}
+
+
+/* The handler of SIGSEGV.  A fault in the JVM stack is handled by
+   JVM_StackFault; a fault in the guard area of the heap is an access
+   through a null reference; any other fault is fatal, as usual,
+   once the default action is restored. */
+static void faultHandler( int sig, siginfo_t *info, void *context ) {
+    uint8_t *addr = info->si_addr;
+
+    if (JVM_StackFault(addr))
+        return;
+    if (addr < HeapStart || addr >= HeapStart + HEAP_GUARD_SIZE) {
+        FlushEventTrace();
+        signal(SIGSEGV, SIG_DFL);
+        raise(SIGSEGV);
+        return;
+    }
+    numNullTraps++;
+    JIT_LocateFault(context);
+    ThrowNew("NullPointerException");
+}
+
+
+/* Turns accesses through null references into NullPointerExceptions,
+   and handles accesses beyond the accessible part of the JVM stack */
+void InstallFaultHandler() {
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = faultHandler;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGSEGV, &sa, NULL) != 0) {
+        fprintf(stderr, "unable to install the SIGSEGV handler\n");
+        exit(1);
+    }
+}
+
+
+/* the constructors of the exception classes of java/lang; a message
+   passed to the constructor is not kept */
+
+static void exceptionInit() {
+    JVM_Pop();
+}
+
+static void exceptionInitMessage() {
+    JVM_Pop();
+    JVM_Pop();
+}
+
+void RegisterExceptionNatives() {
+    int i;
+    for( i = 0;  javaThrowables[i][0] != NULL;  i++ ) {
+        RegisterNative(javaThrowables[i][0], "<init>", "()V", exceptionInit);
+        RegisterNative(javaThrowables[i][0], "<init>", "(Ljava/lang/String;)V",
+            exceptionInitMessage);
+    }
+}
+
+
+void PrintExceptionStatistics() {
+    printf("\nException Statistics\n====================\n\n");
+    printf("  Number of exceptions thrown = %ld\n", numThrown);
+    printf("  Number of exceptions caught = %ld\n", numCaught);
+    printf("  Number of frames unwound = %ld\n", numFramesUnwound);
+    printf("  Number of null pointers trapped = %ld\n", numNullTraps);
+}
@@ -0,0 +1,46 @@
+/* Exceptions.h */
+
+#ifndef EXCEPTIONSH
+
+#define EXCEPTIONSH
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+
+/* One entry of the exception table of a method */
+typedef struct {
+    u2 start_pc, end_pc;          /* the code covered, end_pc excluded */
+    u2 handler_pc;
+    u2 catch_type;                /* a Class constant, 0 => any exception */
+} ExceptionHandler;
+
+/* A range of bytecode offsets which are covered by the same handlers */
+typedef struct {
+    u2 startPc;                   /* the range ends where the next begins */
+    u2 numHandlers;
+    ExceptionHandler **handlers;  /* in the order of the exception table */
+} HandlerRange;
+
+/* The handler index of a method, built when its class is loaded */
+typedef struct HandlerIndex {
+    int numRanges;
+    HandlerRange *ranges;         /* sorted by startPc */
+    ExceptionHandler *table;      /* the decoded exception table */
+} HandlerIndex;
+
+/* A function which executes the bytecode of frame, starting at pc,
+   until the method of entryFrame returns */
+typedef int (*FrameRunner)( Frame *frame, Frame *entryFrame, uint8_t *pc );
+
+extern int RunActivation( Frame *frame, FrameRunner run );
+extern void IndexExceptionHandlers( ClassType *ct );
+extern char *FindJavaExceptionClass( char *name );
+extern int JavaClassExtends( char *name, char *target );
+extern HeapPointer NewExceptionInstance( char *className );
+extern void ThrowObject( HeapPointer exc );
+extern void ThrowNew( char *kind );
+extern void InstallFaultHandler();
+extern void RegisterExceptionNatives();
+extern void PrintExceptionStatistics();
+
+#endif
@@ -3,9 +3,11 @@
 /*
    The interpreter for JVM bytecode instructions.
 
-   The bytecode is in exactly the same format as in the class file on disk.
-   That is, no preprocessing of the bytecode has been performed.  The
-   implication is that interpretation is much slower than it would be
+   The bytecode executed is the pre-decoded copy made by Predecode.c.
+   It has the same layout as the bytecode in the class file on disk,
+   except that some instructions are rewritten to use internal opcodes.
+   Apart from that, no preprocessing of the bytecode has been performed.
+   The implication is that interpretation is much slower than it would be
    in a production Java interpreter. 
 
    The list of JVM opcodes and their descriptions were copied in 2010 from
@@ -17,33 +19,39 @@
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <math.h>
 
 #include "ClassFileFormat.h"
 #include "jvm.h"
 #include "PrintByteCode.h"
 #include "TraceOptions.h"
+#include "EventTrace.h"
 #include "ClassResolver.h"
 #include "StringBuilder.h"
 #include "MyAlloc.h"
+#include "Predecode.h"
+#include "JIT.h"
+#include "Exceptions.h"
+#include "ArrayOps.h"
 #include "InterpretLoop.h"
 
 
-/* Exception handling is unimplemented, so we halt the program */
+/* Throws an exception of class java/lang/<kind> in method meth of
+   class ct, which is the method of the current frame; pc is the address
+   after the opcode of the instruction which fails.  This function does
+   not return (see Exceptions.c). */
 void throwException( char *kind, uint8_t *pc, method_info *meth, ClassType *ct ) {
-    int pcOffset = pc - 1 - meth->code;
-    fprintf(stderr, "Exception %s thrown at offset %d in method %s of class %s\n",
-    	kind, pcOffset,
-    	GetCPItemAsString(ct->cf, meth->name_index),
-    	GetCPItemAsString(ct->cf, ct->cf->this_class));
-    exit(1);
+    assert(JVM_FrameTop->method == meth);
+    JVM_FrameTop->pc = pc;
+    ThrowNew(kind);
 }
 
 
+/* Throws an exception from a method implemented in C; the current frame
+   is that of its caller */
 void throwExceptionExternal( char *kind, char *methodname, char *className ) {
-    fprintf(stderr, "Exception %s thrown in method %s of class %s\n",
-        kind, methodname, className);
-    exit(1);
+    ThrowNew(kind);
 }
 
 
@@ -75,15 +83,21 @@ static uint16_t uget2( uint8_t **pcp ) {
 }
 
 
+/* the number of ldc ops which found their string already created */
+static long internedStringHits = 0;
+
 /* implements the JVM ldc instruction (but also may be used during
    initialization of a class's static fields).
    i is the index in the constant pool belonging to class ct
    of the constant to push onto the stack.
+   The string for a String constant is created by the first ldc and
+   kept in the class's intern table, so that later ldc ops push the
+   same string without allocating.
 */
 void  PushConstant( ClassType *thisClass, int i ) {
-    StringInstance *p;
-    char *s;
     ConstantPoolItem *cpi = &thisClass->cf->cp_item[i];
+    int n = thisClass->cf->constant_pool_count;
+    char *s;
 
     switch(thisClass->cf->cp_tag[i]) {
     case CP_Integer:
@@ -93,11 +107,18 @@ void  PushConstant( ClassType *thisClass, int i ) {
         JVM_PushFloat(cpi->fval);
         break;
     case CP_String:
-        s = GetCPItemAsString(thisClass->cf,i);
-        p = MyHeapAlloc(sizeof(StringInstance));
-        p->kind = CODE_STRG;
-        p->sval = s;
-        JVM_PushReference(MAKE_HEAP_REFERENCE(p));
+        if (thisClass->internedStrings == NULL) {
+            thisClass->internedStrings = SafeCalloc(n, sizeof(HeapPointer));
+            AddGCRoots(thisClass->internedStrings, n);
+        }
+        if (thisClass->internedStrings[i] != NULL_HEAP_REFERENCE) {
+            internedStringHits++;
+            JVM_PushReference(thisClass->internedStrings[i]);
+            break;
+        }
+        s = (char *)(thisClass->cf->cp_item[cpi->ival].sval + 2);
+        thisClass->internedStrings[i] = AllocateString(s, strlen(s));
+        JVM_PushReference(thisClass->internedStrings[i]);
         break;
     default:
         fprintf(stderr, "invalid index into constant pool for PushConstant\n");
@@ -105,18 +126,182 @@ void  PushConstant( ClassType *thisClass, int i ) {
     }
 }
 
-/* Execute the bytecode for method, which belongs to the class referenced
-   by thisClass.
-   The localVariable parameter references variable #0 of the method on the
-   stack (which would be the first argument if the method has arguments).
-   The function returns a result which specifies how many stack slots
-   are needed for the method's returned value, i.e. 0 for a void method,
-   2 for a method which returns a double or long, and otherwise 1 */
-int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localVariable ) {
-    uint8_t *opcodeAddr, *code, *pc;
-    int i, j, dflt, offset, anIntValue, npairs, low, high;
+
+/* Report how many string allocations the intern tables avoided */
+void PrintInternStatistics() {
+    printf("\nString Constant Statistics\n==========================\n\n");
+    printf("  Number of ldc ops which reused an interned string = %ld\n",
+        internedStringHits);
+}
+
+
+/* Allocate a string holding the len characters at s */
+HeapPointer AllocateString( char *s, int len ) {
+    StringInstance *p = MyHeapAlloc(offsetof(StringInstance,chars) + len + 1,
+        CODE_STRG);
+    p->length = len;
+    memcpy(p->chars, s, len);
+    p->chars[len] = 0;
+    return MAKE_HEAP_REFERENCE(p);
+}
+
+
+/* Allocate an instance of the class identified by item ix in the
+   constant pool of class thisClass (the action of the new op) */
+HeapPointer AllocateInstance( ClassType *thisClass, int ix ) {
     ClassType *aClassType;
     ClassInstance *aClassInstance;
+
+    aClassType = ResolveClassReference(thisClass,ix);
+    if (aClassType == NULL) {
+        char *cn = GetCPItemAsString(thisClass->cf,ix);
+        char *en = FindJavaExceptionClass(cn);
+        if (en != NULL) {
+            free(cn);
+            return NewExceptionInstance(en);
+        }
+        if (strcmp(cn, "java/lang/StringBuilder") == 0)
+            aClassInstance = NewStringBuilderInstance();
+        else {    
+            fprintf(stderr, "Cannot resolve reference to class %s "
+                "(while executing new op)\n", cn);
+            free(cn);
+            exit(1);
+        }
+        free(cn);
+    } else {
+        aClassInstance = MyHeapAlloc(sizeof(ClassInstance)+
+                (aClassType->numInstanceFields-1)*sizeof(DataItem), CODE_INST);
+        aClassInstance->thisClass = aClassType;
+    }
+    return MAKE_HEAP_REFERENCE(aClassInstance);
+}
+
+
+/* Allocate an array of count simple values, where atype is the type
+   code used by the newarray op */
+HeapPointer AllocateSimpleArray( int atype, int count ) {
+    ArrayOfSimple *arrSimple;
+    int elemSize = 0;
+
+    switch(atype) {
+    case 4:   /* boolean elements */
+    case 5:   /* char elements */
+    case 8:   /* byte elements */
+        elemSize = 1;
+        break;
+    case 9:   /* short elements */
+        elemSize = 2;
+        break;
+    case 6:   /* float elements */
+    case 10:  /* int elements */
+        elemSize = 4;
+        break;
+    case 7:   /* double elements */
+    case 11:  /* long elements */
+        elemSize = 8;
+        break;
+    }
+    arrSimple = MyHeapAlloc(sizeof(ArrayOfSimple)+count*elemSize-8, CODE_ARRS);
+    arrSimple->size = count;
+    arrSimple->typecode = atype;
+    arrSimple->elemSize = elemSize;
+    return MAKE_HEAP_REFERENCE(arrSimple);
+}
+
+
+/* Allocate an array of count references, where the element type is
+   identified by item ix in the constant pool of class thisClass */
+HeapPointer AllocateRefArray( ClassType *thisClass, int ix, int count ) {
+    ClassType *aClassType;
+    ArrayOfRef *arr;
+
+    aClassType = ResolveClassReference(thisClass,ix);
+    arr = MyHeapAlloc(sizeof(ArrayOfRef)+(count-1)*4, CODE_ARRA);
+    arr->size = count;
+    // handle built-in types (eg String) where aClassType is NULL
+    arr->classRef = (aClassType==NULL)? NULL_HEAP_REFERENCE : MAKE_HEAP_REFERENCE(aClassType);
+    return MAKE_HEAP_REFERENCE(arr);
+}
+
+
+/* Perform the action of a call of a trivial method, where op is one of
+   the OP_xxx_inline opcodes and slot is the index of the field accessed.
+   The arguments of the call are on the stack.  Returns 0 if the receiver
+   is null, otherwise 1. */
+int InlinedAccess( int op, int slot ) {
+    HeapPointer hp;
+    ClassInstance *obj;
+    uint32_t hi, lo;
+
+    InlinedCalls++;
+    switch(op) {
+    case OP_getfield_inline:
+    case OP_getfield2_inline:
+        hp = JVM_Top->pval;
+        if (hp == NULL_HEAP_REFERENCE) return 0;
+        obj = REAL_HEAP_POINTER(hp);
+        JVM_Top->uval = obj->instField[slot].uval;
+        if (op == OP_getfield2_inline)
+            JVM_Push(obj->instField[slot+1].uval);
+        break;
+    case OP_putfield_inline:
+        lo = JVM_Pop();
+        hp = JVM_PopReference();
+        if (hp == NULL_HEAP_REFERENCE) return 0;
+        obj = REAL_HEAP_POINTER(hp);
+        obj->instField[slot].uval = lo;
+        break;
+    case OP_putfield2_inline:
+        lo = JVM_Pop();
+        hi = JVM_Pop();
+        hp = JVM_PopReference();
+        if (hp == NULL_HEAP_REFERENCE) return 0;
+        obj = REAL_HEAP_POINTER(hp);
+        obj->instField[slot].uval = hi;
+        obj->instField[slot+1].uval = lo;
+        break;
+    case OP_init_inline:
+        hp = JVM_PopReference();
+        if (hp == NULL_HEAP_REFERENCE) return 0;
+        break;
+    }
+    return 1;
+}
+
+
+/* Branch by offset from the instruction of length len which has just
+   been decoded; a backward branch closes a loop, which is counted */
+#define TAKE_BRANCH(len) \
+    do { \
+        pc = (pc-(len)) + offset; \
+        if (offset < 0) goto backwardBranch; \
+    } while(0)
+
+
+/* Throw ArrayIndexOutOfBoundsException unless the index in stack item
+   ix is in bounds of the array in item ix-1, which is known not to be
+   null; used by the OP_xxx_nonnull array accesses */
+#define CHECK_INDEX(ix) \
+    do { \
+        arr = REAL_HEAP_POINTER((ix)[-1].pval); \
+        if ((ix)->ival < 0 || (ix)->ival >= arr->size) \
+            throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass); \
+    } while(0)
+
+
+/* Execute the bytecode of the current frame, starting at pc, until the
+   method of entryFrame returns (see InterpretMethod) */
+static int interpretFrames( Frame *frame, Frame *entryFrame, uint8_t *pc ) {
+    ClassType *thisClass = frame->thisClass;
+    method_info *method = frame->method;
+    DataItem *localVariable = frame->locals;
+    uint8_t *opcodeAddr, *code = method->quickCode;
+    int32_t *table;
+    ArrayLoop *aLoop;
+    int i, j, dflt, offset, anIntValue, npairs, low, high, rw;
+    ClassType *aClassType;
+    method_info *aMethod;
     ConstantPoolItem *aConstPoolItem;
     ArrayOfRef *arr;
     ArrayOfSimple *arrSimple;
@@ -129,11 +314,14 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
     uint32_t  u;
     union { int64_t lval;  double dval;  int32_t ival[2];  uint32_t uval[2]; } pair;
 
-	pc = code = method->code;
     for( ; ; ) {
         uint8_t op = *pc++;
-        if (tracingExecution & TRACE_OPS)
-            fprintf(stdout, "%d: %s\n", (int)(pc-1-code), GetOpcodeName(op));
+        if (tracingExecution & TRACE_OPS) {
+            if (recordingEvents)
+                RecordEvent(EV_OP, op, pc-1-code, 0);
+            else
+                fprintf(stdout, "%d: %s\n", (int)(pc-1-code), GetOpcodeName(op));
+        }
         switch(op) {
         case OP_aaload:
             /*  arrayref, index --> value
@@ -148,6 +336,18 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             arr = REAL_HEAP_POINTER(JVM_Top->pval);
             JVM_Top->pval = arr->elements[i];
             break;
+        case OP_aaload_nonnull:
+            /*  as aaload, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX(JVM_Top);
+            /* fall through */
+        case OP_aaload_quick:
+            /*  as aaload, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            i = JVM_Pop();
+            arr = REAL_HEAP_POINTER(JVM_Top->pval);
+            JVM_Top->pval = arr->elements[i];
+            break;
         case OP_aastore:
             /*  arrayref, index, value -->
                 stores a reference into an array */
@@ -160,6 +360,21 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             if (i<0 || i>=arr->size)
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             arr->elements[i] = anotherHeapRef;
+            GC_WRITE_BARRIER(arr);
+            break;
+        case OP_aastore_nonnull:
+            /*  as aastore, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX((JVM_Top-1));
+            /* fall through */
+        case OP_aastore_quick:
+            /*  as aastore, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            anotherHeapRef = JVM_PopReference();
+            i = JVM_Pop();
+            arr = REAL_HEAP_POINTER(JVM_PopReference());
+            arr->elements[i] = anotherHeapRef;
+            GC_WRITE_BARRIER(arr);
             break;
         case OP_aconst_null:
             /*  --> null 	pushes a null reference onto the stack */
@@ -185,23 +400,34 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 and component type identified by the class reference index
                 (indexbyte1 << 8 + indexbyte2) in the constant pool */
             i = uget2(&pc);
-            aClassType = ResolveClassReference(thisClass,i);
-            i = JVM_Top->ival;
-            if (i < 0)
+            frame->pc = pc;     /* locates an exception thrown below */
+            if (JVM_Top->ival < 0)
                 throwException("NegativeArraySizeException",pc,method,thisClass);
-            arr = MyHeapAlloc(sizeof(ArrayOfRef)+(i-1)*4);
-            arr->kind = CODE_ARRA;
-            arr->size = i;
-            // handle built-in types (eg String) where aClassType is NULL
-            arr->classRef = (aClassType==NULL)? NULL_HEAP_REFERENCE : MAKE_HEAP_REFERENCE(aClassType);
-            JVM_Top->pval = MAKE_HEAP_REFERENCE(arr);
+            JVM_Top->pval = AllocateRefArray(thisClass, i, JVM_Top->ival);
             break;
         case OP_areturn:
             /*  objectref --> [empty] 	returns a reference from a method */
-            localVariable[0].pval = JVM_PopReference();
-            return 1;
+            // the return value is left on the stack
+            rw = 1;
+            goto methodReturn;
+        case OP_arrayloop_quick:
+            /*  the iload of the index at the head of a copy or fill loop
+                (see Predecode.c); the loop's iterations which cannot throw
+                are performed at once, then the iload is executed */
+            aLoop = FindArrayLoop(method, pc-1-code);
+            RunArrayLoop(aLoop, localVariable);
+            JVM_Push(localVariable[aLoop->index].ival);
+            pc += aLoop->headLength - 1;
+            break;
         case OP_arraylength:
             /*  arrayref --> length 	gets the length of an array */
+            if (JVM_Top->pval == NULL_HEAP_REFERENCE)
+                throwException("NullPointerException",pc,method,thisClass);
+            arr = REAL_HEAP_POINTER(JVM_Top->pval);
+            JVM_Top->ival = arr->size;
+            break;
+        case OP_arraylength_quick:
+            /*  as arraylength, where the array is known not to be null */
             arr = REAL_HEAP_POINTER(JVM_Top->pval);
             JVM_Top->ival = arr->size;
             break;
@@ -221,7 +447,10 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             /*  objectref --> [empty], objectref
                 throws an error or exception (notice that the rest of the
                 stack is cleared, leaving only a reference to the Throwable) */
-            throwException("???",pc,method,thisClass);
+            if (JVM_Top->pval == NULL_HEAP_REFERENCE)
+                throwException("NullPointerException",pc,method,thisClass);
+            frame->pc = pc;
+            ThrowObject(JVM_Top->pval);
             break;
         case OP_baload:
         case OP_caload:
@@ -237,13 +466,27 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             JVM_Top->ival = arrSimple->u.bval[i];
             break;
+        case OP_baload_nonnull:
+        case OP_caload_nonnull:
+            /*  as baload and caload, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX(JVM_Top);
+            /* fall through */
+        case OP_baload_quick:
+        case OP_caload_quick:
+            /*  as baload and caload, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_Top->pval);
+            JVM_Top->ival = arrSimple->u.bval[i];
+            break;
         case OP_bastore:
         case OP_castore:
             /*  arrayref, index, value -->
                 stores a byte / Boolean / char value into an array */
             anIntValue = JVM_Pop();
             i = JVM_Pop();
-            aHeapReference = JVM_Top->pval;
+            aHeapReference = JVM_PopReference();
             if (aHeapReference == NULL_HEAP_REFERENCE)
                 throwException("NullPointerException",pc,method,thisClass);
             arrSimple = REAL_HEAP_POINTER(aHeapReference);
@@ -251,6 +494,21 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             arrSimple->u.bval[i] = anIntValue;
             break;
+        case OP_bastore_nonnull:
+        case OP_castore_nonnull:
+            /*  as bastore and castore, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX((JVM_Top-1));
+            /* fall through */
+        case OP_bastore_quick:
+        case OP_castore_quick:
+            /*  as bastore and castore, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            anIntValue = JVM_Pop();
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_PopReference());
+            arrSimple->u.bval[i] = anIntValue;
+            break;
         case OP_bipush:  /*  byte  */
             /*  --> value 	pushes a byte onto the stack as an integer value */
             i = (signed char)(*pc++);
@@ -261,18 +519,18 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 should check whether an objectref is of a certain type,
                 the class reference of which is in the constant pool at index
                 (indexbyte1 << 8 + indexbyte2) */
-            i = iget2(&pc);
-            aClassType = ResolveClassReference(thisClass, i);
-            /* however the check is unimplemented and ignored -- we assume the
-               check succeeds
-            */
+            i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
+            if (JVM_Top->pval != NULL_HEAP_REFERENCE
+                    && !InstanceOf(thisClass, i, JVM_Top->pval))
+                throwException("ClassCastException",pc-2,method,thisClass);
             break;
         case OP_d2f:
             /*  value --> result 	converts a double to a float */
             pair.uval[1] = JVM_Pop();
             pair.uval[0] = JVM_Pop();
             floatVal = pair.dval;
-            JVM_Push((uint32_t)floatVal);            
+            JVM_PushFloat(floatVal);
             break;
         case OP_d2i:
             /*  value --> result 	converts a double to an int */
@@ -314,12 +572,28 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             (JVM_Top-1)->uval = pair.uval[0];
             JVM_Top->uval     = pair.uval[1];
             break;
+        case OP_daload_nonnull:
+        case OP_laload_nonnull:
+            /*  as daload and laload, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX(JVM_Top);
+            /* fall through */
+        case OP_daload_quick:
+        case OP_laload_quick:
+            /*  as daload and laload, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            i = JVM_Top->ival;
+            arrSimple = REAL_HEAP_POINTER((JVM_Top-1)->pval);
+            pair.lval = arrSimple->u.lval[i];
+            (JVM_Top-1)->uval = pair.uval[0];
+            JVM_Top->uval     = pair.uval[1];
+            break;
         case OP_dastore:
             /*  arrayref, index, value --> 	stores a double into an array */
             pair.uval[1] = JVM_Pop();
             pair.uval[0] = JVM_Pop();
-            i = JVM_Top->ival;
-            aHeapReference = (JVM_Top-1)->pval;
+            i = JVM_Pop();
+            aHeapReference = JVM_PopReference();
             if (aHeapReference == NULL_HEAP_REFERENCE)
                 throwException("NullPointerException",pc,method,thisClass);
             arrSimple = REAL_HEAP_POINTER(aHeapReference);
@@ -327,6 +601,22 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             arrSimple->u.dval[i] = pair.dval;
             break;
+        case OP_dastore_nonnull:
+        case OP_lastore_nonnull:
+            /*  as dastore and lastore, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX((JVM_Top-2));
+            /* fall through */
+        case OP_dastore_quick:
+        case OP_lastore_quick:
+            /*  as dastore and lastore, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            pair.uval[1] = JVM_Pop();
+            pair.uval[0] = JVM_Pop();
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_PopReference());
+            arrSimple->u.lval[i] = pair.lval;
+            break;
         case OP_dcmpg:
         case OP_dcmpl:
             /*  value1, value2 --> result 	compares two doubles */
@@ -407,7 +697,8 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
         case OP_dreturn:
             /*  value --> [empty] 	returns a double from a method */
             // the return value is left on the stack
-            return 2;
+            rw = 2;
+            goto methodReturn;
         case OP_dstore:  /*  index  */
             /*  value -->
                 stores a double value into a local variable #index */
@@ -511,7 +802,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             /*  arreyref, index, value --> 	stores a float in an array */
             floatVal = JVM_PopFloat();
             i = JVM_Pop();
-            aHeapReference = JVM_Top->pval;
+            aHeapReference = JVM_PopReference();
             if (aHeapReference == NULL_HEAP_REFERENCE)
                 throwException("NullPointerException",pc,method,thisClass);
             arrSimple = REAL_HEAP_POINTER(aHeapReference);
@@ -569,7 +860,8 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
         case OP_freturn:
             /*  value --> [empty] 	returns a float */
             // the return value is left on the stack
-            return 1;
+            rw = 1;
+            goto methodReturn;
         case OP_fstore:  /* index */
             /*  value -->
                 stores a float value into a local variable #index */
@@ -592,6 +884,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             /*  index1, index2 	objectref --> value
                 gets a field value of an object objectref, where the field
                 is identified by field reference index in the constant pool */
+            frame->pc = pc;     /* locates a NullPointerException */
             i = uget2(&pc);
             if (!GetField(thisClass,i))
                 throwException("IllegalAccessError",pc-2,method,thisClass);
@@ -601,20 +894,21 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 gets a static field value of a class, where the field is
                 identified by field reference in the constant pool index */
             i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
             if (!GetStatic(thisClass,i))
                 throwException("IllegalAccessError",pc-2,method,thisClass);
             break;
         case OP_goto:
             /*  branchbyte1, branchbyte2 	[no change]
                 goes to another instruction at branchoffset */
-            shortVal = iget2(&pc);
-            pc = (pc - 3) + shortVal;
+            offset = iget2(&pc);
+            TAKE_BRANCH(3);
             break;
         case OP_goto_w :
             /*  branchbyte1, branchbyte2, branchbyte3, branchbyte4 	[no change]
                 goes to another instruction at branchoffset */
             offset = iget4(&pc);
-            pc = (pc-5) + offset;
+            TAKE_BRANCH(5);
             break;
         case OP_i2b:
             /*  value --> result 	converts an int into a byte */
@@ -622,7 +916,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             break;
         case OP_i2c:
             /*  value --> result 	converts an int into a character */
-            JVM_Top->ival = (JVM_Top->ival) & 0xff;
+            JVM_Top->ival = (JVM_Top->ival) & 0xffff;
             break;
         case OP_i2d:
             /*  value --> result 	converts an int into a double */
@@ -660,6 +954,20 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             JVM_Top->ival = arrSimple->u.ival[i];
             break;
+        case OP_faload_nonnull:
+        case OP_iaload_nonnull:
+            /*  as faload and iaload, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX(JVM_Top);
+            /* fall through */
+        case OP_faload_quick:
+        case OP_iaload_quick:
+            /*  as faload and iaload, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_Top->pval);
+            JVM_Top->ival = arrSimple->u.ival[i];
+            break;
         case OP_iand:
             /*  value1, value2 --> result 	performs a logical and on two integers */
             i = JVM_Pop();
@@ -669,7 +977,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             /*  arrayref, index, value --> 	stores an int into an array */
             anIntValue = JVM_Pop();
             i = JVM_Pop();
-            aHeapReference = JVM_Top->pval;
+            aHeapReference = JVM_PopReference();
             if (aHeapReference == NULL_HEAP_REFERENCE)
                 throwException("NullPointerException",pc,method,thisClass);
             arrSimple = REAL_HEAP_POINTER(aHeapReference);
@@ -677,6 +985,21 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             arrSimple->u.ival[i] = anIntValue;
             break;
+        case OP_fastore_nonnull:
+        case OP_iastore_nonnull:
+            /*  as fastore and iastore, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX((JVM_Top-1));
+            /* fall through */
+        case OP_fastore_quick:
+        case OP_iastore_quick:
+            /*  as fastore and iastore, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            anIntValue = JVM_Pop();
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_PopReference());
+            arrSimple->u.ival[i] = anIntValue;
+            break;
         case OP_iconst_m1:
         case OP_iconst_0:
         case OP_iconst_1:
@@ -690,137 +1013,142 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
         case OP_idiv:
             /*  value1, value2 --> result 	divides two integers */
             i = JVM_Pop();
-            JVM_Top->ival /= i;
+            if (i == 0)
+                throwException("ArithmeticException",pc,method,thisClass);
+            if (i == -1)    /* MIN_INT / -1 overflows to MIN_INT in Java */
+                JVM_Top->uval = -JVM_Top->uval;
+            else
+                JVM_Top->ival /= i;
             break;
         case OP_if_acmpeq:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 --> 
                 if references are equal, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             u = JVM_Pop();
             if (JVM_Pop() == u)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_acmpne:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 -->
                 if references are not equal, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             u = JVM_Pop();
             if (JVM_Pop() != u)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_icmpeq:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 --> 
                 if value1 == value2, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             j = (int)JVM_Pop();
             if (j == i)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_icmpne:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 -->
                 if value1 != value2, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             j = (int)JVM_Pop();
             if (j != i)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_icmplt:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 -->
                 if value1 < value2, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             j = (int)JVM_Pop();;
             if (j < i)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_icmpge:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 -->
                 if value1 >= value2, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             j = (int)JVM_Pop();
             if (j >= i)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_icmpgt:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 -->
                 if value1 > value2, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             j = (int)JVM_Pop();
             if (j > i)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_if_icmple:  /*  branchbyte1, branchbyte2 */
             /*  value1, value2 -->
                 if value1 <= value2, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             j = (int)JVM_Pop();
             if (j <= i)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifeq:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value == 0, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             if (JVM_Pop() == 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifne:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value != 0, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             if (JVM_Pop() != 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_iflt:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value < 0, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             if (i < 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifge:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value is >= 0, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             if (i >= 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifgt:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value > 0, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             if (i > 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifle:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value <= 0, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             i = (int)JVM_Pop();
             if (i <= 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifnonnull:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value is not null, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             if (JVM_Pop() != 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_ifnull:  /*  branchbyte1, branchbyte2 */
             /*  value -->
                 if value is null, branch to instruction at branchoffset */
-            offset = uget2(&pc);
+            offset = iget2(&pc);
             if (JVM_Pop() == 0)
-                pc = (pc-3) + offset;
+                TAKE_BRANCH(3);
             break;
         case OP_iinc:  /*  index, const  */
             /*  [No change]
@@ -856,7 +1184,10 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             		objectref --> result
                 determines if an object objectref is of a given type,
                 identified by class reference index in constant pool */
-            fprintf(stderr,"unimplemented op: instanceof\n");
+            i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
+            JVM_Top->ival = (JVM_Top->pval == NULL_HEAP_REFERENCE)? 0
+                : InstanceOf(thisClass, i, JVM_Top->pval);
             break;
         case OP_invokeinterface:
             /*  indexbyte1, indexbyte2, count, 0
@@ -871,36 +1202,57 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 invoke instance method on object objectref, where the method
                 is identified by method reference index in constant pool */
             i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
             if (tracingExecution & TRACE_INVOKES) {
-                char *s = GetCPItemAsString(thisClass->cf,i);
-                fprintf(stdout, "    Invoking special method %s...\n", s);
-                free(s);
+                if (recordingEvents)
+                    RecordEvent(EV_INVOKE, OP_invokespecial, pc-3-code, i);
+                else {
+                    char *s = GetCPItemAsString(thisClass->cf,i);
+                    fprintf(stdout, "    Invoking special method %s...\n", s);
+                    free(s);
+                }
             }
-            InvokeSpecialMethod(thisClass,i);
+            aMethod = ResolveSpecialMethod(thisClass,i,&aClassType);
+            if (aMethod != NULL)
+                goto methodCall;
             break;
         case OP_invokestatic:  /*  indexbyte1, indexbyte2  */
             /*  [arg1, arg2, ...] -->
                 invoke a static method, where the method is identified by
                 method reference index in constant pool */
             i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
             if (tracingExecution & TRACE_INVOKES) {
-                char *s = GetCPItemAsString(thisClass->cf,i);
-                fprintf(stdout, "    Invoking static method %s...\n", s);
-                free(s);
+                if (recordingEvents)
+                    RecordEvent(EV_INVOKE, OP_invokestatic, pc-3-code, i);
+                else {
+                    char *s = GetCPItemAsString(thisClass->cf,i);
+                    fprintf(stdout, "    Invoking static method %s...\n", s);
+                    free(s);
+                }
             }
-            InvokeStaticMethod(thisClass,i);
+            aMethod = ResolveStaticMethod(thisClass,i,&aClassType);
+            if (aMethod != NULL)
+                goto methodCall;
             break;
         case OP_invokevirtual:  /*  indexbyte1, indexbyte2 	*/
             /*  objectref, [arg1, arg2, ...] -->
                 invoke virtual method on object objectref, where the method
                 is identified by method reference index in constant pool */
             i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
             if (tracingExecution & TRACE_INVOKES) {
-                char *s = GetCPItemAsString(thisClass->cf,i);
-                fprintf(stdout, "    Invoking virtual method %s...\n", s);
-                free(s);
+                if (recordingEvents)
+                    RecordEvent(EV_INVOKE, OP_invokevirtual, pc-3-code, i);
+                else {
+                    char *s = GetCPItemAsString(thisClass->cf,i);
+                    fprintf(stdout, "    Invoking virtual method %s...\n", s);
+                    free(s);
+                }
             }
-            InvokeVirtualMethod(thisClass,i);
+            aMethod = ResolveVirtualMethod(thisClass,method,(pc-3)-code,i,&aClassType);
+            if (aMethod != NULL)
+                goto methodCall;
             break;
         case OP_ior:
             /*  value1, value2 --> result 	logical int or */
@@ -910,12 +1262,18 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
         case OP_irem:
             /*  value1, value2 --> result 	logical int remainder */
             i = JVM_Pop();
-            JVM_Top->ival %= i;
+            if (i == 0)
+                throwException("ArithmeticException",pc,method,thisClass);
+            if (i == -1)
+                JVM_Top->ival = 0;
+            else
+                JVM_Top->ival %= i;
             break;
         case OP_ireturn:
             /*  value --> [empty] 	returns an integer from a method */
             // the return value is left on the stack
-            return 1;
+            rw = 1;
+            goto methodReturn;
         case OP_ishl:
             /*  value1, value2 --> result 	int shift left */
             i = JVM_Pop();
@@ -945,9 +1303,9 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             JVM_Top->ival -= i;
             break;
         case OP_iushr:
-            /*  value1, value2 --> result 	int shift right */
+            /*  value1, value2 --> result 	int shift right, unsigned */
             i = JVM_Pop();
-            JVM_Top->ival >>= i;
+            JVM_Top->uval >>= (i & 0x1f);
             break;
         case OP_ixor:
             /*  value1, value2 --> result 	int xor */
@@ -1025,8 +1383,8 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             /*  arrayref, index, value --> 	   store a long to an array */
             pair.uval[1] = JVM_Pop();
             pair.uval[0] = JVM_Pop();
-            i = JVM_Top->ival;
-            aHeapReference = (JVM_Top-1)->pval;
+            i = JVM_Pop();
+            aHeapReference = JVM_PopReference();
             if (aHeapReference == NULL_HEAP_REFERENCE)
                 throwException("NullPointerException",pc,method,thisClass);
             arrSimple = REAL_HEAP_POINTER(aHeapReference);
@@ -1080,7 +1438,12 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             longVal = pair.lval;
             pair.uval[1] = JVM_Top->uval;
             pair.uval[0] = (JVM_Top-1)->uval;
-            pair.lval /= longVal;
+            if (longVal == 0)
+                throwException("ArithmeticException",pc,method,thisClass);
+            if (longVal == -1)
+                pair.lval = -(uint64_t)pair.lval;
+            else
+                pair.lval /= longVal;
             JVM_Top->uval = pair.uval[1];
             (JVM_Top-1)->uval = pair.uval[0];
             break;
@@ -1136,6 +1499,28 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             if (npairs < 0) offset = dflt;
             pc = opcodeAddr + offset;
             break;
+        case OP_lookupswitch_quick:
+            /*  as lookupswitch, with the default, npairs and the pairs in
+                native byte order (see Predecode.c); the keys are sorted */
+            opcodeAddr = pc-1;
+            i = JVM_Pop();
+            table = (int32_t *)(code + ((pc - code + 3) & 0xFFFFFFFC));
+            low = 0;
+            high = table[1] - 1;
+            offset = table[0];
+            while(low <= high) {
+                j = (low + high) >> 1;
+                if (table[2+2*j] < i)
+                    low = j + 1;
+                else if (table[2+2*j] > i)
+                    high = j - 1;
+                else {
+                    offset = table[3+2*j];
+                    break;
+                }
+            }
+            pc = opcodeAddr + offset;
+            break;
         case OP_lor:
             /*  value1, value2 --> result 	bitwise or of two longs */
             /*  value1, value2 --> result 	bitwise and of two longs */
@@ -1151,15 +1536,20 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             longVal = pair.lval;
             pair.uval[1] = JVM_Top->uval;
             pair.uval[0] = (JVM_Top-1)->uval;
-            pair.lval %= longVal;
+            if (longVal == 0)
+                throwException("ArithmeticException",pc,method,thisClass);
+            if (longVal == -1)
+                pair.lval = 0;
+            else
+                pair.lval %= longVal;
             JVM_Top->uval     = pair.uval[1];
             (JVM_Top-1)->uval = pair.uval[0];
             break;
         case OP_lreturn:
             /*  value --> [empty] 	returns a long value */
-            localVariable[1].uval = JVM_Pop();
-            localVariable[0].uval = JVM_Pop();
-            return 2;
+            // the return value is left on the stack
+            rw = 2;
+            goto methodReturn;
         case OP_lshl:
             /*  value1, value2 --> result
                 bitwise shift left of a long value1 by value2 positions */
@@ -1212,7 +1602,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             i = JVM_Pop();
             pair.uval[1] = JVM_Top->uval;
             pair.uval[0] = (JVM_Top-1)->uval;
-            pair.lval >>= i;
+            pair.lval = (uint64_t)pair.lval >> (i & 0x3f);
             JVM_Top->uval     = pair.uval[1];
             (JVM_Top-1)->uval = pair.uval[0];
             break;
@@ -1250,25 +1640,8 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 creates new object of type identified by class reference in
                 constant pool at given index */
             i = uget2(&pc);
-            aClassType = ResolveClassReference(thisClass,i);
-            if (aClassType == NULL) {
-                char *cn = GetCPItemAsString(thisClass->cf,i);
-                if (strcmp(cn, "java/lang/StringBuilder") == 0)
-                    aClassInstance = NewStringBuilderInstance();
-                else {    
-                    fprintf(stderr, "Cannot resolve reference to class %s "
-                        "(while executing new op)\n", cn);
-                    free(cn);
-                    exit(1);
-                }
-				free(cn);
-            } else {
-                aClassInstance = MyHeapAlloc(sizeof(ClassInstance)+
-                        (aClassType->numInstanceFields-1)*sizeof(DataItem));
-                aClassInstance->kind = CODE_INST;
-                aClassInstance->thisClass = aClassType;
-            }
-            JVM_PushReference(MAKE_HEAP_REFERENCE(aClassInstance));
+            frame->pc = pc;     /* locates an exception thrown below */
+            JVM_PushReference(AllocateInstance(thisClass, i));
             break;
         case OP_newarray:  /*  atype  */
             /*  count --> arrayref 
@@ -1278,31 +1651,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             anIntValue = JVM_Pop();
             if (anIntValue < 0)
                 throwException("NegativeArraySizeException",pc,method,thisClass);
-            switch(i) {
-            case 4:   /* boolean elements */
-            case 5:   /* char elements */
-            case 8:   /* byte elements */
-                shortVal = 1;
-                break;
-            case 9:   /* short elements */
-                shortVal = 2;
-                break;
-            case 6:   /* float elements */
-            case 10:  /* int elements */
-                shortVal = 4;
-                break;
-            case 7:   /* double elements */
-            case 11:  /* long elements */
-                shortVal = 8;
-                break;
-            }
-            arrSimple = MyHeapAlloc(sizeof(ArrayOfSimple)+anIntValue*shortVal-8);
-            arrSimple->kind = CODE_ARRS;
-            arrSimple->size = anIntValue;
-            arrSimple->typecode = i;
-            arrSimple->elemSize = shortVal;
-            aHeapReference = MAKE_HEAP_REFERENCE(arrSimple);
-            JVM_PushReference(aHeapReference);
+            JVM_PushReference(AllocateSimpleArray(i, anIntValue));
             break;
         case OP_nop:
             /*  [No change] 	performs no operation */
@@ -1322,6 +1671,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             /*  objectref, value -->
                 set field to value in an object objectref, where the field is
                 identified by a field reference index in constant pool */
+            frame->pc = pc;     /* locates a NullPointerException */
             i = uget2(&pc);
             if (!PutField(thisClass,i))
                 throwException("IllegalAccessError",pc-2,method,thisClass);
@@ -1331,6 +1681,7 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 set static field to value in a class, where the field is
                 identified by a field reference index in constant pool  */
             i = uget2(&pc);
+            frame->pc = pc;     /* locates an exception thrown below */
             if (!PutStatic(thisClass,i))
                 throwException("IllegalAccessError",pc-2,method,thisClass);
             break;
@@ -1343,7 +1694,8 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             break;
         case OP_return:
             /*  --> [empty] 	return void from method */
-            return 0;
+            rw = 0;
+            goto methodReturn;
         case OP_saload:
             /*  arrayref, index --> value 	load short from array */
             i = JVM_Pop();
@@ -1355,11 +1707,23 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             JVM_Top->ival = arrSimple->u.hval[i];
             break;
+        case OP_saload_nonnull:
+            /*  as saload, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX(JVM_Top);
+            /* fall through */
+        case OP_saload_quick:
+            /*  as saload, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_Top->pval);
+            JVM_Top->ival = arrSimple->u.hval[i];
+            break;
         case OP_sastore:
             /*  arrayref, index, value --> 	store short to array */
             anIntValue = JVM_Pop();
             i = JVM_Pop();
-            aHeapReference = JVM_Top->pval;
+            aHeapReference = JVM_PopReference();
             if (aHeapReference == NULL_HEAP_REFERENCE)
                 throwException("NullPointerException",pc,method,thisClass);
             arrSimple = REAL_HEAP_POINTER(aHeapReference);
@@ -1367,6 +1731,19 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 throwException("ArrayIndexOutOfBoundsException",pc,method,thisClass);
             arrSimple->u.hval[i] = anIntValue;
             break;
+        case OP_sastore_nonnull:
+            /*  as sastore, where the pre-decoder has proven that the array
+                is not null (see BoundsCheck.c); only the index is checked */
+            CHECK_INDEX((JVM_Top-1));
+            /* fall through */
+        case OP_sastore_quick:
+            /*  as sastore, where the pre-decoder has proven that the array is
+                not null and the index is in bounds (see BoundsCheck.c) */
+            anIntValue = JVM_Pop();
+            i = JVM_Pop();
+            arrSimple = REAL_HEAP_POINTER(JVM_PopReference());
+            arrSimple->u.hval[i] = anIntValue;
+            break;
         case OP_sipush:
             /*  byte1, byte2 	--> value 
                 pushes a 16-bit signed integer onto the stack */
@@ -1398,6 +1775,18 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
             }
             pc = opcodeAddr + offset;
             break;
+        case OP_tableswitch_quick:
+            /*  as tableswitch, with the default, low, high and the jump
+                offsets in native byte order (see Predecode.c) */
+            opcodeAddr = pc-1;
+            i = JVM_Pop();
+            table = (int32_t *)(code + ((pc - code + 3) & 0xFFFFFFFC));
+            u = (uint32_t)i - (uint32_t)table[1];
+            if (u <= (uint32_t)table[2] - (uint32_t)table[1])
+                pc = opcodeAddr + table[3+u];
+            else
+                pc = opcodeAddr + table[0];
+            break;
         case OP_wide:
             /*  opcode, indexbyte1, indexbyte2 or
                 iinc, indexbyte1, indexbyte2, countbyte1, countbyte2
@@ -1424,8 +1813,94 @@ int InterpretMethod( ClassType *thisClass, method_info *method, DataItem *localV
                 debuggers; should not appear in any class file */
             fprintf(stderr,"unimplemented op: impdep2\n");
             break;
+        case OP_getfield_inline:
+        case OP_getfield2_inline:
+        case OP_putfield_inline:
+        case OP_putfield2_inline:
+        case OP_init_inline:
+            /*  opcode, slotbyte1, slotbyte2
+                replaces a call of a trivial method; see Predecode.c */
+            i = uget2(&pc);
+            if (!InlinedAccess(op, i))
+                throwException("NullPointerException",pc-2,method,thisClass);
+            break;
         default:
             fprintf(stderr,"unimplemented op with code %d\n", op);
         }
+        continue;
+
+    backwardBranch:
+        /* pc is the target of a backward branch at offset pc-offset.
+           Once the loop is hot, the method continues in compiled code
+           from the branch target; the compiled code uses the same frame
+           and operand stack, so nothing needs to be converted. */
+        if (JIT_CountLoop(thisClass, method, (pc-code)-offset)) {
+            frame->pc = pc;
+            rw = JIT_RunFromLoop(frame, pc-code);
+            goto methodReturn;
+        }
+        continue;
+
+    methodCall:
+        /* aMethod in class aClassType is called; its arguments are on
+           the stack.  A trivial method is performed here, without a
+           frame.  If the call is not virtual, the call instruction is
+           rewritten and re-executed; an invokevirtual cannot be rewritten
+           because its inline cache is what guarantees the receiver's class. */
+        if (aMethod->inlineKind != INLINE_NONE) {
+            opcodeAddr = pc - 3;
+            if (*opcodeAddr != OP_invokevirtual) {
+                RewriteInlinedCall(aMethod, opcodeAddr);
+                pc = opcodeAddr;
+            } else if (!InlinedAccess(InlinedOpcode(aMethod), aMethod->inlineSlot))
+                throwException("NullPointerException",opcodeAddr+1,method,thisClass);
+            continue;
+        }
+        /* A method with compiled code is run by a C call. */
+        if (JitThreshold > 0 && JIT_CountInvocation(aClassType, aMethod)) {
+            frame->pc = pc;
+            JVM_PopFrame(JIT_Run(JVM_PushFrame(aClassType, aMethod)));
+            continue;
+        }
+        /* Otherwise save our pc and switch to a new frame. */
+        frame->pc = pc;
+        frame = JVM_PushFrame(aClassType, aMethod);
+        thisClass = aClassType;
+        method = aMethod;
+        localVariable = frame->locals;
+        pc = code = method->quickCode;
+        continue;
+
+    methodReturn:
+        /* the current method returns a result of size rw */
+        if (frame == entryFrame)
+            return rw;
+        JVM_PopFrame(rw);
+        frame = JVM_FrameTop;
+        thisClass = frame->thisClass;
+        method = frame->method;
+        localVariable = frame->locals;
+        code = method->quickCode;
+        pc = frame->pc;
     }
 }
+
+
+/* Execute the bytecode for the method described by frame, which must be
+   the current frame (the top of the frame stack).
+   A call from the method to another Java method pushes a new frame and
+   continues in the same loop, and a return pops the frame and resumes
+   the caller; C recursion happens only when control passes through C
+   code (such as class initialization).
+   An exception caught by a handler in one of the frames of this call
+   restarts the loop at the handler (see RunActivation in Exceptions.c,
+   which keeps setjmp out of this file so that the loop pays nothing for
+   it).
+   The function returns when the method of the initial frame returns.
+   The result specifies how many stack slots are needed for the method's
+   returned value, i.e. 0 for a void method, 2 for a method which returns
+   a double or long, and otherwise 1.  The value is left on top of the
+   stack, to be moved into place by JVM_PopFrame. */
+int InterpretMethod( Frame *frame ) {
+    return RunActivation(frame, interpretFrames);
+}
@@ -8,6 +8,12 @@ extern void throwException( char *kind, uint8_t *pc, method_info *meth, ClassTyp
 extern void throwExceptionExternal( char *kind, char *methodname, char *className );
 
 extern void  PushConstant( ClassType *ct, int i );
-extern int InterpretMethod( ClassType *ct, method_info *meth, DataItem *localVariable );
+extern void PrintInternStatistics();
+extern HeapPointer AllocateString( char *s, int len );
+extern HeapPointer AllocateInstance( ClassType *thisClass, int ix );
+extern HeapPointer AllocateSimpleArray( int atype, int count );
+extern HeapPointer AllocateRefArray( ClassType *thisClass, int ix, int count );
+extern int InlinedAccess( int op, int slot );
+extern int InterpretMethod( Frame *frame );
 
 #endif
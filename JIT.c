@@ -0,0 +1,1386 @@
+/* JIT.c */
+
+/*
+   A baseline compiler which translates the bytecode of a method into
+   x86-64 machine code for Linux.
+
+   Each bytecode instruction is translated by a fixed template, one after
+   the other, so there is no optimization across instructions.  The only
+   gain over the interpreter is that instruction dispatch disappears.
+   The compiled code uses the same frame, the same local variables and
+   the same operand stack (in memory, on the JVM stack) as the interpreter,
+   so compiled and interpreted methods can call each other freely.
+
+   While compiled code runs, these registers are reserved:
+       rbx   address of local variable #0
+       r12   address of the top element of the operand stack
+       r13   the Frame of the method
+       r14   HeapStart, to convert heap references into real pointers
+       r15   address of the JVM_Top variable
+   The r12 register is stored into JVM_Top before any C helper function
+   is called and it is reloaded afterwards.  The helpers perform calls,
+   field accesses, allocation and anything else which is not simple.
+
+   The compiled code for a method is entered as a C function
+       int code( Frame *f, void *resume )
+   and returns the size of its result, exactly like InterpretMethod.
+   The resume argument is NULL for a call; otherwise it is the address of
+   the code for a bytecode instruction, from which execution continues.
+
+   A method is compiled when it has been invoked JitThreshold times.
+   The interpreter also counts the backward branches taken in each method,
+   and a method which stays in a loop for JitThreshold*JIT_LOOP_FACTOR
+   iterations is compiled too.  Its execution then continues in the
+   compiled code, from the target of the branch (on-stack replacement).
+   This needs no translation of the frame because the frame layout is the
+   same, and it lets a main method with one long loop be compiled.
+   Methods which use an instruction without a template (such as jsr or
+   athrow), or which have exception handlers, are left to the interpreter.
+
+   In differential mode (-Jd), each call of a compiled method which has
+   no side effects outside its own frame is executed twice, first by the
+   interpreter and then by the compiled code, and the results compared.
+
+   Array accesses, arraylength and the inlined field accesses do not test
+   their reference for null: the first load or store through it faults
+   in the guard area of the heap, and the SIGSEGV handler finds the
+   bytecode instruction from the faulting address (see JIT_LocateFault)
+   before throwing the NullPointerException.
+*/
+
+#define _GNU_SOURCE         /* for the register names of <ucontext.h> */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "ClassResolver.h"
+#include "InterpretLoop.h"
+#include "OpcodeSignatures.h"
+#include "PrintByteCode.h"
+#include "Predecode.h"
+#include "TraceOptions.h"
+#include "EventTrace.h"
+#include "MyAlloc.h"
+#include "JIT.h"
+
+int JitThreshold = 0;           /* # calls before compilation; 0 => no JIT */
+static int jitDifferential = 0; /* true => compare with the interpreter */
+static int checkingInterpreter = 0; /* true => the interpreter must not
+                                       switch to compiled code in a loop */
+
+/* statistics */
+static int numCompiled = 0;
+static int numRejected = 0;
+static long bytecodeCompiled = 0;
+static long machineCodeSize = 0;
+static long numCompiledCalls = 0;
+static long numDifferentialChecks = 0;
+static long numLoopEntries = 0;
+
+/* Every call made by compiled code is a C call, so compiled code is
+   not used in a very deep Java recursion; the interpreter handles it
+   without using the C stack */
+#define JIT_CSTACK_LIMIT  (4*1024*1024)
+static uintptr_t cStackBase;     /* approximate base of the C stack */
+
+typedef int (*JitCode)( Frame *f, void *resume );
+
+
+/* Registers, numbered as in the x86-64 instruction encoding */
+enum { RAX=0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+       R8, R9, R10, R11, R12, R13, R14, R15 };
+
+#define LOCALS  RBX
+#define STK     R12
+#define FRAME   R13
+#define HEAP    R14
+#define TOPADDR R15
+
+/* condition codes for jcc and setcc */
+enum { CC_B=0x2, CC_AE=0x3, CC_E=0x4, CC_NE=0x5, CC_L=0xC, CC_GE=0xD,
+       CC_LE=0xE, CC_G=0xF };
+
+/* kinds of exception thrown by compiled code */
+enum { EX_NULL=0, EX_BOUNDS, EX_ARITH, EX_NEGSIZE, EX_ACCESS, EX_CAST };
+
+static char *exceptionNames[] = {
+    "NullPointerException", "ArrayIndexOutOfBoundsException",
+    "ArithmeticException", "NegativeArraySizeException",
+    "IllegalAccessError", "ClassCastException"
+};
+
+
+/* The code for the method being compiled is assembled here, then copied
+   to executable memory */
+static uint8_t *cb = NULL;
+static int cbLen, cbCap;
+static int curOffset;           /* bytecode offset of the current op */
+
+/* a jump which must be patched to reach a bytecode offset */
+typedef struct {
+    int patchPos;               /* position of the rel32 field in cb */
+    int target;                 /* bytecode offset of the destination */
+} Fixup;
+
+static Fixup *fixups = NULL;
+static int numFixups, maxFixups;
+
+/* executable memory is obtained with mmap in large chunks */
+#define JIT_CHUNK_SIZE  (1024*1024)
+static uint8_t *execMem = NULL;
+static size_t execUsed, execSize;
+
+/* every chunk of executable memory, to recognize a fault in compiled code */
+typedef struct {
+    uint8_t *start;
+    size_t size;
+} ExecChunk;
+
+static ExecChunk *execChunks = NULL;
+static int numExecChunks = 0;
+
+
+/* Emission of machine code */
+
+static void emitByte( int b ) {
+    if (cbLen >= cbCap) {
+        cbCap = (cbCap == 0)? 4096 : cbCap*2;
+        cb = realloc(cb, cbCap);
+        if (cb == NULL) {
+            fprintf(stderr, "out of memory while compiling\n");
+            exit(1);
+        }
+    }
+    cb[cbLen++] = b;
+}
+
+static void emit4( uint32_t v ) {
+    emitByte(v);  emitByte(v>>8);  emitByte(v>>16);  emitByte(v>>24);
+}
+
+static void emit8( uint64_t v ) {
+    emit4((uint32_t)v);  emit4((uint32_t)(v>>32));
+}
+
+static void emitOpcode( int opc ) {
+    if (opc > 0xff) emitByte(opc >> 8);   /* 0x0F escape */
+    emitByte(opc & 0xff);
+}
+
+/* emit an instruction with a memory operand [base + index*scale + disp],
+   where index < 0 means no index register; prefix is 0 or a mandatory
+   prefix byte, w is 1 for a 64-bit operation */
+static void emitMem( int prefix, int w, int opc, int reg, int base,
+        int index, int scale, int32_t disp ) {
+    int rex = 0x40 | (w<<3) | ((reg&8)>>1) | ((base&8)>>3);
+    int mod, ss;
+
+    if (index >= 0) rex |= (index&8)>>2;
+    if (prefix) emitByte(prefix);
+    if (rex != 0x40) emitByte(rex);
+    emitOpcode(opc);
+    if (disp == 0 && (base&7) != RBP)
+        mod = 0;
+    else if (disp >= -128 && disp <= 127)
+        mod = 1;
+    else
+        mod = 2;
+    if (index >= 0 || (base&7) == RSP) {
+        ss = (scale == 8)? 3 : (scale == 4)? 2 : (scale == 2)? 1 : 0;
+        emitByte((mod<<6) | ((reg&7)<<3) | 4);
+        emitByte((ss<<6) | (((index >= 0)? index : RSP)&7)<<3 | (base&7));
+    } else
+        emitByte((mod<<6) | ((reg&7)<<3) | (base&7));
+    if (mod == 1)
+        emitByte(disp);
+    else if (mod == 2)
+        emit4(disp);
+}
+
+/* emit an instruction with the register operands reg and rm */
+static void emitRR( int w, int opc, int reg, int rm ) {
+    int rex = 0x40 | (w<<3) | ((reg&8)>>1) | ((rm&8)>>3);
+    if (rex != 0x40) emitByte(rex);
+    emitOpcode(opc);
+    emitByte(0xC0 | ((reg&7)<<3) | (rm&7));
+}
+
+/* the frequently used forms */
+#define LOAD32(reg,base,disp)   emitMem(0,0,0x8B,reg,base,-1,0,disp)
+#define STORE32(base,disp,reg)  emitMem(0,0,0x89,reg,base,-1,0,disp)
+#define LOAD64(reg,base,disp)   emitMem(0,1,0x8B,reg,base,-1,0,disp)
+#define STORE64(base,disp,reg)  emitMem(0,1,0x89,reg,base,-1,0,disp)
+
+static void emitAddStk( int n ) {       /* add/sub r12, n */
+    if (n == 0) return;
+    emitRR(1, 0x83, (n > 0)? 0 : 5, STK);
+    emitByte((n > 0)? n : -n);
+}
+
+static void emitMovImm32( int reg, uint32_t v ) {
+    if (reg & 8) emitByte(0x41);
+    emitByte(0xB8 + (reg&7));
+    emit4(v);
+}
+
+static void emitMovImm64( int reg, uint64_t v ) {
+    emitByte(0x48 | ((reg&8)>>3));
+    emitByte(0xB8 + (reg&7));
+    emit8(v);
+}
+
+static void emitPushImm( uint32_t v ) {
+    emitAddStk(4);
+    emitMem(0,0,0xC7,0,STK,-1,0,0);  emit4(v);
+}
+
+static void emitPushImm2( uint32_t lo, uint32_t hi ) {
+    emitAddStk(8);
+    emitMem(0,0,0xC7,0,STK,-1,0,-4);  emit4(lo);
+    emitMem(0,0,0xC7,0,STK,-1,0,0);   emit4(hi);
+}
+
+/* a call of a C function; the operand stack is synchronized with JVM_Top */
+static void emitCall( void *fn ) {
+    STORE64(TOPADDR, 0, STK);
+    emitMovImm64(RAX, (uint64_t)(uintptr_t)fn);
+    emitByte(0xFF);  emitByte(0xD0);      /* call rax */
+    LOAD64(STK, TOPADDR, 0);
+}
+
+/* a short forward jump whose destination is set by patchShort */
+static int emitShortJump( int cc ) {
+    emitByte((cc < 0)? 0xEB : 0x70 + cc);
+    emitByte(0);
+    return cbLen;
+}
+
+static void patchShort( int pos ) {
+    assert(cbLen - pos < 128);
+    cb[pos-1] = cbLen - pos;
+}
+
+/* a jump to the code for a bytecode offset, cc < 0 means unconditional */
+static void emitJump( int cc, int target ) {
+    if (numFixups >= maxFixups) {
+        maxFixups = (maxFixups == 0)? 64 : maxFixups*2;
+        fixups = realloc(fixups, maxFixups*sizeof(Fixup));
+        if (fixups == NULL) {
+            fprintf(stderr, "out of memory while compiling\n");
+            exit(1);
+        }
+    }
+    if (cc < 0)
+        emitByte(0xE9);
+    else {
+        emitByte(0x0F);  emitByte(0x80 + cc);
+    }
+    fixups[numFixups].patchPos = cbLen;
+    fixups[numFixups].target = target;
+    numFixups++;
+    emit4(0);
+}
+
+
+/* Helper functions called from compiled code */
+
+static void jitThrow( Frame *f, int pcOffset, int kind ) {
+    f->pc = f->method->quickCode + pcOffset;
+    throwException(exceptionNames[kind], f->pc+1, f->method, f->thisClass);
+}
+
+/* emit code which continues if condition cc holds, and otherwise throws
+   an exception of the given kind */
+static void emitCheck( int cc, int kind ) {
+    int pos = emitShortJump(cc);
+    emitRR(1, 0x89, FRAME, RDI);         /* mov rdi, r13 */
+    emitMovImm32(RSI, curOffset);
+    emitMovImm32(RDX, kind);
+    emitCall(jitThrow);
+    patchShort(pos);
+}
+
+/* performs an invokevirtual, invokespecial or invokestatic */
+static void jitInvoke( Frame *f, int pcOffset ) {
+    ClassType *ct = f->thisClass, *aClassType;
+    method_info *caller = f->method, *m;
+    uint8_t *pc = caller->quickCode + pcOffset;
+    int op = pc[0];
+    int ix = (pc[1]<<8) + pc[2];
+
+    f->pc = pc + 3;
+    if (op >= OP_getfield_inline && op <= OP_init_inline) {
+        /* the interpreter has rewritten the call since it was compiled */
+        if (!InlinedAccess(op, ix))
+            jitThrow(f, pcOffset, EX_NULL);
+        return;
+    }
+    if (tracingExecution & TRACE_INVOKES) {
+        if (recordingEvents)
+            RecordEvent(EV_INVOKE, op, pcOffset, ix);
+        else {
+            char *s = GetCPItemAsString(ct->cf,ix);
+            fprintf(stdout, "    Invoking %s method %s...\n",
+                (op == OP_invokevirtual)? "virtual" :
+                (op == OP_invokespecial)? "special" : "static", s);
+            free(s);
+        }
+    }
+    if (op == OP_invokevirtual)
+        m = ResolveVirtualMethod(ct, caller, pcOffset, ix, &aClassType);
+    else if (op == OP_invokespecial)
+        m = ResolveSpecialMethod(ct, ix, &aClassType);
+    else
+        m = ResolveStaticMethod(ct, ix, &aClassType);
+    if (m == NULL) return;      /* a native method did the work */
+    if (m->inlineKind != INLINE_NONE) {
+        if (!InlinedAccess(InlinedOpcode(m), m->inlineSlot))
+            jitThrow(f, pcOffset, EX_NULL);
+        return;
+    }
+    InvokeMethod(aClassType, m, op == OP_invokestatic);
+}
+
+static void jitNew( ClassType *ct, int ix ) {
+    JVM_PushReference(AllocateInstance(ct, ix));
+}
+
+static int jitNewArray( int atype ) {
+    if (JVM_Top->ival < 0) return 0;
+    JVM_Top->pval = AllocateSimpleArray(atype, JVM_Top->ival);
+    return 1;
+}
+
+static int jitANewArray( ClassType *ct, int ix ) {
+    if (JVM_Top->ival < 0) return 0;
+    JVM_Top->pval = AllocateRefArray(ct, ix, JVM_Top->ival);
+    return 1;
+}
+
+static int jitCheckCast( ClassType *ct, int ix ) {
+    return JVM_Top->pval == NULL_HEAP_REFERENCE
+        || InstanceOf(ct, ix, JVM_Top->pval);
+}
+
+static void jitInstanceOf( ClassType *ct, int ix ) {
+    JVM_Top->ival = (JVM_Top->pval == NULL_HEAP_REFERENCE)? 0
+        : InstanceOf(ct, ix, JVM_Top->pval);
+}
+
+/* the conversions and comparisons of floating-point values, with the
+   same C semantics as in the interpreter */
+static void jitStackOp( int op ) {
+    union { int64_t lval;  double dval;  uint32_t uval[2]; } pair;
+    double d;
+    float f;
+
+    switch(op) {
+    case OP_i2f:
+        JVM_Top->fval = JVM_Top->ival * 1.0;
+        break;
+    case OP_i2d:
+        pair.dval = JVM_Top->ival * 1.0;
+        JVM_Top->uval = pair.uval[0];
+        (++JVM_Top)->uval = pair.uval[1];
+        break;
+    case OP_f2i:
+        JVM_Top->ival = JVM_Top->fval;
+        break;
+    case OP_f2l:
+    case OP_f2d:
+        if (op == OP_f2l)
+            pair.lval = JVM_Top->fval;
+        else
+            pair.dval = JVM_Top->fval;
+        JVM_Top->uval = pair.uval[0];
+        (++JVM_Top)->uval = pair.uval[1];
+        break;
+    case OP_l2f:
+    case OP_l2d:
+    case OP_d2i:
+    case OP_d2l:
+    case OP_d2f:
+        pair.uval[1] = JVM_Top->uval;
+        pair.uval[0] = (JVM_Top-1)->uval;
+        if (op == OP_l2d || op == OP_d2l) {
+            if (op == OP_l2d)
+                pair.dval = pair.lval;
+            else
+                pair.lval = pair.dval;
+            JVM_Top->uval = pair.uval[1];
+            (JVM_Top-1)->uval = pair.uval[0];
+            break;
+        }
+        JVM_Top--;
+        if (op == OP_l2f)
+            JVM_Top->fval = pair.lval * 1.0;
+        else if (op == OP_d2i)
+            JVM_Top->ival = pair.dval;
+        else
+            JVM_Top->fval = pair.dval;
+        break;
+    case OP_fcmpl:
+    case OP_fcmpg:
+        f = (JVM_Top--)->fval;
+        if (isnan(f) || isnan(JVM_Top->fval))
+            JVM_Top->uval = (op == OP_fcmpg)? 1 : -1;
+        else
+            JVM_Top->uval = (JVM_Top->fval == f)? 0 : (JVM_Top->fval > f)? 1 : -1;
+        break;
+    case OP_dcmpl:
+    case OP_dcmpg:
+        pair.uval[1] = JVM_Top->uval;
+        pair.uval[0] = (JVM_Top-1)->uval;
+        d = pair.dval;
+        pair.uval[1] = (JVM_Top-2)->uval;
+        pair.uval[0] = (JVM_Top-3)->uval;
+        JVM_Top -= 3;
+        if (isnan(d) || isnan(pair.dval))
+            JVM_Top->uval = (op == OP_dcmpg)? 1 : -1;
+        else
+            JVM_Top->uval = (pair.dval == d)? 0 : (pair.dval > d)? 1 : -1;
+        break;
+    }
+}
+
+
+/* Templates */
+
+/* the checks made by an array element access */
+#define CHECK_NULL      1
+#define CHECK_BOUNDS    2
+
+/* an array element access; the array is checked for null and the index
+   against its bounds, as the flags in checks ask, then rax holds the
+   real address of the array and rcx the index.  When both are checked,
+   the null check is implicit: the comparison with the size of a null
+   array faults in the guard area of the heap. */
+static void emitArrayCheck( int refDepth, int ixDepth, int checks ) {
+    LOAD32(RCX, STK, ixDepth);
+    LOAD32(RAX, STK, refDepth);
+    if (checks == CHECK_NULL) {
+        emitRR(0, 0x85, RAX, RAX);                      /* test eax,eax */
+        emitCheck(CC_NE, EX_NULL);
+    }
+    if (checks & CHECK_BOUNDS) {
+        emitMem(0,0,0x3B,RCX,HEAP,RAX,1,offsetof(ArrayOfRef,size)); /* cmp ecx,[..] */
+        emitCheck(CC_B, EX_BOUNDS);
+    }
+    emitRR(1, 0x01, HEAP, RAX);                         /* add rax, r14 */
+}
+
+static void emitArrayLoad( int op, int checks ) {
+    int base = offsetof(ArrayOfSimple,u);
+
+    if (op == OP_laload || op == OP_daload) {
+        emitArrayCheck(-4, 0, checks);
+        emitMem(0,1,0x8B,RDX,RAX,RCX,8,base);
+        STORE64(STK, -4, RDX);
+        return;
+    }
+    emitArrayCheck(-4, 0, checks);
+    switch(op) {
+    case OP_iaload:
+    case OP_faload:
+        emitMem(0,0,0x8B,RDX,RAX,RCX,4,base);
+        break;
+    case OP_aaload:
+        emitMem(0,0,0x8B,RDX,RAX,RCX,4,offsetof(ArrayOfRef,elements));
+        break;
+    case OP_baload:
+    case OP_caload:     /* as in the interpreter, both are unsigned bytes */
+        emitMem(0,0,0x0FB6,RDX,RAX,RCX,1,base);
+        break;
+    case OP_saload:
+        emitMem(0,0,0x0FBF,RDX,RAX,RCX,2,base);
+        break;
+    }
+    emitAddStk(-4);
+    STORE32(STK, 0, RDX);
+}
+
+static void emitArrayStore( int op, int checks ) {
+    int base = offsetof(ArrayOfSimple,u);
+
+    if (op == OP_lastore || op == OP_dastore) {
+        LOAD64(RDX, STK, -4);
+        emitArrayCheck(-12, -8, checks);
+        emitMem(0,1,0x89,RDX,RAX,RCX,8,base);
+        emitAddStk(-16);
+        return;
+    }
+    LOAD32(RDX, STK, 0);
+    emitArrayCheck(-8, -4, checks);
+    switch(op) {
+    case OP_iastore:
+    case OP_fastore:
+        emitMem(0,0,0x89,RDX,RAX,RCX,4,base);
+        break;
+    case OP_aastore:
+        emitMem(0,0,0x89,RDX,RAX,RCX,4,offsetof(ArrayOfRef,elements));
+        break;
+    case OP_bastore:
+    case OP_castore:
+        emitMem(0,0,0x88,RDX,RAX,RCX,1,base);
+        break;
+    case OP_sastore:
+        emitMem(0x66,0,0x89,RDX,RAX,RCX,2,base);
+        break;
+    }
+    emitAddStk(-12);
+}
+
+/* emit an explicit null check of the reference in eax, unless an access
+   at offset disp from it will fault in the guard area of the heap */
+static void emitNullCheck( int disp ) {
+    if (disp >= 0 && IN_HEAP_GUARD(disp))
+        return;
+    emitRR(0, 0x85, RAX, RAX);                          /* test eax,eax */
+    emitCheck(CC_NE, EX_NULL);
+}
+
+/* the quick opcodes which replace calls of trivial methods */
+static void emitInlinedAccess( int op, int slot ) {
+    int disp = offsetof(ClassInstance,instField) + 4*slot;
+
+    emitMovImm64(RAX, (uint64_t)(uintptr_t)&InlinedCalls);
+    emitMem(0,1,0xFF,0,RAX,-1,0,0);                    /* inc qword [rax] */
+    switch(op) {
+    case OP_getfield_inline:
+    case OP_getfield2_inline:
+        LOAD32(RAX, STK, 0);
+        emitNullCheck(disp);
+        if (op == OP_getfield_inline) {
+            emitMem(0,0,0x8B,RCX,HEAP,RAX,1,disp);
+            STORE32(STK, 0, RCX);
+        } else {
+            emitMem(0,1,0x8B,RCX,HEAP,RAX,1,disp);
+            STORE64(STK, 0, RCX);
+            emitAddStk(4);
+        }
+        break;
+    case OP_putfield_inline:
+        LOAD32(RDX, STK, 0);
+        LOAD32(RAX, STK, -4);
+        emitAddStk(-8);
+        emitNullCheck(disp);
+        emitMem(0,0,0x89,RDX,HEAP,RAX,1,disp);
+        break;
+    case OP_putfield2_inline:
+        LOAD64(RDX, STK, -4);
+        LOAD32(RAX, STK, -8);
+        emitAddStk(-12);
+        emitNullCheck(disp);
+        emitMem(0,1,0x89,RDX,HEAP,RAX,1,disp);
+        break;
+    case OP_init_inline:
+        LOAD32(RAX, STK, 0);
+        emitAddStk(-4);
+        emitNullCheck(-1);              /* nothing is accessed */
+        break;
+    }
+}
+
+/* idiv, irem, ldiv and lrem; Java defines MIN_VALUE / -1 == MIN_VALUE */
+static void emitDivide( int w, int isRem ) {
+    int pos1, pos2;
+
+    if (w) {
+        LOAD64(RCX, STK, -4);
+        LOAD64(RAX, STK, -12);
+        emitAddStk(-8);
+    } else {
+        LOAD32(RCX, STK, 0);
+        LOAD32(RAX, STK, -4);
+        emitAddStk(-4);
+    }
+    emitRR(w, 0x85, RCX, RCX);
+    emitCheck(CC_NE, EX_ARITH);
+    emitRR(w, 0x83, 7, RCX);  emitByte(0xFF);          /* cmp rcx,-1 */
+    pos1 = emitShortJump(CC_NE);
+    if (isRem)
+        emitRR(0, 0x31, RDX, RDX);                      /* xor edx,edx */
+    else
+        emitRR(w, 0xF7, 3, RAX);                        /* neg rax */
+    pos2 = emitShortJump(-1);
+    patchShort(pos1);
+    if (w) emitByte(0x48);
+    emitByte(0x99);                                     /* cdq/cqo */
+    emitRR(w, 0xF7, 7, RCX);                            /* idiv rcx */
+    patchShort(pos2);
+    if (w)
+        STORE64(STK, -4, isRem? RDX : RAX);
+    else
+        STORE32(STK, 0, isRem? RDX : RAX);
+}
+
+static void emitReturn( int rw ) {
+    STORE64(TOPADDR, 0, STK);
+    emitMovImm32(RAX, rw);
+    emitRR(1, 0x83, 0, RSP);  emitByte(8);              /* add rsp,8 */
+    emitByte(0x41);  emitByte(0x5F);                    /* pop r15 */
+    emitByte(0x41);  emitByte(0x5E);                    /* pop r14 */
+    emitByte(0x41);  emitByte(0x5D);                    /* pop r13 */
+    emitByte(0x41);  emitByte(0x5C);                    /* pop r12 */
+    emitByte(0x5B);                                     /* pop rbx */
+    emitByte(0x5D);                                     /* pop rbp */
+    emitByte(0xC3);                                     /* ret */
+}
+
+static void emitPrologue() {
+    emitByte(0x55);                                     /* push rbp */
+    emitRR(1, 0x89, RSP, RBP);                          /* mov rbp,rsp */
+    emitByte(0x53);                                     /* push rbx */
+    emitByte(0x41);  emitByte(0x54);                    /* push r12 */
+    emitByte(0x41);  emitByte(0x55);                    /* push r13 */
+    emitByte(0x41);  emitByte(0x56);                    /* push r14 */
+    emitByte(0x41);  emitByte(0x57);                    /* push r15 */
+    emitRR(1, 0x83, 5, RSP);  emitByte(8);              /* sub rsp,8 */
+    emitRR(1, 0x89, RDI, FRAME);                        /* mov r13,rdi */
+    LOAD64(LOCALS, FRAME, offsetof(Frame,locals));
+    emitMovImm64(TOPADDR, (uint64_t)(uintptr_t)&JVM_Top);
+    LOAD64(STK, TOPADDR, 0);
+    emitMovImm64(RAX, (uint64_t)(uintptr_t)&HeapStart);
+    LOAD64(HEAP, RAX, 0);
+    emitRR(1, 0x85, RSI, RSI);                          /* test rsi,rsi */
+    emitByte(0x74);  emitByte(2);                       /* jz +2 */
+    emitByte(0xFF);  emitByte(0xE6);                    /* jmp rsi */
+}
+
+static int get2( uint8_t *p ) {
+    return (int16_t)((p[0]<<8) + p[1]);
+}
+
+static int get4( uint8_t *p ) {
+    return (int32_t)((p[0]<<24) + (p[1]<<16) + (p[2]<<8) + p[3]);
+}
+
+/* the offset of the branch instruction at p */
+static int branchOffset( uint8_t *p ) {
+    return (*p == OP_goto_w)? get4(p+1) : get2(p+1);
+}
+
+static int branchCondition( int op ) {
+    switch(op) {
+    case OP_ifeq:  case OP_if_icmpeq:  case OP_if_acmpeq:  case OP_ifnull:
+        return CC_E;
+    case OP_ifne:  case OP_if_icmpne:  case OP_if_acmpne:  case OP_ifnonnull:
+        return CC_NE;
+    case OP_iflt:  case OP_if_icmplt:
+        return CC_L;
+    case OP_ifge:  case OP_if_icmpge:
+        return CC_GE;
+    case OP_ifgt:  case OP_if_icmpgt:
+        return CC_G;
+    default:
+        return CC_LE;
+    }
+}
+
+
+/* Translate one instruction at offset pc of method m in class ct.
+   The result is 0 if there is no template for the instruction. */
+static int compileInstruction( ClassType *ct, method_info *m, int pc ) {
+    uint8_t *code = m->quickCode;
+    uint8_t *p = code + pc + 1;         /* the operands */
+    int op = code[pc];
+    int ix, n, k, low, high, dflt;
+    union { float f;  uint32_t u; } fc;
+    union { double d;  uint32_t u[2]; } dc;
+
+    if (op == OP_arrayloop_quick)
+        op = m->code[pc];       /* compiled as the original iload */
+    switch(op) {
+    case OP_nop:
+        break;
+    case OP_aconst_null:
+        emitPushImm(0);
+        break;
+    case OP_iconst_m1:  case OP_iconst_0:  case OP_iconst_1:  case OP_iconst_2:
+    case OP_iconst_3:   case OP_iconst_4:  case OP_iconst_5:
+        emitPushImm(op - OP_iconst_0);
+        break;
+    case OP_lconst_0:  case OP_lconst_1:
+        emitPushImm2(op - OP_lconst_0, 0);
+        break;
+    case OP_fconst_0:  case OP_fconst_1:  case OP_fconst_2:
+        fc.f = (op - OP_fconst_0) * 1.0;
+        emitPushImm(fc.u);
+        break;
+    case OP_dconst_0:  case OP_dconst_1:
+        dc.d = (op - OP_dconst_0) * 1.0;
+        emitPushImm2(dc.u[0], dc.u[1]);
+        break;
+    case OP_bipush:
+        emitPushImm((int8_t)p[0]);
+        break;
+    case OP_sipush:
+        emitPushImm(get2(p));
+        break;
+    case OP_ldc:
+    case OP_ldc_w:
+        ix = (op == OP_ldc)? p[0] : (p[0]<<8) + p[1];
+        if (ct->cf->cp_tag[ix] == CP_Integer || ct->cf->cp_tag[ix] == CP_Float)
+            emitPushImm(ct->cf->cp_item[ix].uval);
+        else {
+            m->jitPure = 0;     /* it allocates a string */
+            emitMovImm64(RDI, (uint64_t)(uintptr_t)ct);
+            emitMovImm32(RSI, ix);
+            emitCall(PushConstant);
+        }
+        break;
+    case OP_ldc2_w:
+        ix = (p[0]<<8) + p[1];
+        emitPushImm2(ct->cf->cp_item[ix].uval, ct->cf->cp_item[ix+1].uval);
+        break;
+
+    /* local variables */
+    case OP_iload:  case OP_fload:  case OP_aload:
+    case OP_iload_0:  case OP_iload_1:  case OP_iload_2:  case OP_iload_3:
+    case OP_fload_0:  case OP_fload_1:  case OP_fload_2:  case OP_fload_3:
+    case OP_aload_0:  case OP_aload_1:  case OP_aload_2:  case OP_aload_3:
+        n = (op == OP_iload || op == OP_fload || op == OP_aload)? p[0] :
+            (op >= OP_aload_0)? op - OP_aload_0 :
+            (op >= OP_fload_0)? op - OP_fload_0 : op - OP_iload_0;
+        LOAD32(RAX, LOCALS, 4*n);
+        emitAddStk(4);
+        STORE32(STK, 0, RAX);
+        break;
+    case OP_lload:  case OP_dload:
+    case OP_lload_0:  case OP_lload_1:  case OP_lload_2:  case OP_lload_3:
+    case OP_dload_0:  case OP_dload_1:  case OP_dload_2:  case OP_dload_3:
+        n = (op == OP_lload || op == OP_dload)? p[0] :
+            (op >= OP_dload_0)? op - OP_dload_0 : op - OP_lload_0;
+        LOAD64(RAX, LOCALS, 4*n);
+        emitAddStk(8);
+        STORE64(STK, -4, RAX);
+        break;
+    case OP_istore:  case OP_fstore:  case OP_astore:
+    case OP_istore_0:  case OP_istore_1:  case OP_istore_2:  case OP_istore_3:
+    case OP_fstore_0:  case OP_fstore_1:  case OP_fstore_2:  case OP_fstore_3:
+    case OP_astore_0:  case OP_astore_1:  case OP_astore_2:  case OP_astore_3:
+        n = (op == OP_istore || op == OP_fstore || op == OP_astore)? p[0] :
+            (op >= OP_astore_0)? op - OP_astore_0 :
+            (op >= OP_fstore_0)? op - OP_fstore_0 : op - OP_istore_0;
+        LOAD32(RAX, STK, 0);
+        emitAddStk(-4);
+        STORE32(LOCALS, 4*n, RAX);
+        break;
+    case OP_lstore:  case OP_dstore:
+    case OP_lstore_0:  case OP_lstore_1:  case OP_lstore_2:  case OP_lstore_3:
+    case OP_dstore_0:  case OP_dstore_1:  case OP_dstore_2:  case OP_dstore_3:
+        n = (op == OP_lstore || op == OP_dstore)? p[0] :
+            (op >= OP_dstore_0)? op - OP_dstore_0 : op - OP_lstore_0;
+        LOAD64(RAX, STK, -4);
+        emitAddStk(-8);
+        STORE64(LOCALS, 4*n, RAX);
+        break;
+    case OP_iinc:
+        emitMem(0,0,0x81,0,LOCALS,-1,0,4*p[0]);         /* add [..],imm32 */
+        emit4((int8_t)p[1]);
+        break;
+
+    /* arrays */
+    case OP_iaload:  case OP_laload:  case OP_faload:  case OP_daload:
+    case OP_aaload:  case OP_baload:  case OP_caload:  case OP_saload:
+        emitArrayLoad(op, CHECK_NULL|CHECK_BOUNDS);
+        break;
+    case OP_iastore:  case OP_lastore:  case OP_fastore:  case OP_dastore:
+    case OP_aastore:  case OP_bastore:  case OP_castore:  case OP_sastore:
+        m->jitPure = 0;
+        emitArrayStore(op, CHECK_NULL|CHECK_BOUNDS);
+        break;
+    case OP_iaload_quick:  case OP_laload_quick:  case OP_faload_quick:
+    case OP_daload_quick:  case OP_aaload_quick:  case OP_baload_quick:
+    case OP_caload_quick:  case OP_saload_quick:
+        emitArrayLoad(op - OP_iaload_quick + OP_iaload, 0);
+        break;
+    case OP_iastore_quick:  case OP_lastore_quick:  case OP_fastore_quick:
+    case OP_dastore_quick:  case OP_aastore_quick:  case OP_bastore_quick:
+    case OP_castore_quick:  case OP_sastore_quick:
+        m->jitPure = 0;
+        emitArrayStore(op - OP_iastore_quick + OP_iastore, 0);
+        break;
+    case OP_iaload_nonnull:  case OP_laload_nonnull:  case OP_faload_nonnull:
+    case OP_daload_nonnull:  case OP_aaload_nonnull:  case OP_baload_nonnull:
+    case OP_caload_nonnull:  case OP_saload_nonnull:
+        emitArrayLoad(op - OP_iaload_nonnull + OP_iaload, CHECK_BOUNDS);
+        break;
+    case OP_iastore_nonnull:  case OP_lastore_nonnull:  case OP_fastore_nonnull:
+    case OP_dastore_nonnull:  case OP_aastore_nonnull:  case OP_bastore_nonnull:
+    case OP_castore_nonnull:  case OP_sastore_nonnull:
+        m->jitPure = 0;
+        emitArrayStore(op - OP_iastore_nonnull + OP_iastore, CHECK_BOUNDS);
+        break;
+    case OP_arraylength:
+    case OP_arraylength_quick:
+        /* the load of the size of a null array faults */
+        LOAD32(RAX, STK, 0);
+        emitMem(0,0,0x8B,RAX,HEAP,RAX,1,offsetof(ArrayOfRef,size));
+        STORE32(STK, 0, RAX);
+        break;
+
+    /* the operand stack */
+    case OP_pop:
+        emitAddStk(-4);
+        break;
+    case OP_pop2:
+        emitAddStk(-8);
+        break;
+    case OP_dup:
+        LOAD32(RAX, STK, 0);
+        STORE32(STK, 4, RAX);
+        emitAddStk(4);
+        break;
+    case OP_dup_x1:
+        LOAD32(RAX, STK, 0);   LOAD32(RCX, STK, -4);
+        STORE32(STK, -4, RAX); STORE32(STK, 0, RCX);  STORE32(STK, 4, RAX);
+        emitAddStk(4);
+        break;
+    case OP_dup_x2:
+        LOAD32(RAX, STK, 0);   LOAD32(RCX, STK, -4);  LOAD32(RDX, STK, -8);
+        STORE32(STK, -8, RAX); STORE32(STK, -4, RDX); STORE32(STK, 0, RCX);
+        STORE32(STK, 4, RAX);
+        emitAddStk(4);
+        break;
+    case OP_dup2:
+        LOAD64(RAX, STK, -4);
+        STORE64(STK, 4, RAX);
+        emitAddStk(8);
+        break;
+    case OP_dup2_x1:
+        LOAD64(RAX, STK, -4);  LOAD32(RCX, STK, -8);
+        STORE64(STK, -8, RAX); STORE32(STK, 0, RCX);  STORE64(STK, 4, RAX);
+        emitAddStk(8);
+        break;
+    case OP_dup2_x2:
+        LOAD64(RAX, STK, -4);  LOAD64(RCX, STK, -12);
+        STORE64(STK, -12, RAX); STORE64(STK, -4, RCX); STORE64(STK, 4, RAX);
+        emitAddStk(8);
+        break;
+    case OP_swap:
+        LOAD32(RAX, STK, 0);   LOAD32(RCX, STK, -4);
+        STORE32(STK, 0, RCX);  STORE32(STK, -4, RAX);
+        break;
+
+    /* int arithmetic */
+    case OP_iadd:  case OP_isub:  case OP_iand:  case OP_ior:  case OP_ixor:
+        LOAD32(RAX, STK, 0);
+        emitAddStk(-4);
+        emitMem(0,0, (op == OP_iadd)? 0x01 : (op == OP_isub)? 0x29 :
+            (op == OP_iand)? 0x21 : (op == OP_ior)? 0x09 : 0x31, RAX,STK,-1,0,0);
+        break;
+    case OP_imul:
+        LOAD32(RAX, STK, -4);
+        emitMem(0,0,0x0FAF,RAX,STK,-1,0,0);
+        emitAddStk(-4);
+        STORE32(STK, 0, RAX);
+        break;
+    case OP_idiv:  case OP_irem:
+        emitDivide(0, op == OP_irem);
+        break;
+    case OP_ineg:
+        emitMem(0,0,0xF7,3,STK,-1,0,0);
+        break;
+    case OP_ishl:  case OP_ishr:  case OP_iushr:
+        LOAD32(RCX, STK, 0);
+        emitAddStk(-4);
+        emitMem(0,0,0xD3,(op == OP_ishl)? 4 : (op == OP_ishr)? 7 : 5,STK,-1,0,0);
+        break;
+
+    /* long arithmetic; a long occupies 8 bytes in little-endian order */
+    case OP_ladd:  case OP_lsub:  case OP_land:  case OP_lor:  case OP_lxor:
+        LOAD64(RAX, STK, -4);
+        emitAddStk(-8);
+        emitMem(0,1, (op == OP_ladd)? 0x01 : (op == OP_lsub)? 0x29 :
+            (op == OP_land)? 0x21 : (op == OP_lor)? 0x09 : 0x31, RAX,STK,-1,0,-4);
+        break;
+    case OP_lmul:
+        LOAD64(RAX, STK, -12);
+        emitMem(0,1,0x0FAF,RAX,STK,-1,0,-4);
+        emitAddStk(-8);
+        STORE64(STK, -4, RAX);
+        break;
+    case OP_ldiv:  case OP_lrem:
+        emitDivide(1, op == OP_lrem);
+        break;
+    case OP_lneg:
+        emitMem(0,1,0xF7,3,STK,-1,0,-4);
+        break;
+    case OP_lshl:  case OP_lshr:  case OP_lushr:
+        LOAD32(RCX, STK, 0);
+        emitAddStk(-4);
+        emitMem(0,1,0xD3,(op == OP_lshl)? 4 : (op == OP_lshr)? 7 : 5,STK,-1,0,-4);
+        break;
+    case OP_lcmp:
+        LOAD64(RAX, STK, -12);
+        LOAD64(RDX, STK, -4);
+        emitAddStk(-12);
+        emitRR(1, 0x39, RDX, RAX);                      /* cmp rax,rdx */
+        emitRR(0, 0x0F9F, 0, RAX);                      /* setg al */
+        emitRR(0, 0x0F9C, 0, RDX);                      /* setl dl */
+        emitRR(0, 0x0FB6, RAX, RAX);                    /* movzx eax,al */
+        emitRR(0, 0x0FB6, RDX, RDX);                    /* movzx edx,dl */
+        emitRR(0, 0x29, RDX, RAX);                      /* sub eax,edx */
+        STORE32(STK, 0, RAX);
+        break;
+
+    /* float and double arithmetic, with SSE instructions */
+    case OP_fadd:  case OP_fsub:  case OP_fmul:  case OP_fdiv:
+        emitMem(0xF3,0,0x0F10,0,STK,-1,0,-4);           /* movss xmm0,[..] */
+        emitMem(0xF3,0, (op == OP_fadd)? 0x0F58 : (op == OP_fsub)? 0x0F5C :
+            (op == OP_fmul)? 0x0F59 : 0x0F5E, 0,STK,-1,0,0);
+        emitAddStk(-4);
+        emitMem(0xF3,0,0x0F11,0,STK,-1,0,0);            /* movss [..],xmm0 */
+        break;
+    case OP_dadd:  case OP_dsub:  case OP_dmul:  case OP_ddiv:
+        emitMem(0xF2,0,0x0F10,0,STK,-1,0,-12);          /* movsd xmm0,[..] */
+        emitMem(0xF2,0, (op == OP_dadd)? 0x0F58 : (op == OP_dsub)? 0x0F5C :
+            (op == OP_dmul)? 0x0F59 : 0x0F5E, 0,STK,-1,0,-4);
+        emitAddStk(-8);
+        emitMem(0xF2,0,0x0F11,0,STK,-1,0,-4);           /* movsd [..],xmm0 */
+        break;
+    case OP_fneg:  case OP_dneg:    /* flip the sign bit */
+        emitMem(0,0,0x81,6,STK,-1,0,0);
+        emit4(0x80000000);
+        break;
+
+    /* conversions */
+    case OP_i2l:
+        emitMem(0,1,0x63,RAX,STK,-1,0,0);               /* movsxd rax,[..] */
+        emitAddStk(4);
+        STORE64(STK, -4, RAX);
+        break;
+    case OP_l2i:
+        emitAddStk(-4);
+        break;
+    case OP_i2b:  case OP_i2c:  case OP_i2s:
+        emitMem(0,0, (op == OP_i2b)? 0x0FBE : (op == OP_i2c)? 0x0FB7 : 0x0FBF,
+            RAX,STK,-1,0,0);
+        STORE32(STK, 0, RAX);
+        break;
+    case OP_i2f:  case OP_i2d:  case OP_l2f:  case OP_l2d:
+    case OP_f2i:  case OP_f2l:  case OP_f2d:
+    case OP_d2i:  case OP_d2l:  case OP_d2f:
+    case OP_fcmpl:  case OP_fcmpg:  case OP_dcmpl:  case OP_dcmpg:
+        emitMovImm32(RDI, op);
+        emitCall(jitStackOp);
+        break;
+
+    /* control transfers */
+    case OP_ifeq:  case OP_ifne:  case OP_iflt:  case OP_ifge:
+    case OP_ifgt:  case OP_ifle:  case OP_ifnull:  case OP_ifnonnull:
+        LOAD32(RAX, STK, 0);
+        emitAddStk(-4);
+        emitRR(0, 0x85, RAX, RAX);
+        emitJump(branchCondition(op), pc + get2(p));
+        break;
+    case OP_if_icmpeq:  case OP_if_icmpne:  case OP_if_icmplt:
+    case OP_if_icmpge:  case OP_if_icmpgt:  case OP_if_icmple:
+    case OP_if_acmpeq:  case OP_if_acmpne:
+        LOAD32(RAX, STK, -4);
+        LOAD32(RCX, STK, 0);
+        emitAddStk(-8);
+        emitRR(0, 0x39, RCX, RAX);                      /* cmp eax,ecx */
+        emitJump(branchCondition(op), pc + get2(p));
+        break;
+    case OP_goto:
+        emitJump(-1, pc + get2(p));
+        break;
+    case OP_goto_w:
+        emitJump(-1, pc + get4(p));
+        break;
+    case OP_tableswitch:   case OP_tableswitch_quick:
+    case OP_lookupswitch:  case OP_lookupswitch_quick:
+        /* a sequence of comparisons, read from the original bytecode */
+        code = m->code;
+        op = code[pc];
+        k = (pc + 4) & ~3;
+        dflt = get4(code + k);
+        LOAD32(RAX, STK, 0);
+        emitAddStk(-4);
+        if (op == OP_tableswitch) {
+            low = get4(code + k + 4);
+            high = get4(code + k + 8);
+            /* counted from 0, since n <= high never fails if high is INT_MAX */
+            for( n = 0;  n <= (int64_t)high - low;  n++ ) {
+                emitRR(0, 0x81, 7, RAX);  emit4(low + n);   /* cmp eax,low+n */
+                emitJump(CC_E, pc + get4(code + k + 12 + 4*n));
+            }
+        } else {
+            high = get4(code + k + 4);      /* # pairs */
+            for( n = 0;  n < high;  n++ ) {
+                emitRR(0, 0x81, 7, RAX);  emit4(get4(code + k + 8 + 8*n));
+                emitJump(CC_E, pc + get4(code + k + 12 + 8*n));
+            }
+        }
+        emitJump(-1, pc + dflt);
+        break;
+    case OP_ireturn:  case OP_freturn:  case OP_areturn:
+        emitReturn(1);
+        break;
+    case OP_lreturn:  case OP_dreturn:
+        emitReturn(2);
+        break;
+    case OP_return:
+        emitReturn(0);
+        break;
+
+    /* operations performed by C helpers */
+    case OP_getfield:  case OP_getstatic:
+    case OP_putfield:  case OP_putstatic:
+        if (op == OP_putfield || op == OP_putstatic)
+            m->jitPure = 0;
+        /* locates a NullPointerException in the helper */
+        emitMovImm64(RAX, (uint64_t)(uintptr_t)(m->quickCode + pc + 1));
+        STORE64(FRAME, offsetof(Frame,pc), RAX);
+        emitMovImm64(RDI, (uint64_t)(uintptr_t)ct);
+        emitMovImm32(RSI, (p[0]<<8) + p[1]);
+        emitCall((op == OP_getfield)? (void*)GetField :
+                 (op == OP_getstatic)? (void*)GetStatic :
+                 (op == OP_putfield)? (void*)PutField : (void*)PutStatic);
+        emitRR(0, 0x85, RAX, RAX);
+        emitCheck(CC_NE, EX_ACCESS);
+        break;
+    case OP_invokevirtual:  case OP_invokespecial:  case OP_invokestatic:
+        m->jitPure = 0;
+        emitRR(1, 0x89, FRAME, RDI);
+        emitMovImm32(RSI, pc);
+        emitCall(jitInvoke);
+        break;
+    case OP_getfield_inline:  case OP_getfield2_inline:
+    case OP_putfield_inline:  case OP_putfield2_inline:
+    case OP_init_inline:
+        if (op != OP_getfield_inline && op != OP_getfield2_inline)
+            m->jitPure = 0;
+        emitInlinedAccess(op, (p[0]<<8) + p[1]);
+        break;
+    case OP_new:
+        m->jitPure = 0;
+        emitMovImm64(RDI, (uint64_t)(uintptr_t)ct);
+        emitMovImm32(RSI, (p[0]<<8) + p[1]);
+        emitCall(jitNew);
+        break;
+    case OP_newarray:
+        m->jitPure = 0;
+        emitMovImm32(RDI, p[0]);
+        emitCall(jitNewArray);
+        emitRR(0, 0x85, RAX, RAX);
+        emitCheck(CC_NE, EX_NEGSIZE);
+        break;
+    case OP_anewarray:
+        m->jitPure = 0;
+        emitMovImm64(RDI, (uint64_t)(uintptr_t)ct);
+        emitMovImm32(RSI, (p[0]<<8) + p[1]);
+        emitCall(jitANewArray);
+        emitRR(0, 0x85, RAX, RAX);
+        emitCheck(CC_NE, EX_NEGSIZE);
+        break;
+    case OP_checkcast:
+        emitMovImm64(RDI, (uint64_t)(uintptr_t)ct);
+        emitMovImm32(RSI, (p[0]<<8) + p[1]);
+        emitCall(jitCheckCast);
+        emitRR(0, 0x85, RAX, RAX);
+        emitCheck(CC_NE, EX_CAST);
+        break;
+    case OP_instanceof:
+        emitMovImm64(RDI, (uint64_t)(uintptr_t)ct);
+        emitMovImm32(RSI, (p[0]<<8) + p[1]);
+        emitCall(jitInstanceOf);
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+
+/* copy the assembled code into executable memory; the memory is never
+   writable and executable at once, so the pages which the code is
+   copied to are made writable only while it is copied */
+static void *installCode() {
+    uint8_t *result, *first;
+    size_t len = (cbLen + 15) & ~15, page = sysconf(_SC_PAGESIZE);
+
+    if (execMem == NULL || execUsed + len > execSize) {
+        execSize = (len > JIT_CHUNK_SIZE)? len : JIT_CHUNK_SIZE;
+        execMem = mmap(NULL, execSize, PROT_READ|PROT_WRITE,
+            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (execMem == MAP_FAILED) {
+            execMem = NULL;
+            return NULL;
+        }
+        execUsed = 0;
+        execChunks = realloc(execChunks, (numExecChunks+1) * sizeof(ExecChunk));
+        if (execChunks == NULL) {
+            fprintf(stderr, "out of memory while compiling\n");
+            exit(1);
+        }
+        execChunks[numExecChunks].start = execMem;
+        execChunks[numExecChunks].size = execSize;
+        numExecChunks++;
+    }
+    result = execMem + execUsed;
+    first = execMem + (execUsed & ~(page-1));
+    if (mprotect(first, result + len - first, PROT_READ|PROT_WRITE) != 0)
+        return NULL;
+    memcpy(result, cb, cbLen);
+    execUsed += len;
+    if (mprotect(first, result + len - first, PROT_READ|PROT_EXEC) != 0) {
+        fprintf(stderr, "unable to make the compiled code executable\n");
+        exit(1);
+    }
+    return result;
+}
+
+
+/* Compile method m of class ct; if it cannot be compiled, it is marked
+   so that no further attempts are made */
+static void compileMethod( ClassType *ct, method_info *m ) {
+    char *mname = GetUTF8(ct->cf, m->name_index);
+    int *nativeOffset;
+    int pc, i, ok = 1;
+
+    m->jitState = JIT_FAILED;
+    if (m->exception_table_length > 0
+            || (m->access_flags & ACC_SYNCHRONIZED)) {
+        numRejected++;
+        if (tracingExecution & TRACE_JIT)
+            printf("JIT: method %s of class %s is not compiled\n",
+                mname, ct->cf->cname);
+        return;
+    }
+    nativeOffset = SafeMalloc(m->code_length * sizeof(int));
+    for( pc = 0;  pc < m->code_length;  pc++ )
+        nativeOffset[pc] = -1;
+    cbLen = 0;
+    numFixups = 0;
+    m->jitPure = 1;
+    emitPrologue();
+    /* the original code is used for the instruction lengths because
+       the quick opcodes are not in the opcode tables */
+    for( pc = 0;  pc < m->code_length;  pc += InstructionLength(m->code, pc) ) {
+        nativeOffset[pc] = cbLen;
+        curOffset = pc;
+        if (!compileInstruction(ct, m, pc)) {
+            if (tracingExecution & TRACE_JIT)
+                printf("JIT: method %s of class %s is not compiled "
+                    "because of op %s at offset %d\n", mname, ct->cf->cname,
+                    GetOpcodeName(m->quickCode[pc]), pc);
+            ok = 0;
+            break;
+        }
+    }
+    for( i = 0;  ok && i < numFixups;  i++ ) {
+        int target = fixups[i].target;
+        int pos = fixups[i].patchPos;
+        if (target < 0 || target >= m->code_length || nativeOffset[target] < 0)
+            ok = 0;
+        else {
+            int32_t rel = nativeOffset[target] - (pos + 4);
+            memcpy(cb + pos, &rel, 4);
+        }
+    }
+    if (ok)
+        m->jitCode = installCode();
+    if (!ok || m->jitCode == NULL) {
+        SafeFree(nativeOffset);
+        numRejected++;
+        return;
+    }
+    m->jitEntries = nativeOffset;   /* kept for on-stack replacement */
+    m->jitState = JIT_COMPILED;
+    numCompiled++;
+    bytecodeCompiled += m->code_length;
+    machineCodeSize += cbLen;
+    if (tracingExecution & TRACE_JIT)
+        printf("JIT: compiled method %s of class %s, %d bytes of bytecode "
+            "-> %d bytes of machine code%s\n", mname, ct->cf->cname,
+            m->code_length, cbLen, m->jitPure? " (pure)" : "");
+}
+
+
+/* Called by the SIGSEGV handler for a fault in the guard area of the
+   heap, with the machine context of the fault.  If the fault is in
+   compiled code, sets the pc of its frame to the bytecode instruction
+   which faulted and JVM_Top to its operand stack, and returns true. */
+int JIT_LocateFault( void *context ) {
+    greg_t *regs = ((ucontext_t *)context)->uc_mcontext.gregs;
+    uint8_t *rip = (uint8_t *)regs[REG_RIP];
+    method_info *m;
+    Frame *f;
+    int i, pc, offset, found = -1;
+
+    for( i = 0;  i < numExecChunks;  i++ ) {
+        if (rip >= execChunks[i].start && rip < execChunks[i].start + execChunks[i].size)
+            break;
+    }
+    if (i >= numExecChunks)
+        return 0;
+    f = (Frame *)regs[REG_R13];
+    m = f->method;
+    offset = rip - (uint8_t *)m->jitCode;
+    for( pc = 0;  pc < m->code_length;  pc++ ) {
+        if (m->jitEntries[pc] >= 0 && m->jitEntries[pc] <= offset)
+            found = pc;
+    }
+    assert(found >= 0);
+    f->pc = m->quickCode + found + 1;
+    JVM_Top = (DataItem *)regs[REG_R12];
+    return 1;
+}
+
+
+void JIT_Init( int threshold, int differential ) {
+    char here;
+    JitThreshold = threshold;
+    jitDifferential = differential;
+    cStackBase = (uintptr_t)&here;
+}
+
+
+/* Count a call of method m of class ct, which is about to be executed,
+   and compile the method once it becomes hot.  The result is true if
+   the compiled code should be used. */
+int JIT_CountInvocation( ClassType *ct, method_info *m ) {
+    char here;
+
+    if (m->jitState == JIT_NOT_COMPILED && ++m->invocationCount >= JitThreshold
+            && (tracingExecution & TRACE_OPS) == 0)
+        compileMethod(ct, m);
+    return m->jitState == JIT_COMPILED && cStackBase - (uintptr_t)&here < JIT_CSTACK_LIMIT;
+}
+
+
+/* Execute the method in frame f twice, first with the interpreter and
+   then with its compiled code, and check that the results are the same.
+   Like InterpretMethod, the result is the size of the method's result. */
+static int runDifferential( Frame *f ) {
+    ClassType *ct = f->thisClass;
+    method_info *m = f->method;
+    DataItem args[256], interpResult[2];
+    int nArgs = m->nArgs, rw1, rw2, i, differ, wasChecking;
+
+    memcpy(args, f->locals, nArgs*sizeof(DataItem));
+    wasChecking = checkingInterpreter;
+    checkingInterpreter = 1;
+    rw1 = InterpretMethod(f);
+    checkingInterpreter = wasChecking;
+    memcpy(interpResult, JVM_Top+1-rw1, rw1*sizeof(DataItem));
+    JVM_PopFrame(rw1);
+    JVM_Top -= rw1;
+    memcpy(JVM_Top+1, args, nArgs*sizeof(DataItem));
+    JVM_Top += nArgs;
+    f = JVM_PushFrame(ct, m);
+    rw2 = ((JitCode)m->jitCode)(f, NULL);
+    differ = rw1 != rw2;
+    for( i = 0;  !differ && i < rw1;  i++ )
+        differ = interpResult[i].uval != (JVM_Top+1-rw2+i)->uval;
+    if (differ) {
+        fprintf(stderr, "JIT: results differ for method %s of class %s\n",
+            GetUTF8(ct->cf, m->name_index), ct->cf->cname);
+        exit(1);
+    }
+    numDifferentialChecks++;
+    return rw2;
+}
+
+
+/* Execute the compiled code of the method in frame f */
+int JIT_Run( Frame *f ) {
+    numCompiledCalls++;
+    if (jitDifferential && f->method->jitPure)
+        return runDifferential(f);
+    return ((JitCode)f->method->jitCode)(f, NULL);
+}
+
+
+/* Count a backward branch at offset branchPc of method m in class ct,
+   which the interpreter has just taken, and compile the method once the
+   loop becomes hot.  The result is true if execution should continue in
+   the compiled code from the branch target. */
+int JIT_CountLoop( ClassType *ct, method_info *m, int branchPc ) {
+    char here;
+    u4 count;
+
+    if (m->loopCounts == NULL)
+        m->loopCounts = SafeCalloc(m->code_length, sizeof(u4));
+    count = ++m->loopCounts[branchPc];
+    if (JitThreshold == 0 || m->jitState == JIT_FAILED
+            || (tracingExecution & TRACE_OPS) != 0 || checkingInterpreter)
+        return 0;
+    if (m->jitState == JIT_NOT_COMPILED) {
+        if (count < (u4)JitThreshold * JIT_LOOP_FACTOR)
+            return 0;
+        compileMethod(ct, m);
+        if (m->jitState != JIT_COMPILED)
+            return 0;
+    }
+    return cStackBase - (uintptr_t)&here < JIT_CSTACK_LIMIT;
+}
+
+
+/* Continue the method in frame f, which the interpreter was executing,
+   in its compiled code from bytecode offset pcOffset.  The result is the
+   size of the method's result, as for JIT_Run. */
+int JIT_RunFromLoop( Frame *f, int pcOffset ) {
+    method_info *m = f->method;
+
+    numLoopEntries++;
+    if (tracingExecution & TRACE_JIT)
+        printf("JIT: method %s of class %s continues in compiled code "
+            "at offset %d\n", GetUTF8(f->thisClass->cf, m->name_index),
+            f->thisClass->cf->cname, pcOffset);
+    return ((JitCode)m->jitCode)(f, (uint8_t*)m->jitCode + m->jitEntries[pcOffset]);
+}
+
+
+/* List the loops executed by the interpreter, with their iteration counts */
+void PrintLoopProfile() {
+    ClassType *ct;
+    int i, pc;
+
+    printf("\nLoop Profile (iterations executed by the interpreter)\n"
+        "=====================================================\n\n");
+    for( ct = FirstLoadedClass;  ct != NULL;  ct = ct->nextClass ) {
+        if (ct->isArrayType) continue;
+        for( i = 0;  i < ct->cf->methods_count;  i++ ) {
+            method_info *m = &ct->cf->methods[i];
+            if (m->loopCounts == NULL) continue;
+            for( pc = 0;  pc < m->code_length;  pc++ ) {
+                if (m->loopCounts[pc] == 0) continue;
+                printf("  %s.%s%s: branch at offset %d to offset %d, "
+                    "%u iterations%s\n", ct->cf->cname,
+                    GetUTF8(ct->cf, m->name_index),
+                    GetUTF8(ct->cf, m->descriptor_index), pc,
+                    pc + branchOffset(m->code + pc), m->loopCounts[pc],
+                    m->jitState == JIT_COMPILED? " (compiled)" : "");
+            }
+        }
+    }
+}
+
+
+void PrintJITStatistics() {
+    printf("\nJIT Compiler Statistics\n=======================\n\n");
+    printf("  Number of methods compiled = %d\n", numCompiled);
+    printf("  Number of methods left to the interpreter = %d\n", numRejected);
+    printf("  Bytes of bytecode compiled = %ld\n", bytecodeCompiled);
+    printf("  Bytes of machine code generated = %ld\n", machineCodeSize);
+    printf("  Number of calls of compiled code = %ld\n", numCompiledCalls);
+    printf("  Number of loops continued in compiled code = %ld\n",
+        numLoopEntries);
+    if (jitDifferential)
+        printf("  Number of differential checks passed = %ld\n",
+            numDifferentialChecks);
+}
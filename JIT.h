@@ -0,0 +1,34 @@
+/* JIT.h */
+
+#ifndef JITH
+
+#define JITH
+
+#include "ClassFileFormat.h"  /* to define method_info type */
+#include "jvm.h"              /* to define ClassType and Frame types */
+
+/* values for the jitState field of a method_info struct */
+typedef enum {
+    JIT_NOT_COMPILED=0,   /* still interpreted */
+    JIT_COMPILED,         /* jitCode holds its machine code */
+    JIT_FAILED            /* the method cannot be compiled */
+} JitState;
+
+/* the number of calls after which a method is compiled, for -J */
+#define JIT_DEFAULT_THRESHOLD  100
+
+/* a loop is hot after JitThreshold*JIT_LOOP_FACTOR iterations */
+#define JIT_LOOP_FACTOR  10
+
+extern int JitThreshold;      /* # calls before compilation; 0 => no JIT */
+
+extern void JIT_Init( int threshold, int differential );
+extern int JIT_CountInvocation( ClassType *ct, method_info *m );
+extern int JIT_Run( Frame *f );
+extern int JIT_CountLoop( ClassType *ct, method_info *m, int branchPc );
+extern int JIT_RunFromLoop( Frame *f, int pcOffset );
+extern int JIT_LocateFault( void *context );
+extern void PrintJITStatistics();
+extern void PrintLoopProfile();
+
+#endif
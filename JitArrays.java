@@ -0,0 +1,80 @@
+/*
+ * JitArrays.java
+ * For make check-jit: loads and stores of arrays of each kind, and the
+ * exceptions of bad indexes and null arrays thrown from compiled code.
+ */
+public class JitArrays {
+	static void fill(int[] a, int seed) {
+		for (int i = 0; i < a.length; i++) {
+			seed = seed * 1103515245 + 12345;
+			a[i] = seed >>> 16;
+		}
+	}
+
+	static int sumSquares(int[] a) {
+		int s = 0;
+		for (int i = 0; i < a.length; i++)
+			s += a[i] * a[i];
+		return s;
+	}
+
+	static long sumLongs(long[] a) {
+		long s = 0;
+		for (int i = 0; i < a.length; i++)
+			s += a[i];
+		return s;
+	}
+
+	static double dot(double[] a, double[] b) {
+		double s = 0;
+		for (int i = 0; i < a.length; i++)
+			s += a[i] * b[i];
+		return s;
+	}
+
+	static void reverse(char[] c) {
+		for (int i = 0, j = c.length - 1; i < j; i++, j--) {
+			char t = c[i];
+			c[i] = c[j];
+			c[j] = t;
+		}
+	}
+
+	static int get(int[] a, int i) {
+		return a[i];
+	}
+
+	public static void main(String[] args) {
+		int[] a = new int[100];
+		fill(a, 42);
+		System.out.println(sumSquares(a));
+		long[] l = new long[100];
+		double[] d = new double[100];
+		for (int i = 0; i < a.length; i++) {
+			l[i] = (long) a[i] << 20;
+			d[i] = a[i] / 7.0;
+		}
+		System.out.println(sumLongs(l));
+		System.out.println(dot(d, d));
+		char[] c = new char[26];
+		for (int i = 0; i < c.length; i++)
+			c[i] = (char) ('a' + i);
+		reverse(c);
+		System.out.println(c[0]);
+		System.out.println(c[25]);
+		int caught = 0;
+		for (int i = 98; i < 102; i++) {
+			try {
+				caught += get(a, i) & 1;
+			} catch (ArrayIndexOutOfBoundsException e) {
+				caught += 10;
+			}
+		}
+		try {
+			caught += get(null, 0);
+		} catch (NullPointerException e) {
+			caught += 100;
+		}
+		System.out.println(caught);
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * JitCalls.java
+ * For make check-jit: static, recursive, special and virtual calls, the
+ * latter at a site which sees two receiver classes, and field accesses.
+ */
+public class JitCalls {
+	int value;
+	JitCalls next;
+
+	JitCalls(int value, JitCalls next) {
+		this.value = value;
+		this.next = next;
+	}
+
+	int weight() {
+		return value;
+	}
+
+	int sumList() {
+		int s = 0;
+		for (JitCalls p = this; p != null; p = p.next)
+			s += p.weight();
+		return s;
+	}
+
+	static int fib(int n) {
+		return n < 2 ? n : fib(n - 1) + fib(n - 2);
+	}
+
+	static int gcd(int a, int b) {
+		return b == 0 ? a : gcd(b, a % b);
+	}
+
+	public static void main(String[] args) {
+		JitCalls list = null;
+		for (int i = 1; i <= 100; i++)
+			list = (i % 3 == 0) ? new JitHeavy(i, list) : new JitCalls(i, list);
+		System.out.println(list.sumList());
+		System.out.println(fib(22));
+		int g = 0;
+		for (int i = 1; i <= 2000; i++)
+			g += gcd(i, 360);
+		System.out.println(g);
+	}
+}
+
+class JitHeavy extends JitCalls {
+	JitHeavy(int value, JitCalls next) {
+		super(value, next);
+	}
+
+	int weight() {
+		return value * 1000;
+	}
+}
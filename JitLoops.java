@@ -0,0 +1,43 @@
+/*
+ * JitLoops.java
+ * For make check-jit.  collatz, sum and mix are pure, so MyJVM -Jd
+ * compares their compiled code with the interpreter; the loop of main
+ * becomes hot and continues in compiled code (on-stack replacement).
+ */
+public class JitLoops {
+	static int sum(int n) {
+		int s = 0;
+		for (int i = 0; i < n; i++)
+			s += i * i;
+		return s;
+	}
+
+	static int collatz(int n) {
+		int steps = 0;
+		while (n != 1) {
+			if ((n & 1) == 0)
+				n = n / 2;
+			else
+				n = 3 * n + 1;
+			steps++;
+		}
+		return steps;
+	}
+
+	static long mix(long x, int rounds) {
+		for (int i = 0; i < rounds; i++) {
+			x = x * 6364136223846793005L + 1442695040888963407L;
+			x ^= x >>> 29;
+		}
+		return x;
+	}
+
+	public static void main(String[] args) {
+		int total = 0;
+		for (int n = 1; n < 3000; n++)
+			total += collatz(n);
+		System.out.println(total);
+		System.out.println(sum(1000));
+		System.out.println(mix(1L, 5000));
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * JitSwitch.java
+ * For make check-jit.  dense, top and bottom compile to tableswitch
+ * (top's highest key is Integer.MAX_VALUE and bottom's lowest is
+ * Integer.MIN_VALUE), and sparse to lookupswitch.
+ */
+public class JitSwitch {
+	static int dense(int k) {
+		switch (k) {
+		case 0: return 10;
+		case 1: return 11;
+		case 2: return 12;
+		case 4: return 14;
+		default: return -1;
+		}
+	}
+
+	static int sparse(int k) {
+		switch (k) {
+		case -1000000: return 1;
+		case 7: return 2;
+		case 1000: return 3;
+		case 123456789: return 4;
+		default: return 0;
+		}
+	}
+
+	static int top(int k) {
+		switch (k) {
+		case 0x7ffffffc: return 1;
+		case 0x7ffffffd: return 2;
+		case 0x7ffffffe: return 3;
+		case 0x7fffffff: return 4;
+		default: return 0;
+		}
+	}
+
+	static int bottom(int k) {
+		switch (k) {
+		case 0x80000000: return 1;
+		case 0x80000001: return 2;
+		case 0x80000002: return 3;
+		case 0x80000003: return 4;
+		default: return 0;
+		}
+	}
+
+	public static void main(String[] args) {
+		int s = 0;
+		for (int k = -5; k < 1005; k++)
+			s = s * 31 + dense(k) + sparse(k);
+		System.out.println(s);
+		System.out.println(sparse(-1000000) + sparse(123456789));
+		s = 0;
+		for (int k = 0x7ffffffb; k != 0x80000000; k++)
+			s = s * 10 + top(k);
+		System.out.println(s);
+		s = 0;
+		for (int k = 0x80000000; k != 0x80000005; k++)
+			s = s * 10 + bottom(k);
+		System.out.println(s);
+	}
+}
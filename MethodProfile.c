@@ -0,0 +1,230 @@
+/* MethodProfile.c */
+
+/*
+   The exact profile of calls (the -TM trace option).
+
+   Every call of a Java method creates a frame with JVM_PushFrame and
+   removes it with JVM_PopFrame, or by unwinding for an exception, so
+   these are where the calls are counted and timed: ProfileEnter notes
+   the time at which the frame was created, and ProfileExit charges the
+   time since then to the method.  The time of a call is subtracted
+   from the self time of its caller, whose frame is just below.  The
+   total time of a recursive method is counted for its outermost
+   activation only.  Native methods are timed around the call of their
+   C function (see callNative in ClassResolver.c); a call which throws
+   an exception is not counted.
+
+   The times are taken with clock_gettime(CLOCK_MONOTONIC), which costs
+   some tens of ns, so the times of very short methods are inflated.
+   Trivial methods which the JIT compiler inlines have no frame and are
+   not seen at all.  With -Cm, the hardware counters (see PerfCounters.c)
+   are read wherever the clock is, and their counts are divided among
+   the methods in the same way; those of native methods are left to
+   their callers.
+
+   At exit, however the program ends, the methods are listed by
+   decreasing self time and, with the -M option, the same table is
+   written to a file: in JSON if its name ends with .json, and otherwise
+   in CSV.  The frames still active then, as after an uncaught
+   exception, are charged up to the exit.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "MyAlloc.h"
+#include "NativeClasses.h"
+#include "MethodProfile.h"
+
+/* the times of a frame, kept apart from the frames themselves */
+typedef struct {
+    uint64_t start;         /* when the frame was created */
+    uint64_t childTime;     /* time spent in the calls it made */
+} FrameTimes;
+
+static FrameTimes *frameTimes;        /* indexed as JVM_Frames */
+static uint64_t (*frameEvents)[2][PERF_MAX_COUNTERS];  /* start, children */
+static MethodProfile *allProfiles = NULL;
+static int numProfiles = 0;
+static char *profileFile;
+
+
+uint64_t ProfileClock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+MethodProfile *NewMethodProfile( char *className, char *methodName,
+        char *methodDescr, int isNative ) {
+    MethodProfile *p = SafeCalloc(1, sizeof(MethodProfile));
+    p->className = className;
+    p->methodName = methodName;
+    p->methodDescr = methodDescr;
+    p->isNative = isNative;
+    p->next = allProfiles;
+    allProfiles = p;
+    numProfiles++;
+    return p;
+}
+
+
+void ProfileEnter( Frame *f ) {
+    FrameTimes *t = &frameTimes[f - JVM_Frames];
+    method_info *m = f->method;
+    MethodProfile *p = m->profile;
+
+    if (p == NULL)
+        p = m->profile = NewMethodProfile(f->thisClass->cf->cname,
+            GetUTF8(f->thisClass->cf, m->name_index),
+            GetUTF8(f->thisClass->cf, m->descriptor_index), 0);
+    p->calls++;
+    p->active++;
+    t->childTime = 0;
+    t->start = ProfileClock();
+    if (perfPerMethod) {
+        uint64_t (*ev)[PERF_MAX_COUNTERS] = frameEvents[f - JVM_Frames];
+        memset(ev[1], 0, sizeof(ev[1]));
+        PerfReadCounters(ev[0]);
+    }
+}
+
+
+void ProfileExit( Frame *f ) {
+    FrameTimes *t = &frameTimes[f - JVM_Frames];
+    MethodProfile *p = f->method->profile;
+    uint64_t elapsed = ProfileClock() - t->start;
+    int i;
+
+    p->selfTime += elapsed - t->childTime;
+    if (--p->active == 0)
+        p->totalTime += elapsed;
+    t[-1].childTime += elapsed;
+    if (perfPerMethod) {
+        uint64_t (*ev)[PERF_MAX_COUNTERS] = frameEvents[f - JVM_Frames];
+        uint64_t *callerChild = frameEvents[f - JVM_Frames - 1][1];
+        uint64_t now[PERF_MAX_COUNTERS], d;
+        PerfReadCounters(now);
+        for( i = 0;  i < PerfCountersOpen();  i++ ) {
+            d = now[i] - ev[0][i];
+            p->selfEvents[i] += d - ev[1][i];
+            callerChild[i] += d;
+        }
+    }
+}
+
+
+/* Charges a call of a native method, made from the top frame */
+void ProfileNative( MethodProfile *p, uint64_t elapsed ) {
+    p->calls++;
+    p->selfTime += elapsed;
+    p->totalTime += elapsed;
+    frameTimes[JVM_FrameTop - JVM_Frames].childTime += elapsed;
+}
+
+
+static int bySelfTime( const void *a, const void *b ) {
+    MethodProfile *p = *(MethodProfile **)a, *q = *(MethodProfile **)b;
+    if (p->selfTime != q->selfTime)
+        return (p->selfTime < q->selfTime)? 1 : -1;
+    return (p->calls < q->calls) - (p->calls > q->calls);
+}
+
+
+static void writeProfileFile( MethodProfile **sorted ) {
+    int json, i, k, n = strlen(profileFile);
+    FILE *out = fopen(profileFile, "w");
+
+    if (out == NULL) {
+        fprintf(stderr, "unable to write the method profile to %s\n", profileFile);
+        return;
+    }
+    json = n > 5 && strcmp(profileFile + n - 5, ".json") == 0;
+    if (json)
+        fprintf(out, "[\n");
+    else {
+        fprintf(out, "class,method,descriptor,native,calls,self_ns,total_ns");
+        for( k = 0;  perfPerMethod && k < PerfCountersOpen();  k++ )
+            fprintf(out, ",self_%s", PerfCounterName(k));
+        fprintf(out, "\n");
+    }
+    for( i = 0;  i < numProfiles;  i++ ) {
+        MethodProfile *p = sorted[i];
+        if (json) {
+            fprintf(out, "  {\"class\": \"%s\", \"method\": \"%s\", "
+                "\"descriptor\": \"%s\", \"native\": %s, \"calls\": %ld, "
+                "\"selfNs\": %llu, \"totalNs\": %llu",
+                p->className, p->methodName, p->methodDescr,
+                p->isNative? "true" : "false", p->calls,
+                (unsigned long long)p->selfTime, (unsigned long long)p->totalTime);
+            for( k = 0;  perfPerMethod && k < PerfCountersOpen();  k++ )
+                fprintf(out, ", \"self_%s\": %llu", PerfCounterName(k),
+                    (unsigned long long)p->selfEvents[k]);
+            fprintf(out, "}%s\n", (i < numProfiles - 1)? "," : "");
+        } else {
+            fprintf(out, "%s,%s,%s,%d,%ld,%llu,%llu", p->className,
+                p->methodName, p->methodDescr, p->isNative, p->calls,
+                (unsigned long long)p->selfTime, (unsigned long long)p->totalTime);
+            for( k = 0;  perfPerMethod && k < PerfCountersOpen();  k++ )
+                fprintf(out, ",%llu", (unsigned long long)p->selfEvents[k]);
+            fprintf(out, "\n");
+        }
+    }
+    if (json)
+        fprintf(out, "]\n");
+    fclose(out);
+}
+
+
+/* Lists the methods by decreasing self time; the frames still active
+   are charged up to now */
+static void printMethodProfile() {
+    MethodProfile **sorted = SafeMalloc((numProfiles + 1) * sizeof(MethodProfile *));
+    MethodProfile *p;
+    uint64_t sum = 0;
+    Frame *f;
+    int i = 0, k;
+
+    FlushSystemOut();       /* the program's output goes first */
+    for( f = JVM_FrameTop;  f > JVM_Frames;  f-- )
+        ProfileExit(f);
+    for( p = allProfiles;  p != NULL;  p = p->next ) {
+        sorted[i++] = p;
+        sum += p->selfTime;
+    }
+    qsort(sorted, numProfiles, sizeof(MethodProfile *), bySelfTime);
+
+    printf("\nMethod Profile (by self time)\n=============================\n\n");
+    printf("  %10s %10s %6s %10s", "calls", "self ms", "self%", "total ms");
+    for( k = 0;  perfPerMethod && k < PerfCountersOpen();  k++ )
+        printf(" %14s", PerfCounterName(k));
+    printf("  method\n");
+    for( i = 0;  i < numProfiles;  i++ ) {
+        p = sorted[i];
+        printf("  %10ld %10.3f %6.2f %10.3f", p->calls,
+            p->selfTime / 1e6, (sum > 0)? 100.0 * p->selfTime / sum : 0.0,
+            p->totalTime / 1e6);
+        for( k = 0;  perfPerMethod && k < PerfCountersOpen();  k++ )
+            printf(" %14llu", (unsigned long long)p->selfEvents[k]);
+        printf("  %s.%s%s%s\n", p->className, p->methodName, p->methodDescr,
+            p->isNative? " (native)" : "");
+    }
+    if (profileFile != NULL)
+        writeProfileFile(sorted);
+    SafeFree(sorted);
+}
+
+
+void InitMethodProfile( int stackSize, char *outFile ) {
+    frameTimes = SafeCalloc(stackSize + 1, sizeof(FrameTimes));
+    if (perfPerMethod)
+        frameEvents = SafeCalloc(stackSize + 1, sizeof(*frameEvents));
+    profileFile = outFile;
+    atexit(printMethodProfile);
+}
@@ -0,0 +1,33 @@
+/* MethodProfile.h */
+
+#ifndef METHODPROFILEH
+
+#define METHODPROFILEH
+
+#include <stdint.h>
+#include "jvm.h"
+#include "PerfCounters.h"
+
+/* The calls and times of one method, Java or native */
+typedef struct MethodProfile {
+    char *className;
+    char *methodName;
+    char *methodDescr;
+    int isNative;                 /* true => a method in C */
+    long calls;
+    uint64_t selfTime;            /* ns spent in the method itself */
+    uint64_t totalTime;           /* ns, including the methods it calls */
+    uint64_t selfEvents[PERF_MAX_COUNTERS];  /* counts for -Cm */
+    int active;                   /* # activations not yet returned */
+    struct MethodProfile *next;   /* list of all the profiles */
+} MethodProfile;
+
+extern void InitMethodProfile( int stackSize, char *outFile );
+extern uint64_t ProfileClock();
+extern MethodProfile *NewMethodProfile( char *className, char *methodName,
+        char *methodDescr, int isNative );
+extern void ProfileEnter( Frame *f );
+extern void ProfileExit( Frame *f );
+extern void ProfileNative( MethodProfile *p, uint64_t elapsed );
+
+#endif
@@ -0,0 +1,266 @@
+/* Metrics.c */
+
+/*
+   The registry of runtime metrics (the -N option).
+
+   Each module registers the counters it keeps, as pointers to its own
+   variables, so that counting costs no more than it did before; gauges,
+   whose value is computed by a function when it is needed; and
+   histograms.  A metric may have a kind, such as the kind of invoke op
+   it counts, which distinguishes it from the other metrics of the same
+   name; these must be registered one after the other.
+
+   With the -N option, all the metrics are written to a file at exit,
+   and whenever the process receives SIGUSR1, so that a long run can be
+   watched without tracing it.  The file is in the Prometheus text
+   format or, if its name ends with .json, in JSON.  The dump is made
+   from the signal handler, so it uses only functions which are safe
+   there: the text is made in a static buffer by copying strings and
+   formatting numbers with FormatLong, without stdio or malloc, and it
+   is written with write().  The new file replaces the old one by a
+   rename, so a reader never sees a file which is half written.  The
+   values read by a dump made while the program runs may be a moment
+   apart from each other.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "MyAlloc.h"
+#include "NumberFormat.h"
+#include "Metrics.h"
+
+#define MAX_METRICS          64
+#define METRICS_BUFFER_SIZE  (64*1024)
+
+typedef enum { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM } MetricType;
+
+typedef struct {
+    MetricType type;
+    char *name;
+    char *kind;             /* value of the kind label, or NULL */
+    char *help;
+    long *value;            /* for a counter */
+    GaugeReader read;       /* for a gauge */
+    Histogram *histogram;   /* for a histogram */
+} Metric;
+
+static Metric metrics[MAX_METRICS];
+static volatile int numMetrics = 0;
+static char *metricsFile = NULL, *tempFile;
+static int json;
+static char buffer[METRICS_BUFFER_SIZE];
+static int bufferUsed;
+
+
+static void addMetric( Metric *m ) {
+    if (numMetrics >= MAX_METRICS) {
+        fprintf(stderr, "too many metrics registered (max %d)\n", MAX_METRICS);
+        exit(1);
+    }
+    metrics[numMetrics] = *m;
+    numMetrics++;
+}
+
+
+/* Registers the counter *value, which is to be named name; kind is NULL
+   unless the counter is one of a family of that name */
+void RegisterCounter( char *name, char *kind, char *help, long *value ) {
+    Metric m = { METRIC_COUNTER, name, kind, help, value, NULL, NULL };
+    addMetric(&m);
+}
+
+
+void RegisterGauge( char *name, char *kind, char *help, GaugeReader read ) {
+    Metric m = { METRIC_GAUGE, name, kind, help, NULL, read, NULL };
+    addMetric(&m);
+}
+
+
+void RegisterHistogram( char *name, char *help, Histogram *h ) {
+    Metric m = { METRIC_HISTOGRAM, name, NULL, help, NULL, NULL, h };
+    addMetric(&m);
+}
+
+
+void HistogramAdd( Histogram *h, long value ) {
+    int i = 0;
+
+    while(i < HISTOGRAM_BOUNDS && value > (1L << i))
+        i++;
+    h->buckets[i]++;
+    h->count++;
+    h->sum += value;
+}
+
+
+/* Appends the strings, up to a NULL, to the buffer */
+static void append( char *s, ... ) {
+    va_list args;
+    int n;
+
+    va_start(args, s);
+    for( ;  s != NULL;  s = va_arg(args, char *) ) {
+        n = strlen(s);
+        if (n > METRICS_BUFFER_SIZE - bufferUsed)
+            n = METRICS_BUFFER_SIZE - bufferUsed;     /* the dump is cut short */
+        memcpy(buffer + bufferUsed, s, n);
+        bufferUsed += n;
+    }
+    va_end(args);
+}
+
+
+static void appendLong( long v ) {
+    char digits[NUMBER_BUFFER_SIZE];
+
+    FormatLong(digits, v);
+    append(digits, NULL);
+}
+
+
+static long metricValue( Metric *m ) {
+    return (m->type == METRIC_COUNTER)? *m->value : m->read();
+}
+
+
+static void appendPrometheus() {
+    static char *typeNames[] = { "counter", "gauge", "histogram" };
+    long total;
+    int i, b;
+
+    for( i = 0;  i < numMetrics;  i++ ) {
+        Metric *m = &metrics[i];
+        if (i == 0 || strcmp(m->name, metrics[i-1].name) != 0)
+            append("# HELP ", m->name, " ", m->help, "\n# TYPE ", m->name,
+                " ", typeNames[m->type], "\n", NULL);
+        if (m->type != METRIC_HISTOGRAM) {
+            append(m->name, NULL);
+            if (m->kind != NULL)
+                append("{kind=\"", m->kind, "\"}", NULL);
+            append(" ", NULL);
+            appendLong(metricValue(m));
+            append("\n", NULL);
+            continue;
+        }
+        for( total = 0, b = 0;  b < HISTOGRAM_BOUNDS;  b++ ) {
+            total += m->histogram->buckets[b];
+            append(m->name, "_bucket{le=\"", NULL);
+            appendLong(1L << b);
+            append("\"} ", NULL);
+            appendLong(total);
+            append("\n", NULL);
+        }
+        append(m->name, "_bucket{le=\"+Inf\"} ", NULL);
+        appendLong(m->histogram->count);
+        append("\n", m->name, "_sum ", NULL);
+        appendLong(m->histogram->sum);
+        append("\n", m->name, "_count ", NULL);
+        appendLong(m->histogram->count);
+        append("\n", NULL);
+    }
+}
+
+
+/* The metrics of a name with kinds form one object, keyed by kind */
+static void appendJSON() {
+    long total;
+    int i, b, first, last;
+
+    append("{", NULL);
+    for( i = 0;  i < numMetrics;  i++ ) {
+        Metric *m = &metrics[i];
+        first = i == 0 || strcmp(m->name, metrics[i-1].name) != 0;
+        last = i == numMetrics-1 || strcmp(m->name, metrics[i+1].name) != 0;
+        if (first)
+            append((i > 0)? "," : "", "\n  \"", m->name, "\": ", NULL);
+        if (m->type == METRIC_HISTOGRAM) {
+            append("{\"count\": ", NULL);
+            appendLong(m->histogram->count);
+            append(", \"sum\": ", NULL);
+            appendLong(m->histogram->sum);
+            append(", \"buckets\": {", NULL);
+            for( total = 0, b = 0;  b < HISTOGRAM_BOUNDS;  b++ ) {
+                total += m->histogram->buckets[b];
+                append("\"", NULL);
+                appendLong(1L << b);
+                append("\": ", NULL);
+                appendLong(total);
+                append(", ", NULL);
+            }
+            append("\"+Inf\": ", NULL);
+            appendLong(m->histogram->count);
+            append("}}", NULL);
+        } else if (m->kind != NULL) {
+            append(first? "{" : ", ", "\"", m->kind, "\": ", NULL);
+            appendLong(metricValue(m));
+            append(last? "}" : "", NULL);
+        } else
+            appendLong(metricValue(m));
+    }
+    append("\n}\n", NULL);
+}
+
+
+/* Writes the current values of all the metrics to the metrics file */
+void DumpMetrics() {
+    int fd;
+
+    if (metricsFile == NULL) return;
+    bufferUsed = 0;
+    if (json)
+        appendJSON();
+    else
+        appendPrometheus();
+    fd = open(tempFile, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) return;
+    if (write(fd, buffer, bufferUsed) != bufferUsed) {
+        close(fd);
+        return;
+    }
+    close(fd);
+    rename(tempFile, metricsFile);
+}
+
+
+static void dumpOnSignal( int sig ) {
+    int savedErrno = errno;
+
+    DumpMetrics();
+    errno = savedErrno;
+}
+
+
+static void dumpAtExit() {
+    signal(SIGUSR1, SIG_IGN);
+    DumpMetrics();
+}
+
+
+/* Arranges for the metrics to be written to fileName at exit and on
+   SIGUSR1 */
+void InitMetrics( char *fileName ) {
+    struct sigaction sa;
+    int n = strlen(fileName);
+
+    metricsFile = fileName;
+    json = n > 5 && strcmp(fileName + n - 5, ".json") == 0;
+    tempFile = SafeMalloc(n + 5);
+    sprintf(tempFile, "%s.tmp", fileName);
+    atexit(dumpAtExit);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = dumpOnSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGUSR1, &sa, NULL) != 0) {
+        fprintf(stderr, "unable to install the SIGUSR1 handler\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,25 @@
+/* Metrics.h */
+
+#ifndef METRICSH
+
+#define METRICSH
+
+#define HISTOGRAM_BOUNDS  21    /* the buckets hold values <= 1, 2, 4, ... 2^20 */
+
+/* A distribution of values, such as times in microseconds */
+typedef struct {
+    long count;
+    long sum;
+    long buckets[HISTOGRAM_BOUNDS+1];   /* the last one holds larger values */
+} Histogram;
+
+typedef long (*GaugeReader)();
+
+extern void RegisterCounter( char *name, char *kind, char *help, long *value );
+extern void RegisterGauge( char *name, char *kind, char *help, GaugeReader read );
+extern void RegisterHistogram( char *name, char *help, Histogram *h );
+extern void HistogramAdd( Histogram *h, long value );
+extern void InitMetrics( char *fileName );
+extern void DumpMetrics();
+
+#endif
@@ -11,10 +11,31 @@
    Java Heap Management Functions:
    * InitMyAlloc  -- initializes the Java heap before execution starts
    * MyHeapAlloc  -- returns a block of memory from the Java heap
-   * gc           -- the System.gc garbage collector
-   * MyHeapFree   -- to be called only by gc()!!
+   * gc           -- the garbage collector, also used by System.gc
+   * AddGCRoots   -- registers references held outside the Java heap
    * PrintHeapUsageStatistics  -- does as the name suggests
 
+   The allocations, counted by the kind of object, and the collections,
+   with their pause times, are registered as metrics (see Metrics.c).
+
+   The garbage collector is a non-moving mark-sweep collector.
+   The JVM stack and the static fields hold untyped 4 byte items, so
+   they are scanned conservatively: any value which is the address of
+   an allocated block is treated as a reference.  So are the fields of
+   class instances.  Arrays of references are scanned precisely.
+   A bitmap with one bit per word of the heap records where allocated
+   blocks start, which is how a plausible reference is recognized, and
+   the sweep rebuilds the free list in address order, merging adjacent
+   free blocks.
+
+   The heap begins with a guard area of HEAP_GUARD_SIZE bytes which is
+   never allocated and is mapped with no access rights.  A null
+   reference is offset 0, so a field or array header reached through it
+   lies in the guard area, and the access faults instead of silently
+   reading or overwriting the first block of the heap.  The fault is
+   turned into a NullPointerException (see Exceptions.c), which lets
+   compiled code omit explicit null checks.
+
    General Storage Functions:
    * SafeMalloc  -- used like malloc
    * SafeCalloc  -- used like calloc
@@ -26,10 +47,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/mman.h>
 
 #include "ClassFileFormat.h"
 #include "TraceOptions.h"
+#include "EventTrace.h"
+#include "jvm.h"
+#include "ClassResolver.h"
 #include "MyAlloc.h"
+#include "Timeline.h"
+#include "Metrics.h"
 
 /* we will never allocate a block smaller than this */
 #define MINBLOCKSIZE 12
@@ -46,40 +75,122 @@ HeapPointer MaxHeapPtr;
 
 static int offsetToFirstBlock = -1;
 static long totalBytesRequested = 0;
-static int numAllocations = 0;
-static int gcCount = 0;
+static long numAllocations = 0;
+static long gcCount = 0;
 static long totalBytesRecovered = 0;
-static int totalBlocksRecovered = 0;
-static int searchCount = 0;
+static long totalBlocksRecovered = 0;
+static long searchCount = 0;
+static long bytesInUse = 0;             /* in allocated blocks */
+static Histogram gcPauses;              /* in microseconds */
+
+/* the allocations of each kind of object, most frequent first */
+static struct {
+    uint32_t code;
+    char *name;
+    long count;
+} heapKinds[] = {
+    { CODE_INST, "instance" },
+    { CODE_ARRS, "array" },
+    { CODE_STRG, "string" },
+    { CODE_ARRA, "reference_array" },
+    { CODE_SBLD, "string_builder" },
+    { CODE_EXCP, "exception" },
+    { CODE_CLAS, "class" }
+};
+#define NUM_HEAP_KINDS (sizeof(heapKinds)/sizeof(heapKinds[0]))
 
 static void *maxAddr = NULL;    // used by SafeMalloc, etc
 static void *minAddr = NULL;
 
+/* bitmaps with one bit for each word of the heap, indexed by the
+   heap offset of an object (just after the block's size field) */
+static uint32_t *allocatedBits = NULL;  /* an allocated block starts here */
+static uint32_t *markBits = NULL;       /* the object is reachable */
+static int bitmapWords;
+
+/* arrays of references held in C data structures, registered by AddGCRoots */
+typedef struct {
+    HeapPointer *refs;
+    int count;
+} RootArray;
+
+static RootArray *extraRoots = NULL;
+static int numExtraRoots = 0, maxExtraRoots = 0;
+
+/* objects which have been marked but whose contents are not scanned yet */
+static HeapPointer *markStack = NULL;
+static int markStackTop = 0, markStackSize = 0;
 
-/* Allocate the Java heap and initialize the free list */
+#define TEST_BIT(bits,off)   (((bits)[(off)>>7] >> (((off)>>2)&31)) & 1)
+#define SET_BIT(bits,off)    ((bits)[(off)>>7] |= 1u << (((off)>>2)&31))
+#define CLEAR_BIT(bits,off)  ((bits)[(off)>>7] &= ~(1u << (((off)>>2)&31)))
+
+
+static long readBytesInUse() {
+    return bytesInUse;
+}
+
+
+static void registerHeapMetrics() {
+    int i;
+
+    for( i = 0;  i < NUM_HEAP_KINDS;  i++ )
+        RegisterCounter("jvm_allocations_total", heapKinds[i].name,
+            "Objects allocated in the heap, by kind", &heapKinds[i].count);
+    RegisterCounter("jvm_allocated_bytes_total", NULL,
+        "Bytes allocated in the heap", &totalBytesRequested);
+    RegisterCounter("jvm_free_list_probes_total", NULL,
+        "Free list blocks checked by allocations", &searchCount);
+    RegisterGauge("jvm_heap_allocated_bytes", NULL,
+        "Bytes of the heap in allocated blocks, reachable or not",
+        readBytesInUse);
+    RegisterCounter("jvm_gc_total", NULL, "Garbage collections", &gcCount);
+    RegisterCounter("jvm_gc_reclaimed_bytes_total", NULL,
+        "Bytes reclaimed by garbage collections", &totalBytesRecovered);
+    RegisterHistogram("jvm_gc_pause_microseconds",
+        "Pause times of garbage collections", &gcPauses);
+}
+
+
+/* Allocate the Java heap, after its guard area, and initialize the
+   free list */
 void InitMyAlloc( int HeapSize ) {
     FreeStorageBlock *FreeBlock;
+    int totalSize;
 
     HeapSize &= 0xfffffffc;   /* force to a multiple of 4 */
-    HeapStart = calloc(1,HeapSize);
-    if (HeapStart == NULL) {
+    totalSize = HEAP_GUARD_SIZE + HeapSize;
+    HeapStart = mmap(NULL, totalSize, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (HeapStart == MAP_FAILED
+            || mprotect(HeapStart, HEAP_GUARD_SIZE, PROT_NONE) != 0) {
         fprintf(stderr, "unable to allocate %d bytes for heap\n", HeapSize);
         exit(1);
     }
-    HeapEnd = HeapStart + HeapSize;
-    MaxHeapPtr = (HeapPointer)HeapSize;
+    HeapEnd = HeapStart + totalSize;
+    MaxHeapPtr = (HeapPointer)totalSize;
     
-    FreeBlock = (FreeStorageBlock*)HeapStart;
+    bitmapWords = (totalSize/4 + 31) / 32;
+    allocatedBits = calloc(bitmapWords, sizeof(uint32_t));
+    markBits = calloc(bitmapWords, sizeof(uint32_t));
+    if (allocatedBits == NULL || markBits == NULL) {
+        fprintf(stderr, "unable to allocate the heap bitmaps\n");
+        exit(1);
+    }
+
+    FreeBlock = (FreeStorageBlock*)(HeapStart + HEAP_GUARD_SIZE);
     FreeBlock->size = HeapSize;
     FreeBlock->offsetToNextBlock = -1;  /* marks end of list */
-    offsetToFirstBlock = 0;
+    offsetToFirstBlock = HEAP_GUARD_SIZE;
     
     // Used bu SafeMalloc, SafeCalloc, SafeFree below
     maxAddr = minAddr = malloc(4);  // minimal small request to get things started
+    registerHeapMetrics();
 }
 
 /* Returns a pointer to a block with at least size bytes available,
-   and initialized to hold zeros.
+   initialized to hold zeros except for its first word, which is set to
+   kind (one of the CODE_ values in jvm.h).
    Notes:
    1. The result will always be a word-aligned address.
    2. The word of memory preceding the result address holds the
@@ -88,19 +199,26 @@ void InitMyAlloc( int HeapSize ) {
    3. A block larger than that requested may be returned if the
       leftover portion would be too small to be useful.
    4. The size of the returned block is always a multiple of 4.
-   5. The implementation of MyAlloc contains redundant tests to
+   5. A garbage collection may occur; the caller must make sure that
+      any reference it needs afterwards is on the JVM stack.
+   6. The implementation of MyAlloc contains redundant tests to
       verify that the free list blocks contain plausible info.
 */
-void *MyHeapAlloc( int size ) {
+void *MyHeapAlloc( int size, uint32_t kind ) {
     /* we need size bytes plus more for the size field that precedes
        the block in memory, and we round up to a multiple of 4 */
     int offset, diff, blocksize;
     FreeStorageBlock *blockPtr, *prevBlockPtr, *newBlockPtr;
-    int minSizeNeeded = (size + sizeof(blockPtr->size) + 3) & 0xfffffffc;
+    uint32_t *result;
+    int i, minSizeNeeded = (size + sizeof(blockPtr->size) + 3) & 0xfffffffc;
 
-    if (tracingExecution & TRACE_HEAP)
-        fprintf(stdout, "* heap allocation request of size %d (augmented to %d)\n",
-            size, minSizeNeeded);
+    if (tracingExecution & TRACE_HEAP) {
+        if (recordingEvents)
+            RecordEvent(EV_ALLOC, 0, 0, size);
+        else
+            fprintf(stdout, "* heap allocation request of size %d (augmented to %d)\n",
+                size, minSizeNeeded);
+    }
     blockPtr = prevBlockPtr = NULL;
     offset = offsetToFirstBlock;
     while(offset >= 0) {
@@ -128,7 +246,6 @@ void *MyHeapAlloc( int size ) {
     }
     if (offset < 0) {
         static int gcAlreadyPerformed = 0;
-        void *result;
         if (gcAlreadyPerformed) {
             /* we are in a recursive call to MyAlloc after a gc */
             fprintf(stderr,
@@ -137,7 +254,7 @@ void *MyHeapAlloc( int size ) {
         }
         gc();
         gcAlreadyPerformed = 1;
-        result = MyHeapAlloc(size);
+        result = MyHeapAlloc(size, kind);
         /* control never returns from the preceding call if the gc
            did not obtain enough storage */
         gcAlreadyPerformed = 0;
@@ -153,7 +270,7 @@ void *MyHeapAlloc( int size ) {
             offsetToFirstBlock = blockPtr->offsetToNextBlock;
         else
             prevBlockPtr->offsetToNextBlock = blockPtr->offsetToNextBlock;
-        if (tracingExecution & TRACE_HEAP)
+        if ((tracingExecution & TRACE_HEAP) && !recordingEvents)
             fprintf(stdout, "* free list block of size %d used\n", blocksize);
     } else {
         /* we split the free block that we found into two pieces;
@@ -168,59 +285,205 @@ void *MyHeapAlloc( int size ) {
             prevBlockPtr->offsetToNextBlock += minSizeNeeded;
         newBlockPtr->size = diff;
         newBlockPtr->offsetToNextBlock = blockPtr->offsetToNextBlock;
-        if (tracingExecution & TRACE_HEAP)
+        if ((tracingExecution & TRACE_HEAP) && !recordingEvents)
             fprintf(stdout, "* free list block of size %d split into %d + %d\n",
                 diff+minSizeNeeded, minSizeNeeded, diff);
 
     }
-    blockPtr->offsetToNextBlock = 0;  /* remove this info from the returned block */
+    /* a block recovered by the gc still holds its old contents */
+    memset((uint8_t*)blockPtr + sizeof(blockPtr->size), 0,
+        blockPtr->size - sizeof(blockPtr->size));
+    SET_BIT(allocatedBits, (uint8_t*)blockPtr + sizeof(blockPtr->size) - HeapStart);
     totalBytesRequested += minSizeNeeded;
     numAllocations++;
-    return (uint8_t*)blockPtr + sizeof(blockPtr->size);
+    bytesInUse += blockPtr->size;
+    for( i = 0;  i < NUM_HEAP_KINDS-1 && heapKinds[i].code != kind;  i++ )
+        ;
+    heapKinds[i].count++;
+    result = (uint32_t*)((uint8_t*)blockPtr + sizeof(blockPtr->size));
+    *result = kind;
+    return result;
 }
 
 
-/* When garbage collection is implemented, this function should never
-   be called from outside the current file.
-   This implementation checks that p is plausible and that the block of
-   memory referenced by p holds a plausible size field.
-*/
-static void MyHeapFree(void *p) {
-    uint8_t *p1 = (uint8_t*)p;
-    int blockSize;
-    FreeStorageBlock *blockPtr;
+/* Marks the object referenced by x, if x is a plausible reference to
+   an object which is not marked yet, and queues it to be scanned */
+static void markReference( HeapPointer x ) {
+    if (x == NULL_HEAP_REFERENCE || x >= MaxHeapPtr || (x & 3) != 0
+            || !TEST_BIT(allocatedBits, x) || TEST_BIT(markBits, x))
+        return;
+    SET_BIT(markBits, x);
+    if (markStackTop >= markStackSize) {
+        markStackSize = (markStackSize == 0)? 1024 : markStackSize*2;
+        markStack = realloc(markStack, markStackSize*sizeof(HeapPointer));
+        if (markStack == NULL) {
+            fprintf(stderr, "out of memory during garbage collection\n");
+            exit(1);
+        }
+    }
+    markStack[markStackTop++] = x;
+}
 
-    if (p1 < HeapStart || p1 >= HeapEnd || ((p1-HeapStart) & 3) != 0) {
-        fprintf(stderr, "bad call to MyHeapFree -- bad pointer\n");
-        exit(1);
+
+/* Marks the heap block which holds the real pointer p, if any */
+static void markPointer( void *p ) {
+    if ((uint8_t*)p >= HeapStart && (uint8_t*)p < HeapEnd)
+        markReference(MAKE_HEAP_REFERENCE(p));
+}
+
+
+/* Marks the references in n consecutive data items, scanned
+   conservatively */
+static void markDataItems( DataItem *d, int n ) {
+    while(n-- > 0)
+        markReference((d++)->pval);
+}
+
+
+/* Marks everything referenced from the object x */
+static void scanObject( HeapPointer x ) {
+    uint8_t *p = REAL_HEAP_POINTER(x);
+    uint32_t blockSize = *(uint32_t*)(p - sizeof(uint32_t));
+    ArrayOfRef *arr;
+    int i;
+
+    switch(*(uint32_t*)p) {
+    case CODE_INST:
+        markDataItems(((ClassInstance*)p)->instField,
+            (blockSize - sizeof(uint32_t) - offsetof(ClassInstance,instField))
+                / sizeof(DataItem));
+        break;
+    case CODE_ARRA:
+        arr = (ArrayOfRef*)p;
+        markReference(arr->classRef);
+        for( i = 0;  i < arr->size;  i++ )
+            markReference(arr->elements[i]);
+        break;
+    case CODE_CLAS:     /* an array type */
+        markPointer(((ClassType*)p)->elementType);
+        break;
+    case CODE_SBLD:
+        markReference(((StringBuilderInstance*)p)->value);
+        break;
+    default:            /* strings and simple arrays */
+        break;
     }
-    /* step back over the size field */
-    p1 -= sizeof(blockPtr->size);
-    /* now check the size field for validity */
-    blockSize = *(uint32_t*)p1;
-    if (blockSize < MINBLOCKSIZE || (p1 + blockSize) >= HeapEnd || (blockSize & 3) != 0) {
-        fprintf(stderr, "bad call to MyHeapFree -- invalid block\n");
-        exit(1);
+}
+
+
+/* Registers an array of count references, outside the Java heap, which
+   the garbage collector must treat as roots.  The array must remain
+   allocated for the rest of the execution. */
+void AddGCRoots( HeapPointer *refs, int count ) {
+    if (numExtraRoots >= maxExtraRoots) {
+        maxExtraRoots = (maxExtraRoots == 0)? 16 : maxExtraRoots*2;
+        extraRoots = realloc(extraRoots, maxExtraRoots*sizeof(RootArray));
+        if (extraRoots == NULL) {
+            fprintf(stderr, "Fatal error: memory request cannot be satisfied\n");
+            exit(1);
+        }
+    }
+    extraRoots[numExtraRoots].refs = refs;
+    extraRoots[numExtraRoots].count = count;
+    numExtraRoots++;
+}
+
+
+/* Marks all objects reachable from the roots: the JVM stack (which holds
+   the local variables of all active methods), the static fields, the
+   types of arrays, which are allocated on the heap, and the arrays
+   registered by AddGCRoots */
+static void markPhase() {
+    ClassType *ct;
+    int i, j;
+
+    markDataItems(JVM_Stack, JVM_Top - JVM_Stack + 1);
+    markPointer(Fake_System_Out);
+    for( ct = FirstLoadedClass;  ct != NULL;  ct = ct->nextClass ) {
+        if (ct->isArrayType)
+            markPointer(ct);
+        else
+            markDataItems(ct->classField, ct->numClassFields);
     }
-    /* link the block into the free list at the front */
-    blockPtr = (FreeStorageBlock*)p1;
-    blockPtr->offsetToNextBlock = offsetToFirstBlock;
-    offsetToFirstBlock = p1 - HeapStart;
+    for( i = 0;  i < numExtraRoots;  i++ )
+        for( j = 0;  j < extraRoots[i].count;  j++ )
+            markReference(extraRoots[i].refs[j]);
+    while(markStackTop > 0)
+        scanObject(markStack[--markStackTop]);
+}
+
+
+/* Frees every allocated block which is not marked, then rebuilds the
+   free list from all the free blocks in address order, merging adjacent
+   free blocks */
+static void sweepPhase() {
+    uint32_t offset = HEAP_GUARD_SIZE, heapSize = HeapEnd - HeapStart;
+    FreeStorageBlock *lastFree = NULL, *blockPtr;
+    int runStart = -1;
+
+    offsetToFirstBlock = -1;
+    while(offset <= heapSize) {
+        uint32_t obj = offset + sizeof(blockPtr->size);
+        int isFree = 1;
+        blockPtr = (FreeStorageBlock*)(HeapStart + offset);
+        if (offset < heapSize && TEST_BIT(allocatedBits, obj)) {
+            if (TEST_BIT(markBits, obj))
+                isFree = 0;
+            else {
+                CLEAR_BIT(allocatedBits, obj);
+                totalBytesRecovered += blockPtr->size;
+                bytesInUse -= blockPtr->size;
+                totalBlocksRecovered++;
+            }
+        }
+        if (isFree && offset < heapSize) {
+            if (runStart < 0)
+                runStart = offset;
+        } else if (runStart >= 0) {
+            /* the free blocks from runStart to offset become one block */
+            FreeStorageBlock *run = (FreeStorageBlock*)(HeapStart + runStart);
+            run->size = offset - runStart;
+            run->offsetToNextBlock = -1;
+            if (lastFree == NULL)
+                offsetToFirstBlock = runStart;
+            else
+                lastFree->offsetToNextBlock = runStart;
+            lastFree = run;
+            runStart = -1;
+        }
+        if (offset == heapSize) break;
+        offset += blockPtr->size;
+    }
+    memset(markBits, 0, bitmapWords*sizeof(uint32_t));
 }
 
 
 /* This implements garbage collection.
-   It should be called when
+   It is called when
    (a) MyAlloc cannot satisfy a request for a block of memory, or
    (b) when invoked by the call System.gc() in the Java program.
 */
 void gc() {
+    long bytesBefore = totalBytesRecovered;
+    long blocksBefore = totalBlocksRecovered;
+    struct timespec start, end;
+
     gcCount++;
-    fprintf(stderr, "garbage collection is unimplemented\n");
-    // The following lines of code exist only so that the compiler does not
-    // generate a warning message that MyHeapFree is defined but not used.
-    if (0) {
-    	MyHeapFree(NULL);
+    TimelineBegin("gc", "gc #%ld", gcCount);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    markPhase();
+    sweepPhase();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    HistogramAdd(&gcPauses, (end.tv_sec - start.tv_sec) * 1000000
+        + (end.tv_nsec - start.tv_nsec) / 1000);
+    TimelineEnd();
+    if (tracingExecution & TRACE_HEAP) {
+        if (recordingEvents)
+            RecordEvent(EV_GC, 0, 0, totalBytesRecovered - bytesBefore);
+        else
+            fprintf(stdout, "* garbage collection #%ld: %ld blocks, %ld bytes reclaimed\n",
+                gcCount, totalBlocksRecovered - blocksBefore,
+                totalBytesRecovered - bytesBefore);
     }
 }
 
@@ -228,18 +491,18 @@ void gc() {
 /* Report on heap memory usage */
 void PrintHeapUsageStatistics() {
     printf("\nHeap Usage Statistics\n=====================\n\n");
-    printf("  Number of blocks allocated = %d\n", numAllocations);
+    printf("  Number of blocks allocated = %ld\n", numAllocations);
     if (numAllocations > 0) {
         float avgBlockSize = (float)totalBytesRequested / numAllocations;
         float avgSearch = (float)searchCount / numAllocations;
         printf("  Average size of allocated blocks = %.2f\n", avgBlockSize);
         printf("  Average number of blocks checked = %.2f\n", avgSearch);
     }
-    printf("  Number of garbage collections = %d\n", gcCount);
+    printf("  Number of garbage collections = %ld\n", gcCount);
     if (gcCount > 0) {
         float avgRecovery = (float)totalBytesRecovered / gcCount;
         printf("  Total storage reclaimed = %ld\n", totalBytesRecovered);
-        printf("  Total number of blocks reclaimed = %d\n", totalBlocksRecovered);
+        printf("  Total number of blocks reclaimed = %ld\n", totalBlocksRecovered);
         printf("  Average bytes recovered per gc = %.2f\n", avgRecovery);
     }
 }
@@ -12,14 +12,28 @@
    even on a machine with 64-bit words.  */
 typedef uint32_t HeapPointer;
 
+/* The heap begins with an area which is never allocated and cannot be
+   accessed, so that the header of an array or a field of an instance
+   reached through a null reference faults.  An access which may reach
+   beyond the area, IN_HEAP_GUARD being false for its offset in the
+   object, still needs an explicit null check. */
+#define HEAP_GUARD_SIZE  (64*1024)
+#define IN_HEAP_GUARD(offset)  ((offset) + 8 <= HEAP_GUARD_SIZE)
+
 extern uint8_t *HeapStart, *HeapEnd;
 extern HeapPointer MaxHeapPtr;
 
 extern void InitMyAlloc( int HeapSize );
-extern void *MyHeapAlloc( int size );
+extern void *MyHeapAlloc( int size, uint32_t kind );
 extern void gc();
+extern void AddGCRoots( HeapPointer *refs, int count );
 extern void PrintHeapUsageStatistics();
 
+/* Called after references have been stored into the object obj.  The
+   collector marks from the roots every time, so it needs no barrier;
+   a generational or incremental collector would record obj here. */
+#define GC_WRITE_BARRIER(obj)  ((void)(obj))
+
 extern char *SafeStrdup( char *s );
 extern void *SafeMalloc( int size );
 extern void *SafeCalloc( int ncopies, int size );
@@ -9,6 +9,9 @@
       java/lang/System
           out   -- static field, type PrintStream
           gc()  -- static method
+          arraycopy() -- static method, see ArrayOps.c
+      java/util/Arrays
+          fill() -- static methods for every array type, see ArrayOps.c
       java/lang/Integer
           parseInt()  -- static method
       java/lang/Double
@@ -18,15 +21,37 @@
       java/io/PrintStream
           print(String)
           print(int)
+          print(long)
           print(float)
           print(double)
+          print(char)
+          print(boolean)
           println ... same argument types as for print
       java/lang/String
           charAt(int)
           length()
+          hashCode()
           
-      StringBuilder methods are passed on to StringBuilder.c for handling
+      java/lang/Object
+          <init>()
+      java/lang/Throwable and its subclasses in java/lang
+          <init>(), <init>(String)
 
+      StringBuilder methods are implemented in StringBuilder.c
+
+   Each native method is registered once, by class name, method name and
+   descriptor, in a hash table.  The first time an invoke op refers to a
+   method of a class which cannot be loaded, GeneralInvoke finds the C
+   function here and binds it to the MethodRef constant of the caller,
+   so that later calls are a single indirect call.  A new native method
+   is added by writing its function and registering it in
+   InitNativeClasses.
+
+   Output to System.out is collected in a large buffer and written to
+   file descriptor 1 with write(2), a buffer at a time.  The buffer is
+   flushed when it fills, when System.gc() is called, when the main
+   method returns and at exit.  In line mode (the -B option), it is also
+   flushed at the end of every line, for interactive use.
 */
 
 #include <stdio.h>
@@ -34,6 +59,8 @@
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include "ClassFileFormat.h"
 #include "jvm.h"
@@ -41,155 +68,358 @@
 #include "MyAlloc.h"
 #include "TraceOptions.h"
 #include "StringBuilder.h"
+#include "NumberFormat.h"
+#include "Exceptions.h"
+#include "ArrayOps.h"
 #include "NativeClasses.h"
 
 
-void MissingClassVirtualMethod( char *className, char *methodName, char *methodDescr ) {
-    if (strcmp(className,"java/io/PrintStream") == 0) {  /* fake the method invocation */
-        if (strcmp(methodName,"println") == 0 || strcmp(methodName,"print") == 0) {
-            if (strcmp(methodDescr,"(Ljava/lang/String;)V") == 0) {
-                HeapPointer hp = JVM_Pop();
-                if (hp == NULL_HEAP_REFERENCE)
-                    throwExceptionExternal("NullPointerException", methodName, className);
-                StringInstance *arg = REAL_HEAP_POINTER(hp);
-                printf("%s",arg->sval);
-            } else if (strcmp(methodDescr,"(I)V") == 0) {
-                int i = JVM_Pop();
-                printf("%d",i);
-            } else if (strcmp(methodDescr,"(F)V") == 0) {
-                float f = JVM_PopFloat();
-                printf("%f",f);
-            } else if (strcmp(methodDescr,"(D)V") == 0) {
-                union { struct { uint32_t v0; uint32_t v1; } ss; double d; } pair;
-                pair.ss.v1 = JVM_Pop();
-                pair.ss.v0 = JVM_Pop();
-                printf("%lf", pair.d);
-           } else if (strcmp(methodDescr, "()V") == 0 && strcmp(methodName,"println") == 0) {
-                // nothing -- the newline will be output below    
-           } else {
-                printf("%s with signature %s not implemented\n",
-                    methodName, methodDescr);
-                JVM_Pop();
-            }
-            if (strcmp(methodName,"println") == 0)
-                putchar('\n');
-        } else {
-            fprintf(stderr, "Method %s.%s with signature %s is unsupported\n",
-                className, methodName, methodDescr);
-            exit(1);
-        }
-        JVM_Pop();  /* there was an object ref on the stack */
-        return;
-    }
-    if (strcmp(className, "java/lang/String") == 0) {
-        if (strcmp(methodName,"charAt") == 0) {
-            if (strcmp(methodDescr,"(I)C") == 0) {
-                int ix = JVM_Pop();
-                HeapPointer hp = JVM_Pop();
-                if (hp == NULL_HEAP_REFERENCE)
-                    throwExceptionExternal("NullPointerException", methodName, className);
-                StringInstance *sp = REAL_HEAP_POINTER(hp);
-                char *s = sp->sval;
-                if (ix < 0 || ix >= strlen(s))
-                    throwExceptionExternal("StringIndexOutOfBoundsException",
-                        methodName, className);
-                JVM_Push(s[ix]);
-                return;
-            }
-        }
-        if (strcmp(methodName,"length") == 0) {
-            if (strcmp(methodDescr,"()I") == 0) {
-                HeapPointer hp = JVM_Pop();
-                if (hp == NULL_HEAP_REFERENCE)
-                    throwExceptionExternal("NullPointerException", methodName, className);
-                StringInstance *sp = REAL_HEAP_POINTER(hp);
-                JVM_Push(strlen(sp->sval));
-                return;
-            }
-        }
-    }
-    if (strcmp(className,"java/lang/Object") == 0) {
-        if (strcmp(methodName,"<init>") == 0) {
-            // no initialization to perform!
-            JVM_Pop();  /* there was an object ref on the stack */
-            return;
-        }
-        fprintf(stderr, "Method %s.%s with signature %s is unsupported\n",
-            className, methodName, methodDescr);
-        exit(1);
+/* The registry of native methods, a hash table with chaining */
+typedef struct NativeEntry {
+    char *className;
+    char *methodName;
+    char *methodDescr;
+    NativeMethod fn;
+    MethodProfile *profile;     /* see MethodProfile.c, NULL => not called */
+    struct NativeEntry *next;
+} NativeEntry;
+
+#define NATIVE_TABLE_SIZE  128      /* must be a power of 2 */
+static NativeEntry *nativeTable[NATIVE_TABLE_SIZE];
+
+
+static unsigned int hashNative( char *className, char *methodName,
+        char *methodDescr ) {
+    unsigned int h = 0;
+    char *s;
+    for( s = className;  *s;  s++ )   h = h*31 + *s;
+    for( s = methodName;  *s;  s++ )  h = h*31 + *s;
+    for( s = methodDescr;  *s;  s++ ) h = h*31 + *s;
+    return h & (NATIVE_TABLE_SIZE-1);
+}
+
+
+void RegisterNative( char *className, char *methodName, char *methodDescr,
+        NativeMethod fn ) {
+    unsigned int h = hashNative(className, methodName, methodDescr);
+    NativeEntry *e = SafeMalloc(sizeof(NativeEntry));
+    e->className = className;
+    e->methodName = methodName;
+    e->methodDescr = methodDescr;
+    e->fn = fn;
+    e->next = nativeTable[h];
+    nativeTable[h] = e;
+}
+
+
+/* Returns the C function which implements the method, or NULL */
+NativeMethod FindNative( char *className, char *methodName, char *methodDescr ) {
+    NativeEntry *e = nativeTable[hashNative(className, methodName, methodDescr)];
+    for( ;  e != NULL;  e = e->next ) {
+        if (strcmp(e->methodName, methodName) == 0
+                && strcmp(e->methodDescr, methodDescr) == 0
+                && strcmp(e->className, className) == 0)
+            return e->fn;
     }
-    if (strcmp(className, StringBuilderName) == 0) {
-        StringBuilderClass(methodName, methodDescr);
-        return;
+    return NULL;
+}
+
+
+/* Returns the profile of the native method (see MethodProfile.c) */
+MethodProfile *NativeProfile( char *className, char *methodName, char *methodDescr ) {
+    NativeEntry *e = nativeTable[hashNative(className, methodName, methodDescr)];
+    for( ;  e != NULL;  e = e->next ) {
+        if (strcmp(e->methodName, methodName) == 0
+                && strcmp(e->methodDescr, methodDescr) == 0
+                && strcmp(e->className, className) == 0)
+            break;
     }
-    fprintf(stderr, "Class %s is missing or unsupported (invoked method = %s)\n",
-        className, methodName);
-    exit(1);
+    assert(e != NULL);
+    if (e->profile == NULL)
+        e->profile = NewMethodProfile(e->className, e->methodName,
+            e->methodDescr, 1);
+    return e->profile;
 }
 
 
-void MissingClassStaticMethod( char *className, char *methodName, char *methodDescr ) {
-    union { int64_t lval;  double dval;  int32_t ival[2];  uint32_t uval[2]; } pair;
+/* The output buffer behind System.out */
+#define OUT_BUFFER_SIZE  65536
+static char outBuffer[OUT_BUFFER_SIZE];
+static int outLength = 0;
+static int outLineMode = 0;
+
 
-    if (strcmp(className,"java/lang/System") == 0) {
-        if (strcmp(methodName,"gc") == 0) {
-            if (strcmp(methodDescr,"()V") == 0) {
-                gc();
-                return;
-            }
-        } else {
-            fprintf(stderr, "Static method %s.%s with signature %s is unsupported\n",
-                className, methodName, methodDescr);
-            exit(1);
+/* Writes all the output collected for System.out.  Anything which
+   stdio has buffered for stdout, such as trace output, goes first. */
+void FlushSystemOut() {
+    char *s = outBuffer;
+    int len = outLength;
+
+    if (len == 0)
+        return;
+    fflush(stdout);
+    outLength = 0;
+    while(len > 0) {
+        ssize_t n = write(1, s, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return;     /* output is lost, as with a closed pipe */
         }
+        s += n;
+        len -= n;
     }
-    if (strcmp(className,"java/lang/Integer") == 0) {
-        if (strcmp(methodName,"parseInt") == 0) {
-            if (strcmp(methodDescr,"(Ljava/lang/String;)I") == 0) {
-                int ival = 0;
-                HeapPointer hp = JVM_Pop();
-                if (hp == NULL_HEAP_REFERENCE)
-                    throwExceptionExternal("NullPointerException", methodName, className);
-                StringInstance *arg = REAL_HEAP_POINTER(hp);
-                if (sscanf(arg->sval, "%d", &ival) < 1)
-                    throwExceptionExternal( "NumberFormatException", methodName, className );
-                JVM_Push( (uint32_t)ival );
-                return;
-            }
+}
+
+
+void SetSystemOutLineMode( int lineMode ) {
+    outLineMode = lineMode;
+}
+
+
+/* Returns space in the buffer for at least len more chars */
+static char *outSpace( int len ) {
+    if (outLength + len > OUT_BUFFER_SIZE)
+        FlushSystemOut();
+    return outBuffer + outLength;
+}
+
+
+static void outWrite( char *s, int len ) {
+    while(len > 0) {
+        int n = OUT_BUFFER_SIZE - outLength;
+        if (n == 0) {
+            FlushSystemOut();
+            n = OUT_BUFFER_SIZE;
         }
+        if (n > len)
+            n = len;
+        memcpy(outBuffer + outLength, s, n);
+        outLength += n;
+        s += n;
+        len -= n;
     }
-    if (strcmp(className,"java/lang/Double") == 0) {
-        if (strcmp(methodName,"parseDouble") == 0) {
-            if (strcmp(methodDescr,"(Ljava/lang/String;)D") == 0) {
-                HeapPointer hp = JVM_Pop();
-                if (hp == NULL_HEAP_REFERENCE)
-                    throwExceptionExternal("NullPointerException", methodName, className);
-                StringInstance *arg = REAL_HEAP_POINTER(hp);
-                if (sscanf(arg->sval, "%lg", &pair.dval) < 1)
-                    throwExceptionExternal( "NumberFormatException", methodName, className );
-                JVM_Push(pair.uval[0]);
-                JVM_Push(pair.uval[1]);
-                return;
-            }
-        }
+}
+
+
+static void outNewline() {
+    *outSpace(1) = '\n';
+    outLength++;
+    if (outLineMode)
+        FlushSystemOut();
+}
+
+
+/* Pops a string reference, checking for null */
+static StringInstance *popString( char *methodName, char *className ) {
+    HeapPointer hp = JVM_Pop();
+    if (hp == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", methodName, className);
+    return REAL_HEAP_POINTER(hp);
+}
+
+
+/* java/io/PrintStream; the PrintStream reference is below the argument */
+
+static void printString() {
+    StringInstance *sp = popString("print", "java/io/PrintStream");
+    outWrite(sp->chars, sp->length);
+    if (outLineMode && memchr(sp->chars, '\n', sp->length) != NULL)
+        FlushSystemOut();
+    JVM_Pop();
+}
+
+/* numbers are formatted straight into the output buffer, as Java's
+   toString methods would format them */
+
+static void printInt() {
+    int32_t ival = JVM_Pop();
+    outLength += FormatInt(outSpace(NUMBER_BUFFER_SIZE), ival);
+    JVM_Pop();
+}
+
+static void printLong() {
+    union { struct { uint32_t v0; uint32_t v1; } ss; int64_t l; } pair;
+    pair.ss.v1 = JVM_Pop();
+    pair.ss.v0 = JVM_Pop();
+    outLength += FormatLong(outSpace(NUMBER_BUFFER_SIZE), pair.l);
+    JVM_Pop();
+}
+
+static void printFloat() {
+    float fval = JVM_PopFloat();
+    outLength += FormatFloat(outSpace(NUMBER_BUFFER_SIZE), fval);
+    JVM_Pop();
+}
+
+static void printDouble() {
+    union { struct { uint32_t v0; uint32_t v1; } ss; double d; } pair;
+    pair.ss.v1 = JVM_Pop();
+    pair.ss.v0 = JVM_Pop();
+    outLength += FormatDouble(outSpace(NUMBER_BUFFER_SIZE), pair.d);
+    JVM_Pop();
+}
+
+static void printChar() {
+    char c = (char)JVM_Pop();
+    if (c == '\n') {
+        outNewline();
+    } else {
+        *outSpace(1) = c;
+        outLength++;
     }
-    if (strcmp(className,"java/lang/Float") == 0) {
-        if (strcmp(methodName,"parseFloat") == 0) {
-            if (strcmp(methodDescr,"(Ljava/lang/String;)F") == 0) {
-                float fval = 0.0;
-                HeapPointer hp = JVM_Pop();
-                if (hp == NULL_HEAP_REFERENCE)
-                    throwExceptionExternal("NullPointerException", methodName, className);
-                StringInstance *arg = REAL_HEAP_POINTER(hp);
-                if (sscanf(arg->sval, "%f", &fval) < 1)
-                    throwExceptionExternal( "NumberFormatException", methodName, className );
-                JVM_PushFloat(fval);
-                return;
-            }
-        }
+    JVM_Pop();
+}
+
+static void printBoolean() {
+    if (JVM_Pop())
+        outWrite("true", 4);
+    else
+        outWrite("false", 5);
+    JVM_Pop();
+}
+
+static void printlnString()  { printString();   outNewline(); }
+static void printlnInt()     { printInt();      outNewline(); }
+static void printlnLong()    { printLong();     outNewline(); }
+static void printlnFloat()   { printFloat();    outNewline(); }
+static void printlnDouble()  { printDouble();   outNewline(); }
+static void printlnChar()    { printChar();     outNewline(); }
+static void printlnBoolean() { printBoolean();  outNewline(); }
+
+static void println() {
+    JVM_Pop();
+    outNewline();
+}
+
+
+/* java/lang/String */
+
+static void stringCharAt() {
+    int ix = JVM_Pop();
+    StringInstance *sp = popString("charAt", "java/lang/String");
+    if (ix < 0 || ix >= sp->length)
+        throwExceptionExternal("StringIndexOutOfBoundsException",
+            "charAt", "java/lang/String");
+    JVM_Push((uint8_t)sp->chars[ix]);
+}
+
+static void stringLength() {
+    JVM_Push(popString("length", "java/lang/String")->length);
+}
+
+/* the hash code is computed on the first call and kept in the string */
+static void stringHashCode() {
+    StringInstance *sp = popString("hashCode", "java/lang/String");
+    if (sp->hash == 0) {
+        uint32_t h = 0;
+        int i;
+        for( i = 0;  i < sp->length;  i++ )
+            h = 31*h + (uint8_t)sp->chars[i];
+        sp->hash = h;
     }
-    fprintf(stderr, "Static method %s.%s with signature %s is missing or unsupported\n",
+    JVM_Push(sp->hash);
+}
+
+
+/* java/lang/Object */
+
+static void objectInit() {
+    // no initialization to perform!
+    JVM_Pop();  /* there was an object ref on the stack */
+}
+
+
+/* static methods of java/lang/System, Integer, Double and Float */
+
+static void systemGc() {
+    FlushSystemOut();
+    gc();
+}
+
+static void integerParseInt() {
+    int ival = 0;
+    char *s = popString("parseInt", "java/lang/Integer")->chars;
+    if (sscanf(s, "%d", &ival) < 1)
+        throwExceptionExternal("NumberFormatException", "parseInt",
+            "java/lang/Integer");
+    JVM_Push( (uint32_t)ival );
+}
+
+static void doubleParseDouble() {
+    union { int64_t lval;  double dval;  int32_t ival[2];  uint32_t uval[2]; } pair;
+    char *s = popString("parseDouble", "java/lang/Double")->chars;
+    if (sscanf(s, "%lg", &pair.dval) < 1)
+        throwExceptionExternal("NumberFormatException", "parseDouble",
+            "java/lang/Double");
+    JVM_Push(pair.uval[0]);
+    JVM_Push(pair.uval[1]);
+}
+
+static void floatParseFloat() {
+    float fval = 0.0;
+    char *s = popString("parseFloat", "java/lang/Float")->chars;
+    if (sscanf(s, "%f", &fval) < 1)
+        throwExceptionExternal("NumberFormatException", "parseFloat",
+            "java/lang/Float");
+    JVM_PushFloat(fval);
+}
+
+
+/* Registers all the native methods */
+void InitNativeClasses() {
+    char *ps = "java/io/PrintStream";
+
+    atexit(FlushSystemOut);
+
+    RegisterNative(ps, "print", "(Ljava/lang/String;)V", printString);
+    RegisterNative(ps, "print", "(I)V", printInt);
+    RegisterNative(ps, "print", "(J)V", printLong);
+    RegisterNative(ps, "print", "(F)V", printFloat);
+    RegisterNative(ps, "print", "(D)V", printDouble);
+    RegisterNative(ps, "print", "(C)V", printChar);
+    RegisterNative(ps, "print", "(Z)V", printBoolean);
+    RegisterNative(ps, "println", "(Ljava/lang/String;)V", printlnString);
+    RegisterNative(ps, "println", "(I)V", printlnInt);
+    RegisterNative(ps, "println", "(J)V", printlnLong);
+    RegisterNative(ps, "println", "(F)V", printlnFloat);
+    RegisterNative(ps, "println", "(D)V", printlnDouble);
+    RegisterNative(ps, "println", "(C)V", printlnChar);
+    RegisterNative(ps, "println", "(Z)V", printlnBoolean);
+    RegisterNative(ps, "println", "()V", println);
+
+    RegisterNative("java/lang/String", "charAt", "(I)C", stringCharAt);
+    RegisterNative("java/lang/String", "length", "()I", stringLength);
+    RegisterNative("java/lang/String", "hashCode", "()I", stringHashCode);
+    RegisterNative("java/lang/Object", "<init>", "()V", objectInit);
+
+    RegisterNative("java/lang/System", "gc", "()V", systemGc);
+    RegisterNative("java/lang/Integer", "parseInt",
+        "(Ljava/lang/String;)I", integerParseInt);
+    RegisterNative("java/lang/Double", "parseDouble",
+        "(Ljava/lang/String;)D", doubleParseDouble);
+    RegisterNative("java/lang/Float", "parseFloat",
+        "(Ljava/lang/String;)F", floatParseFloat);
+
+    RegisterStringBuilderNatives();
+    RegisterExceptionNatives();
+    RegisterArrayNatives();
+}
+
+
+/* Called when an instance method of a missing class is invoked and
+   no native method has been registered for it */
+void MissingClassVirtualMethod( char *className, char *methodName, char *methodDescr ) {
+    fprintf(stderr, "Method %s.%s with signature %s is missing or unsupported\n",
         className, methodName, methodDescr);
     exit(1);
 }
 
+
+/* Called when a static method of a missing class is invoked and
+   no native method has been registered for it */
+void MissingClassStaticMethod( char *className, char *methodName, char *methodDescr ) {
+    fprintf(stderr, "Static method %s.%s with signature %s is missing or unsupported\n",
+        className, methodName, methodDescr);
+    exit(1);
+}
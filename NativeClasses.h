@@ -4,6 +4,17 @@
 
 #define NATIVECLASSESH
 
+#include "jvm.h"  /* to define NativeMethod type */
+#include "MethodProfile.h"
+
+extern void InitNativeClasses();
+extern void RegisterNative( char *className, char *methodName, char *methodDescr,
+        NativeMethod fn );
+extern NativeMethod FindNative( char *className, char *methodName, char *methodDescr );
+extern MethodProfile *NativeProfile( char *className, char *methodName,
+        char *methodDescr );
+extern void FlushSystemOut();
+extern void SetSystemOutLineMode( int lineMode );
 extern void MissingClassVirtualMethod( char *className, char *methodName, char *methodDescr );
 extern void MissingClassStaticMethod( char *className, char *methodName, char *methodDescr );
 
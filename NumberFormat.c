@@ -0,0 +1,383 @@
+/* NumberFormat.c */
+
+/*
+   Conversion of numbers to decimal text, as done by the toString methods
+   of Java's Integer, Long, Float and Double classes, without using the
+   C library's printf family.  The text is written directly into a buffer
+   supplied by the caller, such as the char array of a StringBuilder.
+
+   A float or double is printed with the fewest digits which identify it
+   uniquely, i.e. the shortest decimal string which reads back as the
+   same value.  The digits are generated by the free-format algorithm of
+   Burger and Dybvig ("Printing Floating-Point Numbers Quickly and
+   Accurately", PLDI 1996), using exact integer arithmetic on fixed-size
+   big numbers, so the result is always correct.  As Java requires, when
+   one digit would be enough, the two-digit decimal nearest to the value
+   is used instead (so Double.MIN_VALUE is 4.9E-324, not 5.0E-324).
+   Integral values below 10^7, the most common case, take a fast path.
+
+   As in Java, a value v with 10^-3 <= |v| < 10^7 is printed as an
+   integer part, a point and at least one fractional digit ("100.0",
+   "0.001"); any other value is printed in scientific notation with one
+   digit before the point ("1.0E7", "1.25E-5").
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "NumberFormat.h"
+
+
+/* Big unsigned integers, least significant word first.  The largest
+   values needed, for the smallest subnormal doubles, have about 1140
+   bits. */
+#define BIG_WORDS  40
+
+typedef struct {
+    int len;                    /* number of words in use */
+    uint32_t w[BIG_WORDS];
+} BigNum;
+
+static void bigSet( BigNum *b, uint64_t v ) {
+    b->w[0] = (uint32_t)v;
+    b->w[1] = (uint32_t)(v >> 32);
+    b->len = (b->w[1] != 0)? 2 : (b->w[0] != 0)? 1 : 0;
+}
+
+static void bigMulSmall( BigNum *b, uint32_t m ) {
+    uint64_t carry = 0;
+    int i;
+    for( i = 0;  i < b->len;  i++ ) {
+        uint64_t t = (uint64_t)b->w[i] * m + carry;
+        b->w[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    if (carry != 0)
+        b->w[b->len++] = (uint32_t)carry;
+}
+
+static void bigMulPow10( BigNum *b, int k ) {
+    static const uint32_t pow10[] = { 1, 10, 100, 1000, 10000, 100000,
+        1000000, 10000000, 100000000, 1000000000 };
+    for( ;  k >= 9;  k -= 9 )
+        bigMulSmall(b, pow10[9]);
+    if (k > 0)
+        bigMulSmall(b, pow10[k]);
+}
+
+static void bigShiftLeft( BigNum *b, int n ) {
+    int words = n / 32, bits = n % 32, i;
+    if (b->len == 0) return;
+    if (bits != 0) {
+        uint32_t carry = 0;
+        for( i = 0;  i < b->len;  i++ ) {
+            uint32_t t = b->w[i];
+            b->w[i] = (t << bits) | carry;
+            carry = t >> (32 - bits);
+        }
+        if (carry != 0)
+            b->w[b->len++] = carry;
+    }
+    if (words > 0) {
+        for( i = b->len - 1;  i >= 0;  i-- )
+            b->w[i + words] = b->w[i];
+        for( i = 0;  i < words;  i++ )
+            b->w[i] = 0;
+        b->len += words;
+    }
+}
+
+static int bigCompare( BigNum *a, BigNum *b ) {
+    int i;
+    if (a->len != b->len)
+        return (a->len < b->len)? -1 : 1;
+    for( i = a->len - 1;  i >= 0;  i-- )
+        if (a->w[i] != b->w[i])
+            return (a->w[i] < b->w[i])? -1 : 1;
+    return 0;
+}
+
+/* compares a+b with c */
+static int bigAddCompare( BigNum *a, BigNum *b, BigNum *c ) {
+    BigNum sum;
+    uint64_t carry = 0;
+    int i, n = (a->len > b->len)? a->len : b->len;
+    for( i = 0;  i < n;  i++ ) {
+        uint64_t t = carry;
+        if (i < a->len) t += a->w[i];
+        if (i < b->len) t += b->w[i];
+        sum.w[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    if (carry != 0)
+        sum.w[n++] = (uint32_t)carry;
+    sum.len = n;
+    return bigCompare(&sum, c);
+}
+
+/* a -= b, where a >= b */
+static void bigSubtract( BigNum *a, BigNum *b ) {
+    int64_t borrow = 0;
+    int i;
+    for( i = 0;  i < a->len;  i++ ) {
+        int64_t t = (int64_t)a->w[i] - borrow - (i < b->len? b->w[i] : 0);
+        borrow = (t < 0);
+        a->w[i] = (uint32_t)t;
+    }
+    while(a->len > 0 && a->w[a->len-1] == 0)
+        a->len--;
+}
+
+
+/* Generates the two digits nearest to r/s (which is less than 1), with
+   ties broken towards an even digit; see shortestDigits */
+static int nearestTwoDigits( BigNum *r, BigNum *s, char *digits, int *kp ) {
+    int d[2], i, cmp;
+
+    for( i = 0;  i < 2;  i++ ) {
+        d[i] = 0;
+        bigMulSmall(r, 10);
+        while(bigCompare(r, s) >= 0) {
+            bigSubtract(r, s);
+            d[i]++;
+        }
+    }
+    bigShiftLeft(r, 1);
+    cmp = bigCompare(r, s);
+    if (cmp > 0 || (cmp == 0 && (d[1] & 1))) {
+        if (++d[1] == 10) {
+            d[1] = 0;
+            if (++d[0] == 10) {
+                d[0] = 1;
+                (*kp)++;
+            }
+        }
+    }
+    digits[0] = '0' + d[0];
+    digits[1] = '0' + d[1];
+    return (d[1] == 0)? 1 : 2;
+}
+
+
+/* Generates the shortest digits of the positive value f*2^e, where f
+   has at most p significant bits and minE is the smallest exponent of
+   the format.  The value is 0.d1d2...dn * 10^k; the digits are stored as
+   characters in digits, and n is returned.  If the shortest digits are
+   a single digit, the nearest two digits are generated instead. */
+static int shortestDigits( uint64_t f, int e, int p, int minE,
+        char *digits, int *kp ) {
+    BigNum r, s, mPlus, mMinus, r0;
+    int even = (f & 1) == 0;        /* the boundaries round to v itself */
+    int unequalGaps = (f == (uint64_t)1 << (p-1)) && e > minE;
+    int k, n = 0;
+
+    /* v = r/s, and the halfway points to its neighbours are
+       v - mMinus/s and v + mPlus/s */
+    bigSet(&r, f);
+    if (e >= 0) {
+        bigShiftLeft(&r, e + (unequalGaps? 2 : 1));
+        bigSet(&s, unequalGaps? 4 : 2);
+        bigSet(&mPlus, 1);
+        bigShiftLeft(&mPlus, e + (unequalGaps? 1 : 0));
+        bigSet(&mMinus, 1);
+        bigShiftLeft(&mMinus, e);
+    } else {
+        bigShiftLeft(&r, unequalGaps? 2 : 1);
+        bigSet(&s, 1);
+        bigShiftLeft(&s, -e + (unequalGaps? 2 : 1));
+        bigSet(&mPlus, unequalGaps? 2 : 1);
+        bigSet(&mMinus, 1);
+    }
+
+    /* scale by an estimate of the decimal exponent, which may be one
+       too small, then correct it */
+    k = (int)ceil(log10(ldexp((double)f, e)) - 1e-10);
+    if (k >= 0)
+        bigMulPow10(&s, k);
+    else {
+        bigMulPow10(&r, -k);
+        bigMulPow10(&mPlus, -k);
+        bigMulPow10(&mMinus, -k);
+    }
+    if (even? bigAddCompare(&r, &mPlus, &s) >= 0
+             : bigAddCompare(&r, &mPlus, &s) > 0) {
+        bigMulSmall(&s, 10);
+        k++;
+    }
+    r0 = r;
+
+    for( ; ; ) {
+        int d = 0, low, high;
+        bigMulSmall(&r, 10);
+        bigMulSmall(&mPlus, 10);
+        bigMulSmall(&mMinus, 10);
+        while(bigCompare(&r, &s) >= 0) {
+            bigSubtract(&r, &s);
+            d++;
+        }
+        low = even? bigCompare(&r, &mMinus) <= 0 : bigCompare(&r, &mMinus) < 0;
+        high = even? bigAddCompare(&r, &mPlus, &s) >= 0
+                   : bigAddCompare(&r, &mPlus, &s) > 0;
+        if (!low && !high) {
+            digits[n++] = '0' + d;
+            continue;
+        }
+        if (low && high) {
+            /* both neighbours are near enough, so round r/s */
+            BigNum twice = r;
+            int cmp;
+            bigShiftLeft(&twice, 1);
+            cmp = bigCompare(&twice, &s);
+            if (cmp > 0 || (cmp == 0 && (d & 1)))
+                d++;
+        } else if (high)
+            d++;
+        digits[n++] = '0' + d;
+        break;
+    }
+    if (n == 1)
+        n = nearestTwoDigits(&r0, &s, digits, &k);
+    *kp = k;
+    return n;
+}
+
+
+/* Writes the n digits with decimal exponent k (see shortestDigits) in
+   Java's format, at buf */
+static int layoutDigits( char *buf, char *digits, int n, int k ) {
+    char *p = buf;
+    int i;
+
+    if (k >= -2 && k <= 7) {            /* 10^-3 <= v < 10^7 */
+        if (k <= 0) {
+            *p++ = '0';  *p++ = '.';
+            for( i = 0;  i < -k;  i++ )
+                *p++ = '0';
+            memcpy(p, digits, n);  p += n;
+        } else if (n <= k) {
+            memcpy(p, digits, n);  p += n;
+            for( i = n;  i < k;  i++ )
+                *p++ = '0';
+            *p++ = '.';  *p++ = '0';
+        } else {
+            memcpy(p, digits, k);  p += k;
+            *p++ = '.';
+            memcpy(p, digits+k, n-k);  p += n-k;
+        }
+    } else {
+        *p++ = digits[0];
+        *p++ = '.';
+        if (n == 1)
+            *p++ = '0';
+        else {
+            memcpy(p, digits+1, n-1);  p += n-1;
+        }
+        *p++ = 'E';
+        p += FormatInt(p, k-1);
+    }
+    *p = 0;
+    return p - buf;
+}
+
+
+/* Formats the value of a float or double, given its sign, significand
+   f and exponent e (the value is f*2^e), and the parameters of its
+   format */
+static int formatBinary( char *buf, int negative, uint64_t f, int e,
+        int p, int minE ) {
+    char digits[24];
+    int n, k, len = 0;
+
+    if (negative)
+        buf[len++] = '-';
+    if (f == 0) {
+        strcpy(buf+len, "0.0");
+        return len + 3;
+    }
+    /* an integral value below 10^7 is printed exactly */
+    if (e >= -(p-1) && e <= 0 && (f & (((uint64_t)1 << -e) - 1)) == 0
+            && (f >> -e) < 10000000) {
+        len += FormatLong(buf+len, (int64_t)(f >> -e));
+        strcpy(buf+len, ".0");
+        return len + 2;
+    }
+    n = shortestDigits(f, e, p, minE, digits, &k);
+    return len + layoutDigits(buf+len, digits, n, k);
+}
+
+
+int FormatDouble( char *buf, double v ) {
+    union { double d;  uint64_t bits; } u;
+    uint64_t mantissa;
+    int exponent;
+
+    u.d = v;
+    mantissa = u.bits & (((uint64_t)1 << 52) - 1);
+    exponent = (int)((u.bits >> 52) & 0x7ff);
+    if (exponent == 0x7ff) {
+        strcpy(buf, mantissa != 0? "NaN" : (u.bits >> 63)? "-Infinity" : "Infinity");
+        return strlen(buf);
+    }
+    if (exponent == 0)                  /* subnormal */
+        return formatBinary(buf, u.bits >> 63, mantissa, -1074, 53, -1074);
+    return formatBinary(buf, u.bits >> 63, mantissa | ((uint64_t)1 << 52),
+        exponent - 1075, 53, -1074);
+}
+
+
+int FormatFloat( char *buf, float v ) {
+    union { float f;  uint32_t bits; } u;
+    uint32_t mantissa;
+    int exponent;
+
+    u.f = v;
+    mantissa = u.bits & ((1u << 23) - 1);
+    exponent = (int)((u.bits >> 23) & 0xff);
+    if (exponent == 0xff) {
+        strcpy(buf, mantissa != 0? "NaN" : (u.bits >> 31)? "-Infinity" : "Infinity");
+        return strlen(buf);
+    }
+    if (exponent == 0)                  /* subnormal */
+        return formatBinary(buf, u.bits >> 31, mantissa, -149, 24, -149);
+    return formatBinary(buf, u.bits >> 31, mantissa | (1u << 23),
+        exponent - 150, 24, -149);
+}
+
+
+int FormatLong( char *buf, int64_t v ) {
+    char temp[20];
+    uint64_t u = (v < 0)? -(uint64_t)v : (uint64_t)v;
+    int n = 0, len = 0;
+
+    do {
+        temp[n++] = '0' + (int)(u % 10);
+        u /= 10;
+    } while(u != 0);
+    if (v < 0)
+        buf[len++] = '-';
+    while(n > 0)
+        buf[len++] = temp[--n];
+    buf[len] = 0;
+    return len;
+}
+
+
+int FormatInt( char *buf, int32_t v ) {
+    char temp[10];
+    uint32_t u = (v < 0)? -(uint32_t)v : (uint32_t)v;
+    int n = 0, len = 0;
+
+    do {
+        temp[n++] = '0' + u % 10;
+        u /= 10;
+    } while(u != 0);
+    if (v < 0)
+        buf[len++] = '-';
+    while(n > 0)
+        buf[len++] = temp[--n];
+    buf[len] = 0;
+    return len;
+}
@@ -0,0 +1,20 @@
+/* NumberFormat.h */
+
+#ifndef NUMBERFORMATH
+
+#define NUMBERFORMATH
+
+#include <stdint.h>
+
+/* enough space for any number formatted below, plus a 0 byte */
+#define NUMBER_BUFFER_SIZE  32
+
+/* Each function writes the characters of the number into buf, followed
+   by a 0 byte, and returns the number of characters (excluding the 0).
+   The text is the same as for Java's toString methods. */
+extern int FormatInt( char *buf, int32_t v );
+extern int FormatLong( char *buf, int64_t v );
+extern int FormatFloat( char *buf, float v );
+extern int FormatDouble( char *buf, double v );
+
+#endif
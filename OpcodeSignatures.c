@@ -52,6 +52,8 @@
 */
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 #include "OpcodeSignatures.h"
 
 OpcodeDescription opcodes[] = {
@@ -187,7 +189,7 @@ OpcodeDescription opcodes[] = {
 { 0X81, "lor",          "", "LlLl>Ll" }, /* bitwise or of two longs */
 { 0X82, "ixor",         "", "II>I" },   /* int xor */
 { 0X83, "lxor",         "", "LlLl>Ll" }, /* bitwise exclusive or of two longs */
-{ 0X84, "iinc",         "iiv", "" },    /* increment local variable #index by signed byte const */
+{ 0X84, "iinc",         "iv",  "" },    /* increment local variable #index by signed byte const */
 { 0X85, "i2l",          "", "I>Ll" },   /* convert an int into a long */
 { 0X86, "i2f",          "", "I>Dd" },   /* convert an int into a float */
 { 0X87, "i2d",          "", "Ll>I" },   /* convert an int into a double */
@@ -279,3 +281,32 @@ void CheckOpcodeTable() {
         assert(i == opcodes[i].op);
     }
 }
+
+
+/* Returns the total number of bytes occupied by the instruction which
+   starts at offset pc in the code array, including the opcode itself.
+   The ops with a variable number of operand bytes (tableswitch,
+   lookupswitch and wide) are decoded to find their true length.
+*/
+int InstructionLength( uint8_t *code, int pc ) {
+    uint8_t *p;
+    int32_t low, high, npairs;
+
+    switch(code[pc]) {
+    case 0Xaa:  /* tableswitch */
+        p = code + ((pc + 4) & ~3);  /* skip the padding bytes */
+        low  = (p[4]<<24) | (p[5]<<16) | (p[6]<<8) | p[7];
+        high = (p[8]<<24) | (p[9]<<16) | (p[10]<<8) | p[11];
+        return (p - code) - pc + 12 + 4*(high - low + 1);
+    case 0Xab:  /* lookupswitch */
+        p = code + ((pc + 4) & ~3);
+        npairs = (p[4]<<24) | (p[5]<<16) | (p[6]<<8) | p[7];
+        return (p - code) - pc + 8 + 8*npairs;
+    case 0Xc4:  /* wide */
+        return (code[pc+1] == 0X84)? 6 : 4;
+    default:
+        if (code[pc] > LASTOPCODE)
+            return 1;
+        return strlen(opcodes[code[pc]].inlineOperands) + 1;
+    }
+}
@@ -4,6 +4,8 @@
 #ifndef OPCODESIGSH
 #define OPCODESIGSH
 
+#include <stdint.h>
+
 typedef struct {
         int     op;
         char    *opcodeName;
@@ -17,5 +19,6 @@ typedef struct {
 extern OpcodeDescription opcodes[];
 
 extern void CheckOpcodeTable(void);
+extern int InstructionLength( uint8_t *code, int pc );
 
 #endif
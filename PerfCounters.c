@@ -0,0 +1,191 @@
+/* PerfCounters.c */
+
+/*
+   Hardware performance counters (the -C option).
+
+   The counters of cycles, instructions, branch misses, L1 data cache
+   misses and last level cache misses are opened with perf_event_open
+   as one group, counting in user mode for this process only, so that
+   a single read returns them all.  A counter which cannot be opened
+   is left out; when none can be, as in many containers and virtual
+   machines, a warning is given and the program runs as usual.
+
+   The counts are divided among the phases of the JVM: reading class
+   files, verifying them, executing <clinit> methods and executing the
+   program.  PerfEnterPhase reads the counters and charges the counts
+   since the last change of phase to the phase being left.  When an
+   exception thrown out of a <clinit> is caught, the phase in which the
+   handler runs is restored (see resumeAtHandler in Exceptions.c).
+   With -Cm, the counts are also kept per method, by the method profile
+   (see MethodProfile.c), around each call.  A read is a system call,
+   so this slows calls down considerably.
+
+   When the kernel multiplexes the group with other events, the counts
+   are scaled by the fraction of the time for which it was counting.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "TraceOptions.h"
+#include "PerfCounters.h"
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static struct {
+    uint32_t type;
+    uint64_t config;
+    char *name;
+} counterKinds[PERF_MAX_COUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses" },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), "L1d-misses" },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL), "LLC-misses" },
+};
+
+int perfPerMethod = 0;
+
+static int groupFd = -1;
+static int numOpen = 0;
+static int counterKind[PERF_MAX_COUNTERS];   /* the kind of each open counter */
+static int currentPhase = PHASE_OTHER;
+static uint64_t phaseStart[PERF_MAX_COUNTERS];
+static uint64_t phaseCounts[PHASE_COUNT][PERF_MAX_COUNTERS];
+static char *phaseNames[PHASE_COUNT] = {
+    "other", "class reading", "verification", "<clinit>", "execution"
+};
+
+
+static int openCounter( int kind, int group ) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counterKinds[kind].type;
+    attr.config = counterKinds[kind].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+
+void InitPerfCounters( int perMethod ) {
+    int kind, fd, err = 0;
+
+    for( kind = 0;  kind < PERF_MAX_COUNTERS;  kind++ ) {
+        fd = openCounter(kind, groupFd);
+        if (fd < 0) {
+            if (err == 0) err = errno;
+            continue;
+        }
+        if (groupFd < 0)
+            groupFd = fd;
+        counterKind[numOpen++] = kind;
+    }
+    if (numOpen == 0) {
+        if (showWarnings)
+            fprintf(stderr, "warning: hardware performance counters are "
+                "unavailable (%s)\n", strerror(err));
+        return;
+    }
+    perfPerMethod = perMethod;
+    PerfReadCounters(phaseStart);
+}
+
+
+/* Returns the number of counters which are open */
+int PerfCountersOpen() {
+    return numOpen;
+}
+
+/* Returns the name of the i-th open counter */
+char *PerfCounterName( int i ) {
+    return counterKinds[counterKind[i]].name;
+}
+
+
+/* Sets values[0..PerfCountersOpen()-1] to the current counts */
+void PerfReadCounters( uint64_t *values ) {
+    uint64_t buf[3 + PERF_MAX_COUNTERS];
+    int i;
+
+    if (read(groupFd, buf, sizeof(buf)) < (ssize_t)(3 + numOpen) * sizeof(uint64_t)) {
+        memset(values, 0, numOpen * sizeof(uint64_t));
+        return;
+    }
+    /* buf holds nr, time enabled, time running, then the counts */
+    for( i = 0;  i < numOpen;  i++ ) {
+        values[i] = buf[3+i];
+        if (buf[2] > 0 && buf[2] < buf[1])
+            values[i] = (uint64_t)((double)values[i] * buf[1] / buf[2]);
+    }
+}
+
+
+/* Charges the counts since the last change of phase to the current phase */
+static void chargePhase() {
+    uint64_t now[PERF_MAX_COUNTERS];
+    int i;
+
+    PerfReadCounters(now);
+    for( i = 0;  i < numOpen;  i++ ) {
+        phaseCounts[currentPhase][i] += now[i] - phaseStart[i];
+        phaseStart[i] = now[i];
+    }
+}
+
+
+/* Makes phase the current phase; returns the previous one */
+int PerfEnterPhase( int phase ) {
+    int previous = currentPhase;
+
+    if (numOpen > 0 && phase != previous)
+        chargePhase();
+    currentPhase = phase;
+    return previous;
+}
+
+
+int PerfCurrentPhase() {
+    return currentPhase;
+}
+
+
+void PrintPerfCounterStatistics() {
+    uint64_t total;
+    int p, i;
+
+    printf("\nHardware Counter Statistics\n===========================\n\n");
+    if (numOpen == 0) {
+        printf("  The counters are unavailable\n");
+        return;
+    }
+    chargePhase();
+    printf("  %-14s", "phase");
+    for( i = 0;  i < numOpen;  i++ )
+        printf(" %14s", PerfCounterName(i));
+    printf("\n");
+    for( p = 0;  p < PHASE_COUNT;  p++ ) {
+        printf("  %-14s", phaseNames[p]);
+        for( i = 0;  i < numOpen;  i++ )
+            printf(" %14llu", (unsigned long long)phaseCounts[p][i]);
+        printf("\n");
+    }
+    printf("  %-14s", "total");
+    for( i = 0;  i < numOpen;  i++ ) {
+        for( total = 0, p = 0;  p < PHASE_COUNT;  p++ )
+            total += phaseCounts[p][i];
+        printf(" %14llu", (unsigned long long)total);
+    }
+    printf("\n");
+}
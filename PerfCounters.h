@@ -0,0 +1,31 @@
+/* PerfCounters.h */
+
+#ifndef PERFCOUNTERSH
+
+#define PERFCOUNTERSH
+
+#include <stdint.h>
+
+#define PERF_MAX_COUNTERS  5
+
+/* the phases of the JVM for which the counts are kept apart */
+typedef enum {
+    PHASE_OTHER,        /* start-up, pre-decoding, ... */
+    PHASE_READ,         /* reading class files */
+    PHASE_VERIFY,       /* verifying the bytecode */
+    PHASE_CLINIT,       /* executing <clinit> methods */
+    PHASE_EXECUTE,      /* executing the program */
+    PHASE_COUNT
+} JVMPhase;
+
+extern int perfPerMethod;     /* true => the counts are kept per method too */
+
+extern void InitPerfCounters( int perMethod );
+extern int PerfCountersOpen();
+extern char *PerfCounterName( int i );
+extern void PerfReadCounters( uint64_t *values );
+extern int PerfEnterPhase( int phase );
+extern int PerfCurrentPhase();
+extern void PrintPerfCounterStatistics();
+
+#endif
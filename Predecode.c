@@ -0,0 +1,431 @@
+/* Predecode.c */
+
+/*
+   Prepares the bytecode of each method of a class for execution, once
+   the class has been verified.
+
+   The interpreter does not execute the bytecode exactly as found in the
+   class file.  It executes a pre-decoded copy (the quickCode field of
+   the method_info struct) in which some instructions are replaced by
+   internal opcodes (see JVM_QuickOpcode in jvm.h).  Every instruction
+   in the copy occupies the same bytes as in the original, so bytecode
+   offsets are the same in both.
+
+   The pre-decoder recognizes trivial methods whose bytecode has one of
+   these shapes:
+       aload_0; getfield #f; <t>return           -- a getter
+       aload_0; <t>load_1; putfield #f; return   -- a setter
+       aload_0; invokespecial <init>; return     -- an empty constructor
+   where the constructor invoked by an empty constructor must itself be
+   empty or be the constructor of java/lang/Object.
+   A call of a trivial method does not need a frame; the interpreter
+   performs the field access (or nothing) at the call site instead.
+   A call made by invokespecial always reaches the same method, so the
+   instruction is rewritten to one of the OP_xxx_inline opcodes.  The
+   method reached by an invokevirtual depends on the receiver, so that
+   call is only inlined after the inline cache at the call site has
+   matched the receiver's class.
+
+   The operands of tableswitch and lookupswitch, which follow padding
+   that aligns them on a 4-byte boundary, are converted in place to
+   native byte order so that the interpreter can index them as arrays
+   of int32_t.  A tableswitch becomes OP_tableswitch_quick, executed as
+   one bounds check and an indexed jump.  A lookupswitch whose keys are
+   dense enough for a table to fit in the bytes of its match-offset
+   pairs (a range of at most 2*npairs-1 keys) is rewritten as the same
+   table; any other lookupswitch becomes OP_lookupswitch_quick, whose
+   sorted keys are searched by bisection.
+
+   Loops which copy one array into another, element by element, or fill
+   an array with one value are recognized by their bytecode (see
+   ArrayLoop in ArrayOps.h).  The iload at the head of such a loop is
+   replaced by OP_arrayloop_quick, which runs the rest of the loop with
+   the kernels of System.arraycopy and Arrays.fill.
+
+   Array loads and stores which are proven not to throw become quick
+   versions which make no null or bounds check, and those whose array
+   is proven not to be null become versions which only check the index
+   (see BoundsCheck.c).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "ClassResolver.h"
+#include "TraceOptions.h"
+#include "MyAlloc.h"
+#include "OpcodeSignatures.h"
+#include "ArrayOps.h"
+#include "BoundsCheck.h"
+#include "Predecode.h"
+
+long InlinedCalls = 0;          /* # calls elided by inlining */
+static int numTrivialMethods = 0;
+static int numTableSwitches = 0;    /* # switches turned into tables */
+static int numDenseLookups = 0;     /* ... of which were lookupswitch */
+static int numSearchedLookups = 0;  /* # lookupswitches to be bisected */
+static int numArrayLoops = 0;       /* # copy and fill loops found */
+
+
+static int isValueReturn( int op ) {
+    return op == OP_ireturn || op == OP_lreturn || op == OP_freturn
+        || op == OP_dreturn || op == OP_areturn;
+}
+
+
+/* Checks whether the constructor m, whose code invokes the constructor
+   identified by item ix in the constant pool of class ct, is empty. */
+static int isEmptyInit( ClassType *ct, method_info *m, int ix ) {
+    ClassFile *cf = ct->cf;
+    ClassType *ct1;
+    method_info *m1;
+    int classIx, ntIx;
+
+    if (strcmp(GetUTF8(cf, m->name_index), "<init>") != 0
+            || strcmp(GetUTF8(cf, m->descriptor_index), "()V") != 0)
+        return 0;
+    if (cf->cp_tag[ix] != CP_Method)
+        return 0;
+    classIx = cf->cp_item[ix].ss.sval1;
+    ntIx = cf->cp_item[ix].ss.sval2;
+    if (strcmp(GetUTF8(cf, cf->cp_item[ntIx].ss.sval1), "<init>") != 0
+            || strcmp(GetUTF8(cf, cf->cp_item[ntIx].ss.sval2), "()V") != 0)
+        return 0;
+    if (strcmp(GetUTF8(cf, cf->cp_item[classIx].ival), "java/lang/Object") == 0)
+        return 1;
+    /* the superclass has already been loaded and pre-decoded */
+    ct1 = ResolveClassReference(ct, classIx);
+    if (ct1 == NULL || ct1 == ct)
+        return 0;
+    m1 = SearchClassForMethodByName(ct1->cf, "<init>", "()V");
+    return m1 != NULL && m1->inlineKind == INLINE_EMPTY_INIT;
+}
+
+
+/* Determines whether method m of class ct is a trivial method, and
+   if so, fills in the inlineXXX fields of m. */
+static void classifyMethod( ClassType *ct, method_info *m ) {
+    uint8_t *c = m->code;
+    int slot, itsTwoWords, loadTwoWords;
+
+    m->inlineKind = INLINE_NONE;
+    if (m->access_flags & (ACC_STATIC|ACC_SYNCHRONIZED|ACC_NATIVE))
+        return;
+    if (m->exception_table_length > 0 || c[0] != OP_aload_0)
+        return;
+    if (m->code_length == 5 && c[1] == OP_getfield && isValueReturn(c[4])) {
+        slot = GetFieldSlot(ct, (c[2]<<8) + c[3], &itsTwoWords);
+        if (slot < 0) return;
+        m->inlineKind = INLINE_GETTER;
+    } else if (m->code_length == 6 && c[2] == OP_putfield && c[5] == OP_return) {
+        switch(c[1]) {
+        case OP_iload_1:  case OP_fload_1:  case OP_aload_1:
+            loadTwoWords = 0;  break;
+        case OP_lload_1:  case OP_dload_1:
+            loadTwoWords = 1;  break;
+        default:
+            return;
+        }
+        slot = GetFieldSlot(ct, (c[3]<<8) + c[4], &itsTwoWords);
+        if (slot < 0 || itsTwoWords != loadTwoWords
+                || m->nArgs != 2 + loadTwoWords)
+            return;
+        m->inlineKind = INLINE_SETTER;
+    } else if (m->code_length == 5 && c[1] == OP_invokespecial
+            && c[4] == OP_return && isEmptyInit(ct, m, (c[2]<<8) + c[3])) {
+        slot = itsTwoWords = 0;
+        m->inlineKind = INLINE_EMPTY_INIT;
+    } else
+        return;
+    m->inlineSlot = slot;
+    m->inlineTwoWords = itsTwoWords;
+    numTrivialMethods++;
+    if (tracingExecution & TRACE_INVOKES)
+        fprintf(stdout, "method %s of class %s is trivial and will be inlined\n",
+            GetUTF8(ct->cf, m->name_index), ct->cf->cname);
+}
+
+
+static int32_t get4( uint8_t *p ) {
+    return (int32_t)(((uint32_t)p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3]);
+}
+
+
+/* Rewrites the switch instruction at offset pc of method m, whose
+   operands begin at the 4-byte aligned offset ix.  The operands are
+   read from the original code and written to quickCode. */
+static void predecodeSwitch( method_info *m, int pc, int ix ) {
+    uint8_t *c = m->code + ix;
+    int32_t *t = (int32_t *)(m->quickCode + ix);
+    int32_t low, high, npairs, n;
+
+    if (m->code[pc] == OP_tableswitch) {
+        low = get4(c+4);  high = get4(c+8);
+        for( n = 0;  n < 3 + (high - low + 1);  n++ )
+            t[n] = get4(c + 4*n);
+        m->quickCode[pc] = OP_tableswitch_quick;
+        numTableSwitches++;
+        return;
+    }
+    npairs = get4(c+4);
+    for( n = 1;  n < npairs;  n++ ) {
+        if (get4(c + 8 + 8*n) <= get4(c + 8*n))
+            return;     /* the keys must be sorted; leave it alone */
+    }
+    if (npairs > 0) {
+        low = get4(c+8);  high = get4(c + 8*npairs);
+        if ((int64_t)high - low < 2*npairs - 1) {
+            /* the table is no longer than the pairs it replaces */
+            t[0] = get4(c);
+            t[1] = low;  t[2] = high;
+            for( n = 0;  n <= high - low;  n++ )
+                t[3+n] = t[0];
+            for( n = 0;  n < npairs;  n++ )
+                t[3 + get4(c + 8 + 8*n) - low] = get4(c + 12 + 8*n);
+            m->quickCode[pc] = OP_tableswitch_quick;
+            numTableSwitches++;
+            numDenseLookups++;
+            return;
+        }
+    }
+    for( n = 0;  n < 2 + 2*npairs;  n++ )
+        t[n] = get4(c + 4*n);
+    m->quickCode[pc] = OP_lookupswitch_quick;
+    numSearchedLookups++;
+}
+
+
+/* Decodes a load from a local variable at p, where load is the opcode
+   which takes the variable's index as an operand and load_0 is the first
+   of its four short forms.  Returns the length of the instruction, or 0
+   if it is not such a load. */
+static int localLoad( uint8_t *p, int load, int load_0, int *local ) {
+    if (p[0] == load) {
+        *local = p[1];
+        return 2;
+    }
+    if (p[0] >= load_0 && p[0] <= load_0 + 3) {
+        *local = p[0] - load_0;
+        return 1;
+    }
+    return 0;
+}
+
+
+/* Decodes the push of a loop-invariant value which is stored into an
+   array by the <t>astore storeOp following it at p.  Returns the length
+   of the push, or 0. */
+static int fillValue( uint8_t *p, int storeOp, ArrayLoop *loop ) {
+    union { float f;  int32_t i; } fc;
+    union { double d;  int64_t l;  uint32_t u[2]; } dc;
+    int n, local;
+
+    switch(storeOp) {
+    case OP_iastore:  case OP_bastore:  case OP_castore:  case OP_sastore:
+        if ((n = localLoad(p, OP_iload, OP_iload_0, &local)) > 0)
+            break;
+        if (p[0] >= OP_iconst_m1 && p[0] <= OP_iconst_5)
+            loop->constant[0].ival = p[0] - OP_iconst_0;
+        else if (p[0] == OP_bipush)
+            loop->constant[0].ival = (int8_t)p[1];
+        else if (p[0] == OP_sipush)
+            loop->constant[0].ival = (int16_t)((p[1]<<8) + p[2]);
+        else
+            return 0;
+        return (p[0] == OP_bipush)? 2 : (p[0] == OP_sipush)? 3 : 1;
+    case OP_fastore:
+        if ((n = localLoad(p, OP_fload, OP_fload_0, &local)) > 0)
+            break;
+        if (p[0] < OP_fconst_0 || p[0] > OP_fconst_2)
+            return 0;
+        fc.f = p[0] - OP_fconst_0;
+        loop->constant[0].ival = fc.i;
+        return 1;
+    case OP_lastore:  case OP_dastore:
+        if ((n = localLoad(p, (storeOp == OP_lastore)? OP_lload : OP_dload,
+                (storeOp == OP_lastore)? OP_lload_0 : OP_dload_0, &local)) > 0) {
+            if (local+1 == loop->index)
+                return 0;
+            break;
+        }
+        if (storeOp == OP_lastore && (p[0] == OP_lconst_0 || p[0] == OP_lconst_1))
+            dc.l = p[0] - OP_lconst_0;
+        else if (storeOp == OP_dastore && (p[0] == OP_dconst_0 || p[0] == OP_dconst_1))
+            dc.d = p[0] - OP_dconst_0;
+        else
+            return 0;
+        loop->constant[0].uval = dc.u[0];
+        loop->constant[1].uval = dc.u[1];
+        return 1;
+    case OP_aastore:
+        if ((n = localLoad(p, OP_aload, OP_aload_0, &local)) > 0)
+            break;
+        if (p[0] != OP_aconst_null)
+            return 0;
+        loop->constant[0].pval = NULL_HEAP_REFERENCE;
+        return 1;
+    default:
+        return 0;
+    }
+    if (local == loop->index)
+        return 0;
+    loop->valueIsLocal = 1;
+    loop->src = local;
+    return n;
+}
+
+
+/* Determines whether the code at offset pc of method m is the head of
+   a copy or fill loop, and if so, describes the loop in *loop */
+static int matchArrayLoop( method_info *m, int pc, ArrayLoop *loop ) {
+    uint8_t *c = m->code, *p = c + pc;
+    int n, k, local, index, srcIndex, exit, storeOp;
+
+    memset(loop, 0, sizeof(ArrayLoop));
+    loop->pc = pc;
+    /* L: iload i; <bound>; if_icmpge E */
+    if ((n = localLoad(p, OP_iload, OP_iload_0, &index)) == 0)
+        return 0;
+    loop->index = index;
+    loop->headLength = n;
+    p += n;
+    if ((n = localLoad(p, OP_aload, OP_aload_0, &local)) > 0 && p[n] == OP_arraylength) {
+        loop->boundIsLength = 1;
+        p += n + 1;
+    } else if ((n = localLoad(p, OP_iload, OP_iload_0, &local)) > 0 && local != index)
+        p += n;
+    else
+        return 0;
+    loop->bound = local;
+    if (p[0] != OP_if_icmpge)
+        return 0;
+    exit = (p - c) + (int16_t)((p[1]<<8) + p[2]);
+    p += 3;
+    /* aload d; iload i; <value>; <t>astore */
+    if ((n = localLoad(p, OP_aload, OP_aload_0, &local)) == 0)
+        return 0;
+    loop->dest = local;
+    p += n;
+    if ((n = localLoad(p, OP_iload, OP_iload_0, &local)) == 0 || local != index)
+        return 0;
+    p += n;
+    if ((n = localLoad(p, OP_aload, OP_aload_0, &local)) > 0
+            && (k = localLoad(p+n, OP_iload, OP_iload_0, &srcIndex)) > 0
+            && srcIndex == index && p[n+k] >= OP_iaload && p[n+k] <= OP_saload
+            && p[n+k+1] == p[n+k] + (OP_iastore - OP_iaload)) {
+        loop->kind = LOOP_COPY;
+        loop->src = local;
+        p += n + k + 2;
+    } else {
+        /* the value is pushed by an instruction of 1 to 3 bytes */
+        for( k = 1;  k <= 3;  k++ ) {
+            storeOp = p[k];
+            if (storeOp >= OP_iastore && storeOp <= OP_sastore
+                    && fillValue(p, storeOp, loop) == k)
+                break;
+        }
+        if (k > 3)
+            return 0;
+        loop->kind = LOOP_FILL;
+        p += k + 1;
+    }
+    /* iinc i 1; goto L; E: */
+    if (p[0] != OP_iinc || p[1] != index || p[2] != 1)
+        return 0;
+    p += 3;
+    if (p[0] != OP_goto || (p - c) + (int16_t)((p[1]<<8) + p[2]) != pc)
+        return 0;
+    p += 3;
+    return exit == p - c;
+}
+
+
+/* Finds the copy and fill loops of method m */
+static void findArrayLoops( ClassType *ct, method_info *m ) {
+    ArrayLoop loop;
+    int pc, n = 0;
+
+    for( pc = 0;  pc < m->code_length;  pc += InstructionLength(m->code, pc) ) {
+        if (matchArrayLoop(m, pc, &loop))
+            n++;
+    }
+    if (n == 0)
+        return;
+    m->arrayLoops = SafeCalloc(n, sizeof(ArrayLoop));
+    for( pc = 0;  pc < m->code_length;  pc += InstructionLength(m->code, pc) ) {
+        if (!matchArrayLoop(m, pc, &loop))
+            continue;
+        m->arrayLoops[m->numArrayLoops++] = loop;
+        m->quickCode[pc] = OP_arrayloop_quick;
+        numArrayLoops++;
+        if (tracingExecution & TRACE_INVOKES)
+            fprintf(stdout, "the loop at offset %d of method %s of class %s is a %s loop\n",
+                pc, GetUTF8(ct->cf, m->name_index), ct->cf->cname,
+                (loop.kind == LOOP_COPY)? "copy" : "fill");
+    }
+}
+
+
+/* Pre-decodes all the methods of class ct */
+void PredecodeClass( ClassType *ct ) {
+    ClassFile *cf = ct->cf;
+    int i, pc;
+
+    for( i = 0;  i < cf->methods_count;  i++ ) {
+        method_info *m = &cf->methods[i];
+        if (m->code == NULL) continue;
+        m->quickCode = SafeMalloc(m->code_length);
+        memcpy(m->quickCode, m->code, m->code_length);
+        classifyMethod(ct, m);
+        for( pc = 0;  pc < m->code_length;  pc += InstructionLength(m->code, pc) ) {
+            if (m->code[pc] == OP_tableswitch || m->code[pc] == OP_lookupswitch)
+                predecodeSwitch(m, pc, (pc + 4) & ~3);
+        }
+        findArrayLoops(ct, m);
+        EliminateBoundsChecks(ct, m);
+    }
+}
+
+
+/* Returns the internal opcode which performs the action of a call of
+   the trivial method m */
+int InlinedOpcode( method_info *m ) {
+    switch(m->inlineKind) {
+    case INLINE_GETTER:
+        return m->inlineTwoWords? OP_getfield2_inline : OP_getfield_inline;
+    case INLINE_SETTER:
+        return m->inlineTwoWords? OP_putfield2_inline : OP_putfield_inline;
+    case INLINE_EMPTY_INIT:
+        return OP_init_inline;
+    }
+    assert(0);
+    return OP_nop;
+}
+
+
+/* Rewrites the call of the trivial method m, at opcodeAddr in some
+   method's quickCode, so that the field access is performed directly.
+   The two operand bytes of the call are replaced by the field's index. */
+void RewriteInlinedCall( method_info *m, uint8_t *opcodeAddr ) {
+    opcodeAddr[0] = InlinedOpcode(m);
+    opcodeAddr[1] = m->inlineSlot >> 8;
+    opcodeAddr[2] = m->inlineSlot & 0xff;
+}
+
+
+/* Report on the work of the pre-decoder */
+void PrintPredecodeStatistics() {
+    printf("\nPre-decoder Statistics\n======================\n\n");
+    printf("  Number of trivial methods found = %d\n", numTrivialMethods);
+    printf("  Number of calls elided by inlining = %ld\n", InlinedCalls);
+    printf("  Number of switches made into jump tables = %d (%d from lookupswitch)\n",
+        numTableSwitches, numDenseLookups);
+    printf("  Number of lookupswitches searched by bisection = %d\n",
+        numSearchedLookups);
+    printf("  Number of copy and fill loops found = %d\n", numArrayLoops);
+}
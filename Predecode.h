@@ -0,0 +1,25 @@
+/* Predecode.h */
+
+#ifndef PREDECODEH
+
+#define PREDECODEH
+
+#include "ClassFileFormat.h"  /* to define method_info type */
+#include "jvm.h"              /* to define ClassType type */
+
+/* values for the inlineKind field of a method_info struct */
+typedef enum {
+    INLINE_NONE=0,       /* an ordinary method */
+    INLINE_GETTER,       /* aload_0; getfield; <t>return */
+    INLINE_SETTER,       /* aload_0; <t>load_1; putfield; return */
+    INLINE_EMPTY_INIT    /* aload_0; invokespecial <empty init>; return */
+} InlineKind;
+
+extern long InlinedCalls;
+
+extern void PredecodeClass( ClassType *ct );
+extern int InlinedOpcode( method_info *m );
+extern void RewriteInlinedCall( method_info *m, uint8_t *opcodeAddr );
+extern void PrintPredecodeStatistics();
+
+#endif
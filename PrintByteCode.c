@@ -236,47 +236,47 @@ struct { char *name, *opnds_format; }
     { /*0Xc8*/ "goto_w", "B" },
     { /*0Xc9*/ "jsr_w", "B" },
     { /*0Xca*/ "breakpoint", NULL },
-    { /*0Xcb*/ "", NULL },
-    { /*0Xcc*/ "", NULL },
-    { /*0Xcd*/ "", NULL },
-    { /*0Xce*/ "", NULL },
-    { /*0Xcf*/ "", NULL },
-    { /*0Xd0*/ "", NULL },
-    { /*0Xd1*/ "", NULL },
-    { /*0Xd2*/ "", NULL },
-    { /*0Xd3*/ "", NULL },
-    { /*0Xd4*/ "", NULL },
-    { /*0Xd5*/ "", NULL },
-    { /*0Xd6*/ "", NULL },
-    { /*0Xd7*/ "", NULL },
-    { /*0Xd8*/ "", NULL },
-    { /*0Xd9*/ "", NULL },
-    { /*0Xda*/ "", NULL },
-    { /*0Xdb*/ "", NULL },
-    { /*0Xdc*/ "", NULL },
-    { /*0Xdd*/ "", NULL },
-    { /*0Xde*/ "", NULL },
-    { /*0Xdf*/ "", NULL },
-    { /*0Xe0*/ "", NULL },
-    { /*0Xe1*/ "", NULL },
-    { /*0Xe2*/ "", NULL },
-    { /*0Xe3*/ "", NULL },
-    { /*0Xe4*/ "", NULL },
-    { /*0Xe5*/ "", NULL },
-    { /*0Xe6*/ "", NULL },
-    { /*0Xe7*/ "", NULL },
-    { /*0Xe8*/ "", NULL },
-    { /*0Xe9*/ "", NULL },
-    { /*0Xea*/ "", NULL },
-    { /*0Xeb*/ "", NULL },
-    { /*0Xec*/ "", NULL },
-    { /*0Xed*/ "", NULL },
-    { /*0Xee*/ "", NULL },
-    { /*0Xef*/ "", NULL },
-    { /*0Xf0*/ "", NULL },
-    { /*0Xf1*/ "", NULL },
-    { /*0Xf2*/ "", NULL },
-    { /*0Xf3*/ "", NULL },
+    { /*0Xcb*/ "getfield_inline", "S" },
+    { /*0Xcc*/ "getfield2_inline", "S" },
+    { /*0Xcd*/ "putfield_inline", "S" },
+    { /*0Xce*/ "putfield2_inline", "S" },
+    { /*0Xcf*/ "init_inline", "S" },
+    { /*0Xd0*/ "tableswitch_quick", NULL },
+    { /*0Xd1*/ "lookupswitch_quick", NULL },
+    { /*0Xd2*/ "arrayloop_quick", NULL },
+    { /*0Xd3*/ "iaload_quick", NULL },
+    { /*0Xd4*/ "laload_quick", NULL },
+    { /*0Xd5*/ "faload_quick", NULL },
+    { /*0Xd6*/ "daload_quick", NULL },
+    { /*0Xd7*/ "aaload_quick", NULL },
+    { /*0Xd8*/ "baload_quick", NULL },
+    { /*0Xd9*/ "caload_quick", NULL },
+    { /*0Xda*/ "saload_quick", NULL },
+    { /*0Xdb*/ "iastore_quick", NULL },
+    { /*0Xdc*/ "lastore_quick", NULL },
+    { /*0Xdd*/ "fastore_quick", NULL },
+    { /*0Xde*/ "dastore_quick", NULL },
+    { /*0Xdf*/ "aastore_quick", NULL },
+    { /*0Xe0*/ "bastore_quick", NULL },
+    { /*0Xe1*/ "castore_quick", NULL },
+    { /*0Xe2*/ "sastore_quick", NULL },
+    { /*0Xe3*/ "iaload_nonnull", NULL },
+    { /*0Xe4*/ "laload_nonnull", NULL },
+    { /*0Xe5*/ "faload_nonnull", NULL },
+    { /*0Xe6*/ "daload_nonnull", NULL },
+    { /*0Xe7*/ "aaload_nonnull", NULL },
+    { /*0Xe8*/ "baload_nonnull", NULL },
+    { /*0Xe9*/ "caload_nonnull", NULL },
+    { /*0Xea*/ "saload_nonnull", NULL },
+    { /*0Xeb*/ "iastore_nonnull", NULL },
+    { /*0Xec*/ "lastore_nonnull", NULL },
+    { /*0Xed*/ "fastore_nonnull", NULL },
+    { /*0Xee*/ "dastore_nonnull", NULL },
+    { /*0Xef*/ "aastore_nonnull", NULL },
+    { /*0Xf0*/ "bastore_nonnull", NULL },
+    { /*0Xf1*/ "castore_nonnull", NULL },
+    { /*0Xf2*/ "sastore_nonnull", NULL },
+    { /*0Xf3*/ "arraylength_quick", NULL },
     { /*0Xf4*/ "", NULL },
     { /*0Xf5*/ "", NULL },
     { /*0Xf6*/ "", NULL },
@@ -0,0 +1,174 @@
+/* Profiler.c */
+
+/*
+   The sampling profiler.
+
+   With the -P option, a SIGPROF timer interrupts the program every
+   PROFILE_INTERVAL_USEC of CPU time, and the handler records the chain
+   of frames active at that moment.  The frames of the JVM (see jvm.c)
+   already form the shadow stack needed: every call, interpreted or
+   compiled, pushes one with JVM_PushFrame, which fills in the frame
+   before making it the top frame, so that a sample never sees a frame
+   which is half built.
+
+   A sample is the list of (class, method) pairs from the top frame
+   down, at most PROFILE_MAX_DEPTH of them.  The handler cannot allocate
+   memory, so the distinct samples are counted in a hash table of fixed
+   size whose frames are kept in a pool allocated at the start; a sample
+   which does not fit is counted as dropped.
+
+   At exit, the samples are written in the "collapsed stack" format read
+   by flame graph tools: one line for each distinct stack, with the
+   methods from the outermost call to the innermost separated by ';',
+   followed by the number of samples.  A stack cut short is shown as
+   called from [truncated].  Samples taken outside any Java method, as
+   while the classes are loaded, are counted under [jvm].
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "MyAlloc.h"
+#include "Profiler.h"
+
+#define PROFILE_INTERVAL_USEC 1000    /* CPU time between samples */
+#define PROFILE_MAX_DEPTH    128      /* # innermost frames kept per sample */
+#define PROFILE_TABLE_SIZE   (1<<14)  /* # distinct stacks, a power of 2 */
+#define PROFILE_POOL_SIZE    (1<<18)  /* # frames of all the distinct stacks */
+
+typedef struct {
+    ClassType   *thisClass;
+    method_info *method;
+} SampledFrame;
+
+/* one distinct stack, whose frames are pool[start..start+depth-1],
+   innermost first */
+typedef struct {
+    uint32_t hash;
+    uint32_t start;
+    uint16_t depth;
+    uint8_t  truncated;     /* true => the outer frames were cut off */
+    uint32_t count;         /* 0 => an unused entry */
+} StackEntry;
+
+static StackEntry *table;
+static SampledFrame *pool;
+static uint32_t poolUsed = 0;
+static long numDropped = 0;
+static char *profileFileName;
+
+
+/* the handler of SIGPROF: counts the stack of the current frames */
+static void takeSample( int sig ) {
+    SampledFrame sample[PROFILE_MAX_DEPTH];
+    Frame *f;
+    uint32_t h = 0, i;
+    int depth = 0, ix;
+
+    /* pairs with the fence in JVM_PushFrame */
+    atomic_signal_fence(memory_order_acquire);
+    f = JVM_FrameTop;
+    for( ;  f > JVM_Frames && depth < PROFILE_MAX_DEPTH;  f-- ) {
+        sample[depth].thisClass = f->thisClass;
+        sample[depth].method = f->method;
+        h = h * 31 + (uint32_t)((uintptr_t)f->method >> 3);
+        depth++;
+    }
+    h = h * 31 + depth;
+    for( i = 0;  i < PROFILE_TABLE_SIZE;  i++ ) {
+        StackEntry *e = &table[(h + i) & (PROFILE_TABLE_SIZE-1)];
+        if (e->count == 0) {
+            if (poolUsed + depth > PROFILE_POOL_SIZE)
+                break;
+            e->hash = h;
+            e->start = poolUsed;
+            e->depth = depth;
+            e->truncated = (f > JVM_Frames);
+            memcpy(&pool[poolUsed], sample, depth * sizeof(SampledFrame));
+            poolUsed += depth;
+            e->count = 1;
+            return;
+        }
+        if (e->hash == h && e->depth == depth && e->truncated == (f > JVM_Frames)) {
+            for( ix = 0;  ix < depth;  ix++ ) {
+                if (pool[e->start + ix].method != sample[ix].method)
+                    break;
+            }
+            if (ix == depth) {
+                e->count++;
+                return;
+            }
+        }
+    }
+    numDropped++;
+}
+
+
+/* Writes the samples to the profile file, in the collapsed stack format */
+static void writeProfile() {
+    struct itimerval off;
+    FILE *out;
+    int i, j;
+
+    memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, NULL);
+    signal(SIGPROF, SIG_IGN);
+    out = fopen(profileFileName, "w");
+    if (out == NULL) {
+        fprintf(stderr, "unable to write the profile to %s\n", profileFileName);
+        return;
+    }
+    for( i = 0;  i < PROFILE_TABLE_SIZE;  i++ ) {
+        StackEntry *e = &table[i];
+        if (e->count == 0) continue;
+        if (e->depth == 0)
+            fprintf(out, "[jvm]");
+        else if (e->truncated)
+            fprintf(out, "[truncated];");
+        for( j = e->depth - 1;  j >= 0;  j-- ) {
+            SampledFrame *sf = &pool[e->start + j];
+            fprintf(out, "%s.%s%s", sf->thisClass->cf->cname,
+                GetUTF8(sf->thisClass->cf, sf->method->name_index),
+                j > 0? ";" : "");
+        }
+        fprintf(out, " %u\n", e->count);
+    }
+    if (numDropped > 0)
+        fprintf(out, "[dropped] %ld\n", numDropped);
+    fclose(out);
+}
+
+
+/* Starts sampling the frames; the profile is written to fileName at exit */
+void StartProfiler( char *fileName ) {
+    struct sigaction sa;
+    struct itimerval interval;
+
+    profileFileName = fileName;
+    table = SafeCalloc(PROFILE_TABLE_SIZE, sizeof(StackEntry));
+    pool = SafeCalloc(PROFILE_POOL_SIZE, sizeof(SampledFrame));
+    atexit(writeProfile);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = takeSample;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) != 0) {
+        fprintf(stderr, "unable to install the SIGPROF handler\n");
+        exit(1);
+    }
+    interval.it_interval.tv_sec = 0;
+    interval.it_interval.tv_usec = PROFILE_INTERVAL_USEC;
+    interval.it_value = interval.it_interval;
+    if (setitimer(ITIMER_PROF, &interval, NULL) != 0) {
+        fprintf(stderr, "unable to start the profiling timer\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,9 @@
+/* Profiler.h */
+
+#ifndef PROFILERH
+
+#define PROFILERH
+
+extern void StartProfiler( char *fileName );
+
+#endif
@@ -18,6 +18,7 @@
 #include "ClassFileFormat.h"
 #include "ReadClassFile.h"
 #include "MyAlloc.h"
+#include "Metrics.h"
 
 
 typedef struct FileNameListItem {
@@ -27,6 +28,17 @@ typedef struct FileNameListItem {
     } *FileNameList;
 
 static FileNameList filesRead = NULL;  // list of class files we tried to read
+static long numFilesParsed = 0;
+static long numBytesParsed = 0;
+
+
+/* Registers the metrics of this module (see Metrics.c) */
+void RegisterClassFileMetrics() {
+    RegisterCounter("jvm_class_files_parsed_total", NULL,
+        "Class files parsed", &numFilesParsed);
+    RegisterCounter("jvm_class_file_bytes_parsed_total", NULL,
+        "Bytes of class files parsed", &numBytesParsed);
+}
 
 
 void PrintFilesRead() {
@@ -273,12 +285,13 @@ static void ReadMethods(FILE *f, ClassFile *cf) {
             ix += ip->code_length;
             ip->exception_table_length = (attr[ix]<<8) + attr[ix+1];
             ix += 2;
+            /* each entry of the table occupies 8 bytes */
             if (ip->exception_table_length > 0) {
-                ip->exception_table = ptr = SafeMalloc(ip->exception_table_length);
-                memcpy(ptr, attr+ix, ip->exception_table_length);
+                ip->exception_table = ptr = SafeMalloc(8*ip->exception_table_length);
+                memcpy(ptr, attr+ix, 8*ip->exception_table_length);
             } else
                 ip->exception_table = NULL;
-            ix += ip->exception_table_length;
+            ix += 8*ip->exception_table_length;
             ip->attributes_count = (attr[ix]<<8) + attr[ix+1];
             ix += 2;
             if (ip->attributes_count > 0) {
@@ -348,6 +361,8 @@ ClassFile *ReadClassFile( char *classname ) {
     ReadMethods(f,result);
     ReadAttributes(f, result, NULL);
     result->cname = GetCPItemAsString(result,result->this_class);
+    numFilesParsed++;
+    numBytesParsed += ftell(f);
     fclose(f);
     return result;
 }
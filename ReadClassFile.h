@@ -8,6 +8,7 @@
 #include "ClassFileFormat.h"  /* to define ClassFile type */
 
 extern void PrintFilesRead();
+extern void RegisterClassFileMetrics();
 extern int CountParameters( uint8_t *s );
 extern ClassFile *ReadClassFile( char *filename );
 
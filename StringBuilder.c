@@ -17,117 +17,194 @@
 #include "InterpretLoop.h"
 #include "MyAlloc.h"
 #include "TraceOptions.h"
+#include "NativeClasses.h"
+#include "NumberFormat.h"
 #include "StringBuilder.h"
 
 char *StringBuilderName = "java/lang/StringBuilder";
 
+/* the capacity of a StringBuilder created without one, as in Java */
+#define SB_DEFAULT_CAPACITY  16
+
 // forward declaration
-static void sbAppend( char *sval );
+static void sbAppend( char *s, int len );
 
 
 // Allocate a new instance of StringBuilder on the heap
 ClassInstance *NewStringBuilderInstance() {
-    StringBuilderInstance *sbi = MyHeapAlloc(sizeof(StringBuilderInstance));
-    sbi->kind = CODE_SBLD;
+    StringBuilderInstance *sbi = MyHeapAlloc(sizeof(StringBuilderInstance),
+        CODE_SBLD);
     return (ClassInstance*)sbi;
 }
 
 
-// Handle the instance methods
-void StringBuilderClass( char *methodName, char *methodDescr ) {
-    HeapPointer hp;
-    char buffer[32];
-
-    if (strcmp(methodName,"<init>") == 0) {
-        if (strcmp(methodDescr,"()V") == 0) {
-            hp = JVM_Pop();
-            if (hp == NULL_HEAP_REFERENCE)
-                throwExceptionExternal("NullPointerException", methodName, StringBuilderName);
-            StringBuilderInstance *sb = REAL_HEAP_POINTER(hp);
-            sb->capacity = 64;  // could be any number!
-            sb->buffer = SafeMalloc(sb->capacity);
-            sb->len = 0;
-            return;
-        }
-        // could add support for more constructors here
-    }
-    if (strcmp(methodName,"append") == 0) {
-        if (strcmp(methodDescr,"(Ljava/lang/String;)Ljava/lang/StringBuilder;") == 0) {
-            hp = JVM_Pop();
-            if (hp == NULL_HEAP_REFERENCE)
-                throwExceptionExternal("NullPointerException", methodName, StringBuilderName);
-            StringInstance *sp = REAL_HEAP_POINTER(hp);
-            sbAppend(sp->sval);
-            return;
-        }
-        if (strcmp(methodDescr,"(I)Ljava/lang/StringBuilder;") == 0) {
-            int32_t ival = JVM_Pop();
-            sprintf(buffer, "%d", ival);
-            sbAppend(buffer);
-            return;
-        }
-        if (strcmp(methodDescr,"(F)Ljava/lang/StringBuilder;") == 0) {
-            float fval = JVM_PopFloat();
-            sprintf(buffer, "%f", fval);
-            sbAppend(buffer);
-            return;
-        }
-        if (strcmp(methodDescr,"(D)Ljava/lang/StringBuilder;") == 0) {
-            union { struct { uint32_t v0; uint32_t v1; } ss; double d; } pair;
-            pair.ss.v1 = JVM_Pop();
-            pair.ss.v0 = JVM_Pop();
-            sprintf(buffer, "%lf", pair.d);
-            sbAppend(buffer);
-            return;
-        }
-        if (strcmp(methodDescr,"(C)Ljava/lang/StringBuilder") == 0) {
-            int32_t ival = JVM_Pop();
-            buffer[0] = (char)ival;  buffer[1] = 0;
-            sbAppend(buffer);
-            return;
-        }
-        // could add support for appending more datatypes here
-    }
-    if (strcmp(methodName,"toString") == 0 && strcmp(methodDescr,"()Ljava/lang/String;") == 0) {
-        StringBuilderInstance *sbi;
-        HeapPointer hp = JVM_Pop();
-        if (hp == NULL_HEAP_REFERENCE)
-            throwExceptionExternal("NullPointerException", methodName, StringBuilderName);
-        sbi = REAL_HEAP_POINTER(hp);
-        StringInstance *sp = MyHeapAlloc(sizeof(StringInstance));
-        sp->kind = CODE_STRG;
-        sp->sval = SafeMalloc(sbi->len+1);
-        memcpy(sp->sval, sbi->buffer, sbi->len+1);
-        hp = MAKE_HEAP_REFERENCE(sp);
-        JVM_Push(hp);
+// Returns the StringBuilder referenced by the stack item d
+static StringBuilderInstance *sbInstance( DataItem *d, char *methodName ) {
+    if (d->pval == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", methodName, StringBuilderName);
+    return REAL_HEAP_POINTER(d->pval);
+}
+
+
+// Makes room for at least needed chars in the StringBuilder referenced
+// by the stack item d.  The capacity grows geometrically, so a sequence
+// of appends copies each char a constant number of times on average.
+// The new char array is allocated on the Java heap while the
+// StringBuilder is still on the stack, so a gc cannot reclaim it.
+static void sbEnsureCapacity( DataItem *d, int needed ) {
+    StringBuilderInstance *sbi = REAL_HEAP_POINTER(d->pval);
+    ArrayOfSimple *oldArr = sbi->value == NULL_HEAP_REFERENCE? NULL
+        : REAL_HEAP_POINTER(sbi->value);
+    int capacity = oldArr == NULL? 0 : oldArr->size;
+    HeapPointer newValue;
+
+    if (needed <= capacity)
         return;
-    }
-    fprintf(stderr, "%s.%s with signature %s is unsupported\n",
-        StringBuilderName, methodName, methodDescr);
-    exit(1);
+    capacity = 2*capacity + 2;
+    if (capacity < needed)
+        capacity = needed;
+    newValue = AllocateSimpleArray(5, capacity);
+    sbi = REAL_HEAP_POINTER(d->pval);
+    if (sbi->len > 0)
+        memcpy(((ArrayOfSimple*)REAL_HEAP_POINTER(newValue))->u.cval,
+            oldArr->u.cval, sbi->len);
+    sbi->value = newValue;
 }
 
 
-// apopends the sval string onto the current StringBuilder contents.
-static void sbAppend( char *sval ) {
-    StringBuilderInstance *sbi;
-    HeapPointer hp = JVM_Pop();
-    if (hp == NULL_HEAP_REFERENCE)
+static void sbInit() {
+    sbInstance(JVM_Top, "<init>");
+    sbEnsureCapacity(JVM_Top, SB_DEFAULT_CAPACITY);
+    JVM_Pop();
+}
+
+static void sbInitCapacity() {
+    int capacity = JVM_Top->ival;
+    sbInstance(JVM_Top-1, "<init>");
+    if (capacity < 0)
+        throwExceptionExternal("NegativeArraySizeException", "<init>",
+            StringBuilderName);
+    sbEnsureCapacity(JVM_Top-1, capacity > 0? capacity : 1);
+    JVM_Pop();
+    JVM_Pop();
+}
+
+static void sbInitString() {
+    StringInstance *sp;
+    sbInstance(JVM_Top-1, "<init>");
+    if (JVM_Top->pval == NULL_HEAP_REFERENCE)
+        throwExceptionExternal("NullPointerException", "<init>", StringBuilderName);
+    sp = REAL_HEAP_POINTER(JVM_Top->pval);
+    sbEnsureCapacity(JVM_Top-1, sp->length + SB_DEFAULT_CAPACITY);
+    JVM_Pop();
+    sbAppend(sp->chars, sp->length);
+    JVM_Pop();
+}
+
+static void sbAppendString() {
+    StringBuilderInstance *sbi = sbInstance(JVM_Top-1, "append");
+    StringInstance *sp;
+    if (JVM_Top->pval == NULL_HEAP_REFERENCE)
         throwExceptionExternal("NullPointerException", "append", StringBuilderName);
-    sbi = REAL_HEAP_POINTER(hp);
-    int slen = sval==NULL? 0 : strlen(sval);
-    if (slen > 0) {
-        if (sbi->len + slen >= sbi->capacity) {
-            // need to expand the buffer
-            sbi->capacity = sbi->len + slen + 30;
-            char *newBuffer = SafeMalloc(sbi->capacity);
-            memcpy(newBuffer,sbi->buffer,sbi->len);
-            SafeFree(sbi->buffer);
-            sbi->buffer = newBuffer;
-        }
-        memcpy(sbi->buffer+sbi->len, sval, slen);
-        sbi->len += slen;
-        sbi->buffer[sbi->len] = 0;  // make sure there's a string terminator
-    }
-    JVM_Push(hp);
+    sp = REAL_HEAP_POINTER(JVM_Top->pval);
+    // grow while the string is still on the stack
+    sbEnsureCapacity(JVM_Top-1, sbi->len + sp->length);
+    JVM_Pop();
+    sbAppend(sp->chars, sp->length);
+}
+
+// Returns where the chars of a number should be formatted in the
+// StringBuilder on top of the stack, after making room for the longest
+// number plus its 0 byte.  The number is formatted straight into the
+// char array, with no intermediate buffer; sbAppended then counts it.
+static char *sbNumberSpace() {
+    StringBuilderInstance *sbi = sbInstance(JVM_Top, "append");
+    ArrayOfSimple *arr;
+    sbEnsureCapacity(JVM_Top, sbi->len + NUMBER_BUFFER_SIZE);
+    arr = REAL_HEAP_POINTER(sbi->value);
+    return arr->u.cval + sbi->len;
+}
+
+static void sbAppended( int len ) {
+    StringBuilderInstance *sbi = REAL_HEAP_POINTER(JVM_Top->pval);
+    sbi->len += len;
+}
+
+static void sbAppendInt() {
+    int32_t ival = JVM_Pop();
+    sbAppended(FormatInt(sbNumberSpace(), ival));
+}
+
+static void sbAppendLong() {
+    union { struct { uint32_t v0; uint32_t v1; } ss; int64_t l; } pair;
+    pair.ss.v1 = JVM_Pop();
+    pair.ss.v0 = JVM_Pop();
+    sbAppended(FormatLong(sbNumberSpace(), pair.l));
+}
+
+static void sbAppendFloat() {
+    float fval = JVM_PopFloat();
+    sbAppended(FormatFloat(sbNumberSpace(), fval));
+}
+
+static void sbAppendDouble() {
+    union { struct { uint32_t v0; uint32_t v1; } ss; double d; } pair;
+    pair.ss.v1 = JVM_Pop();
+    pair.ss.v0 = JVM_Pop();
+    sbAppended(FormatDouble(sbNumberSpace(), pair.d));
+}
+
+static void sbAppendBoolean() {
+    if (JVM_Pop())
+        sbAppend("true", 4);
+    else
+        sbAppend("false", 5);
+}
+
+static void sbAppendChar() {
+    char buffer[2];
+    int32_t ival = JVM_Pop();
+    buffer[0] = (char)ival;  buffer[1] = 0;
+    sbAppend(buffer, 1);
+}
+
+static void sbToString() {
+    StringBuilderInstance *sbi = sbInstance(JVM_Top, "toString");
+    ArrayOfSimple *arr = REAL_HEAP_POINTER(sbi->value);
+    // the StringBuilder stays on the stack while the string is allocated
+    JVM_Top->pval = AllocateString(arr->u.cval, sbi->len);
+}
+
+
+// Register the instance methods with the native method registry
+void RegisterStringBuilderNatives() {
+    char *sb = StringBuilderName;
+
+    RegisterNative(sb, "<init>", "()V", sbInit);
+    RegisterNative(sb, "<init>", "(I)V", sbInitCapacity);
+    RegisterNative(sb, "<init>", "(Ljava/lang/String;)V", sbInitString);
+    RegisterNative(sb, "append", "(Ljava/lang/String;)Ljava/lang/StringBuilder;",
+        sbAppendString);
+    RegisterNative(sb, "append", "(I)Ljava/lang/StringBuilder;", sbAppendInt);
+    RegisterNative(sb, "append", "(F)Ljava/lang/StringBuilder;", sbAppendFloat);
+    RegisterNative(sb, "append", "(D)Ljava/lang/StringBuilder;", sbAppendDouble);
+    RegisterNative(sb, "append", "(J)Ljava/lang/StringBuilder;", sbAppendLong);
+    RegisterNative(sb, "append", "(C)Ljava/lang/StringBuilder;", sbAppendChar);
+    RegisterNative(sb, "append", "(Z)Ljava/lang/StringBuilder;", sbAppendBoolean);
+    // could add support for appending more datatypes here
+    RegisterNative(sb, "toString", "()Ljava/lang/String;", sbToString);
+}
+
+
+// appends the len chars at s onto the contents of the StringBuilder on
+// top of the stack, which is left there as the result of append
+static void sbAppend( char *s, int len ) {
+    StringBuilderInstance *sbi = sbInstance(JVM_Top, "append");
+    ArrayOfSimple *arr;
+    if (len <= 0)
+        return;
+    sbEnsureCapacity(JVM_Top, sbi->len + len);
+    arr = REAL_HEAP_POINTER(sbi->value);
+    memcpy(arr->u.cval + sbi->len, s, len);
+    sbi->len += len;
 }
@@ -8,7 +8,7 @@
 
 extern char *StringBuilderName;
 
-extern void StringBuilderClass( char *methodName, char *methodDescr );
+extern void RegisterStringBuilderNatives();
 extern ClassInstance *NewStringBuilderInstance();
 
 #endif
@@ -0,0 +1,124 @@
+/* Timeline.c */
+
+/*
+   The timeline of the JVM's phases (the -L option).
+
+   Each class load, with the reading of its class file, the verification
+   of each of its methods and the execution of its <clinit> method, each
+   garbage collection and the execution of main is written to the
+   timeline file as a pair of begin and end events, in the JSON format
+   of the Chrome trace viewer (also read by Perfetto).  The events nest
+   as the calls of the C functions do, so the loads of the classes which
+   a class needs appear inside its own load, or inside the <clinit>
+   which caused them.
+
+   An exception thrown out of a <clinit> leaves its events, and perhaps
+   those of the loads around it, without their ends; these are written
+   when the exception is caught (see resumeAtHandler in Exceptions.c),
+   each event recording the top frame at its beginning.  The events
+   still open at exit are ended then.
+
+   The times are in microseconds since the timeline was started.  The
+   events are written as they happen, with buffered output.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ClassFileFormat.h"
+#include "jvm.h"
+#include "Timeline.h"
+
+#define TIMELINE_MAX_DEPTH 256        /* # nested events recorded */
+
+static FILE *timeline = NULL;
+static struct timespec startTime;
+static Frame *openEvents[TIMELINE_MAX_DEPTH];   /* top frame at each begin */
+static int depth = 0;                 /* # events begun and not ended */
+static int pid;
+
+
+static double elapsedUsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec - startTime.tv_sec) * 1e6
+        + (ts.tv_nsec - startTime.tv_nsec) / 1e3;
+}
+
+
+/* Writes s as the contents of a JSON string */
+static void writeEscaped( char *s ) {
+    for( ;  *s != '\0';  s++ ) {
+        if (*s == '"' || *s == '\\')
+            fprintf(timeline, "\\%c", *s);
+        else if ((unsigned char)*s < ' ')
+            fprintf(timeline, "\\u%04x", *s);
+        else
+            putc(*s, timeline);
+    }
+}
+
+
+static void endAll() {
+    while(depth > 0)
+        TimelineEnd();
+    fprintf(timeline, "\n]\n");
+    fclose(timeline);
+    timeline = NULL;
+}
+
+
+/* Starts the timeline, which is written to fileName */
+void InitTimeline( char *fileName ) {
+    timeline = fopen(fileName, "w");
+    if (timeline == NULL) {
+        fprintf(stderr, "unable to create the timeline file %s\n", fileName);
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    pid = getpid();
+    fprintf(timeline, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+        "\"tid\":1,\"args\":{\"name\":\"MyJVM\"}}", pid);
+    atexit(endAll);
+}
+
+
+/* Begins an event of the category, named as by printf(fmt, ...) */
+void TimelineBegin( char *category, char *fmt, ... ) {
+    char name[512];
+    va_list args;
+
+    if (timeline == NULL) return;
+    if (depth++ >= TIMELINE_MAX_DEPTH) return;
+    openEvents[depth-1] = JVM_FrameTop;
+    va_start(args, fmt);
+    vsnprintf(name, sizeof(name), fmt, args);
+    va_end(args);
+    fprintf(timeline, ",\n{\"name\":\"");
+    writeEscaped(name);
+    fprintf(timeline, "\",\"cat\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,"
+        "\"pid\":%d,\"tid\":1}", category, elapsedUsec(), pid);
+}
+
+
+/* Ends the innermost event */
+void TimelineEnd() {
+    if (timeline == NULL || depth == 0) return;
+    if (depth-- > TIMELINE_MAX_DEPTH) return;
+    fprintf(timeline, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":1}",
+        elapsedUsec(), pid);
+}
+
+
+/* Ends the events begun while f, or a frame above it, was the top
+   frame, as an exception caught in f has abandoned them */
+void TimelineUnwind( Frame *f ) {
+    if (timeline == NULL) return;
+    while(depth > 0 && (depth > TIMELINE_MAX_DEPTH || openEvents[depth-1] >= f))
+        TimelineEnd();
+}
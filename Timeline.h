@@ -0,0 +1,14 @@
+/* Timeline.h */
+
+#ifndef TIMELINEH
+
+#define TIMELINEH
+
+#include "jvm.h"
+
+extern void InitTimeline( char *fileName );
+extern void TimelineBegin( char *category, char *fmt, ... );
+extern void TimelineEnd();
+extern void TimelineUnwind( Frame *f );
+
+#endif
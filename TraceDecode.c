@@ -0,0 +1,124 @@
+/* TraceDecode.c */
+
+/*
+   Prints an event trace written by MyJVM -R (see EventTrace.c) as text,
+   one line for each event:
+       TraceDecode tracefile
+   It is a separate program, built by "make TraceDecode"; the names of
+   the opcodes and methods are taken from the trace file itself.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "EventTrace.h"
+
+static char *opNames[256];
+static char **methodNames;
+
+
+static void *safeMalloc( size_t size ) {
+    void *p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void readOrDie( void *p, size_t size, FILE *f ) {
+    if (size > 0 && fread(p, size, 1, f) != 1) {
+        fprintf(stderr, "the trace file is truncated\n");
+        exit(1);
+    }
+}
+
+static char *readName( FILE *f ) {
+    uint16_t len;
+    char *s;
+
+    readOrDie(&len, sizeof(len), f);
+    s = safeMalloc(len + 1);
+    readOrDie(s, len, f);
+    s[len] = '\0';
+    return s;
+}
+
+
+static void printEvent( TraceEvent *e ) {
+    printf("%-40s %6u  ", methodNames[e->method], e->height);
+    switch(e->kind) {
+    case EV_OP:
+        printf("%d: %s\n", e->pc, opNames[e->op]);
+        break;
+    case EV_INVOKE:
+        printf("%d: %s #%u\n", e->pc, opNames[e->op], e->value);
+        break;
+    case EV_PUSH:
+        printf("push 0x%X\n", e->value);
+        break;
+    case EV_POP:
+        printf("pop 0x%X\n", e->value);
+        break;
+    case EV_PUSH_FRAME:
+        printf("push frame\n");
+        break;
+    case EV_POP_FRAME:
+        printf("pop frame, result of %u items\n", e->value);
+        break;
+    case EV_ALLOC:
+        printf("heap allocation of %u bytes\n", e->value);
+        break;
+    case EV_GC:
+        printf("garbage collection, %u bytes reclaimed\n", e->value);
+        break;
+    default:
+        printf("unknown event %d\n", e->kind);
+        break;
+    }
+}
+
+
+int main( int argc, char *argv[] ) {
+    TraceFileHeader h;
+    TraceEvent *events;
+    uint32_t i;
+    FILE *f;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage:\n\t%s tracefile\n", argv[0]);
+        return 1;
+    }
+    f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        fprintf(stderr, "unable to open %s\n", argv[1]);
+        return 1;
+    }
+    readOrDie(&h, sizeof(h), f);
+    if (memcmp(h.magic, "JVMT", 4) != 0 || h.version != EVENT_TRACE_VERSION) {
+        fprintf(stderr, "%s is not an event trace of this version\n", argv[1]);
+        return 1;
+    }
+    events = safeMalloc(h.numEvents * sizeof(TraceEvent) + 1);
+    readOrDie(events, h.numEvents * sizeof(TraceEvent), f);
+    for( i = 0;  i < 256;  i++ )
+        opNames[i] = readName(f);
+    methodNames = safeMalloc((h.numMethods + 1) * sizeof(char *));
+    methodNames[0] = "-";
+    for( i = 1;  i <= h.numMethods;  i++ )
+        methodNames[i] = readName(f);
+    fclose(f);
+
+    if (h.numLost > 0)
+        printf("(%u earlier events were overwritten)\n", h.numLost);
+    for( i = 0;  i < h.numEvents;  i++ ) {
+        if (events[i].method > h.numMethods) {
+            fprintf(stderr, "event %u refers to an unknown method\n", i);
+            return 1;
+        }
+        printEvent(&events[i]);
+    }
+    return 0;
+}
@@ -19,6 +19,10 @@
 #include "VerifierUtils.h"
 #include "Verifier.h"
 #include "jvm.h"
+#include "Timeline.h"
+#include "Metrics.h"
+
+int verifyingClasses = 1;
 
 // Output an array of the verifier's type descriptors
 static void printTypeCodesArray( char **vstate, method_info *m, char *name ) {
@@ -161,6 +165,9 @@ static method_state *get_method_state(node *root, uint32_t position);
 static void insert_method_state(node *root, method_state *ms);
 static void ParseOpSignature(OpcodeDescription op, method_state* ms, method_info* mi);
 
+static long numMethodsVerified = 0;
+static long numIterations = 0;      // states taken from the worklist
+
 
 // Verify the bytecode of one method m from class file cf
 static void verifyMethod( ClassFile *cf, method_info *m ) {
@@ -175,7 +182,9 @@ static void verifyMethod( ClassFile *cf, method_info *m ) {
     node *D = init_dict(create_method_state(0,1,0,initState));
     method_state *curr_ms;
 
+    numMethodsVerified++;
     while ((curr_ms = find_set_change_bit(D)) != NULL) {
+        numIterations++;
         if (tracingExecution & TRACE_VERIFY)
                 printTypeCodesArray(curr_ms->typecode_list, m, name);
         
@@ -297,10 +306,10 @@ static void verifyMethod( ClassFile *cf, method_info *m ) {
                 b1 = m->code[p+1];
                 b2 = m->code[p+2];
                 b3 = (b1 << 8) + b2;
-                char* alcname = (char*)malloc((sizeof(char)*strlen(cf->cname)) + 2);
+                char* alcname = (char*)malloc((sizeof(char)*strlen(cf->cname)) + 3);
                 alcname[0] = 'A';
                 alcname[1] = 'L';
-                strncpy(alcname+2, cf->cname, strlen(cf->cname));
+                strcpy(alcname+2, cf->cname);
                 if (calc_ms->stack_height != 0)
                         pop_die(calc_ms, m, alcname);
                 // TODO @bradens handle the stars
@@ -486,7 +495,10 @@ void Verify( ClassFile *cf ) {
 
     for( i = 0;  i < cf->methods_count;  i++ ) {
         method_info *m = &(cf->methods[i]);
+        TimelineBegin("verify", "verify %s.%s%s", cf->cname,
+            GetUTF8(cf, m->name_index), GetUTF8(cf, m->descriptor_index));
 	    verifyMethod(cf, m);
+        TimelineEnd();
     }
     if (tracingExecution & TRACE_VERIFY)
     	fprintf(stdout, "Verification of class %s completed\n\n", cf->cname);
@@ -500,4 +512,8 @@ void InitVerifier(void) {
     CheckOpcodeTable();
 #endif
     // any initialization of local data structures can go here
+    RegisterCounter("jvm_methods_verified_total", NULL,
+        "Methods verified", &numMethodsVerified);
+    RegisterCounter("jvm_verifier_iterations_total", NULL,
+        "Iterations of the verifier's fixpoint computation", &numIterations);
 }
@@ -29,6 +29,8 @@ bool safe_store_local(method_state*, method_info*, char*, uint8_t);
 void push_die(method_state*, method_info*, char*);
 void pop_die(method_state*, method_info*, char*);
 
+extern int verifyingClasses;  /* setting to 0 turns verification off */
+
 extern void Verify( ClassFile *cf );
 extern void InitVerifier(void);
 
@@ -203,25 +203,30 @@ char **AnalyzeInvoke( ClassFile *cf, int ix, int isStatic, char **retTypep, int
 }
 
 
-static char *getClassName( ClassType *ctp ) {
-    if (ctp == NULL)
-        return "java/lang/Object";
-    if (ctp->isArrayType) return NULL;
-    ClassFile *cfp = ctp->cf;
-    return cfp->cname;
-}
+// Finds the loaded class whose name is at the start of s, where the
+// name is terminated by a ';'; the result is NULL if it's not loaded.
+static ClassType *findLoadedClass( char *s ) {
+    ClassType *ct1;
+    char *endPos = strchr(s,';');
+    int len;
 
+    assert(endPos != NULL);
+    len = endPos - s;
+    for( ct1 = FirstLoadedClass;  ct1 != NULL;  ct1 = ct1->nextClass ) {
+        if (ct1->isArrayType) continue;
+        if (strncmp(ct1->cf->cname, s, len) == 0 && ct1->cf->cname[len] == '\0')
+            return ct1;
+    }
+    return NULL;
+}
 
 
-static ClassType **ancestorTypesC( ClassType *ctp ) {
-    static ClassType *parents[32];
-    int cnt = 0;
-    while(ctp != NULL) {
-        parents[cnt++] = ctp;
-        ctp = ctp->parent;
-    }
-    parents[cnt++] = NULL;  // represents java.lang.object
-    return parents;
+// Returns the type descriptor, in the verifier's format, for a class.
+static char *classTypeDescriptor( ClassType *ct ) {
+    char *name = ct->cf->cname;
+    char *result = SafeMalloc(strlen(name)+4);
+    sprintf(result, "AL%s;", name);
+    return result;
 }
 
 
@@ -230,89 +235,90 @@ static ClassType **ancestorTypesC( ClassType *ctp ) {
 // The function result is a pointer to an array of strings, where element
 // 0 is the initial type descriptor, element 1 is the parent of element 0,
 // ... element i+1 is the parent of element i.
-// The last element is always the string "ALjava/lang/Object".
+// The last element is always the string "ALjava/lang/Object;".
+// The ancestors of a class are read from its display (see
+// ClassResolver.c); a class which has not been loaded is treated as
+// a direct subclass of java/lang/Object.
 // The int variable referenced by *cntp is set to the number of
 // strings and number of elements in the array.
 // Note: the result array and all strings in it have their storage
 // dynamically allocated.  The caller should deallocate the storage
 // via a call to FreeTypeDescriptorArray.
 char **AncestorTypes( char *typedescr, int *cntp ) {
-    static char *parents[32];     // we limit number of ancestors to 32
-    char *endPos, *s, **result;
-    ClassFile *cfp;
-    ClassType *ct1;
-    int cnt = 0;
-    int len, i;
-
-    if (typedescr[1] == 'L') {
-        parents[cnt++] = typedescr;
-        typedescr += 2;
-        for( ct1 = FirstLoadedClass;  ct1 != NULL;  ct1 = ct1->nextClass ) {
-            if (ct1->isArrayType) continue;
-            endPos = strchr(typedescr,';');
-            assert(endPos != NULL);
-            len = endPos - typedescr;
-            cfp = ct1->cf;
-            if (strncmp(cfp->cname, typedescr, len) == 0) {
-                // found it!
-                ClassType **cparents = ancestorTypesC(ct1);
-                for( cnt = 1;  ;  cnt++ ) {
-                    ClassType *ct2 = cparents[cnt];
-                    if (ct2 == NULL) break;
-                    s = getClassName(ct2);
-                    len = strlen(s);
-                    parents[cnt] = strcat(strcpy(SafeMalloc(len+3), "AL"), s);
-                }
-                break;
-            }       
-        }
-        parents[cnt++] = SafeStrdup("ALjava/lang/Object");
+    static char *object = "ALjava/lang/Object;";
+    char **result, **elemPath;
+    ClassType *ct1 = NULL;
+    int cnt = 0, elemCnt, i;
+
+    if (typedescr[0] != 'A' || (typedescr[1] != 'L' && typedescr[1] != '[')) {
+        *cntp = 0;
+        return NULL;
+    }
+    if (strcmp(typedescr, object) == 0) {
+        result = SafeCalloc(1, sizeof(char *));
+        result[cnt++] = SafeStrdup(object);
         *cntp = cnt;
-        result = SafeCalloc(cnt, sizeof(char *));
-        for( i = 0; i < cnt; i++ )
-            result[i] = parents[i];
         return result;
     }
-    if (typedescr[1] == '[') {
-        AncestorTypes(typedescr+2, &cnt);
-        parents[0] = typedescr;
-        for( i = 1;  i < cnt;  i++ ) {
-            s = parents[i];
-            len = strlen(s);
-            parents[i] = strcat(strcpy(SafeMalloc(len+3), "A["), s);
-            FreeTypeDescriptor(s);
+    if (typedescr[1] == 'L') {
+        ct1 = findLoadedClass(typedescr+2);
+        result = SafeCalloc((ct1 == NULL)? 2 : ct1->depth+2, sizeof(char *));
+        result[cnt++] = SafeStrdup(typedescr);
+        for( i = (ct1 == NULL)? -1 : ct1->depth-1;  i >= 0;  i-- )
+            result[cnt++] = classTypeDescriptor(ct1->display[i]);
+    } else if (typedescr[2] == 'A') {
+        // an array of references has the arrays of the element's
+        // ancestors as its ancestors
+        elemPath = AncestorTypes(typedescr+2, &elemCnt);
+        result = SafeCalloc(elemCnt+1, sizeof(char *));
+        for( i = 0;  i < elemCnt;  i++ ) {
+            result[cnt] = SafeMalloc(strlen(elemPath[i])+3);
+            strcat(strcpy(result[cnt++], "A["), elemPath[i]);
         }
-        assert(cnt<256);
-        parents[cnt++] = SafeStrdup("ALjava/lang/Object");
-        *cntp = cnt;
-        return parents;
+        FreeTypeDescriptorArray(elemPath, elemCnt);
+    } else {
+        result = SafeCalloc(2, sizeof(char *));
+        result[cnt++] = SafeStrdup(typedescr);
     }
-    *cntp = 0;
-    return NULL;
+    result[cnt++] = SafeStrdup(object);
+    *cntp = cnt;
+    return result;
 }
 
 // Given two type descriptors for reference types (i.e. the initial code
 // letter is 'A'), return the type descriptor for their lub in the
-// lattice of types.
+// lattice of types.  For two loaded classes, it is the deepest entry
+// which their displays have in common.
 // Note: the result is a string whose storage is allocated on the heap.
 // The caller should eventually deallocate it using SafeFree.
 char *LUB( char *type1, char *type2 ) {
-    int cnt1, cnt2, i, j;
-    char **path1, **path2, *result;
-    if (type1[0] != 'A' || type2[1] != 'A')
+    ClassType *ct1, *ct2;
+    char *elemLub, *result;
+    int d;
+
+    if (type1[0] != 'A' || type2[0] != 'A')
         return "X";
-    path1 = AncestorTypes(type1, &cnt1);
-    path2 = AncestorTypes(type2, &cnt2);
-    result = "ALjava/lang/Object";  // default result
-    i = cnt1;  j = cnt2;
-    while( i-- > 0 && j-- > 0 ) {
-        if (strcmp(path1[i], path2[j]) != 0) break;
-        result = path1[i];
+    if (strcmp(type1, type2) == 0)
+        return SafeStrdup(type1);
+    if (type1[1] == 'L' && type2[1] == 'L') {
+        ct1 = findLoadedClass(type1+2);
+        ct2 = findLoadedClass(type2+2);
+        if (ct1 != NULL && ct2 != NULL) {
+            d = (ct1->depth < ct2->depth)? ct1->depth : ct2->depth;
+            while(d >= 0 && ct1->display[d] != ct2->display[d])
+                d--;
+            if (d >= 0)
+                return classTypeDescriptor(ct1->display[d]);
+        }
+    } else if (type1[1] == '[' && type2[1] == '['
+            && type1[2] == 'A' && type2[2] == 'A') {
+        elemLub = LUB(type1+2, type2+2);
+        result = SafeMalloc(strlen(elemLub)+3);
+        strcat(strcpy(result, "A["), elemLub);
+        SafeFree(elemLub);
+        return result;
     }
-    result = SafeStrdup(result);
-    FreeTypeDescriptorArray(path1, cnt1);
-    FreeTypeDescriptorArray(path2, cnt2);
-    return result;
+    return SafeStrdup("ALjava/lang/Object;");
 }
 
 
@@ -1,13 +1,35 @@
 /* jvm.c */
 
+/*
+   The JVM stack and the frames.
+
+   The JVM stack is mapped with mmap: a guard area at each end, which
+   is never accessible, surrounds room for the largest stack allowed
+   by the -S option.  Only the start of that room is accessible at
+   first; an access beyond it faults, and JVM_StackFault, called from
+   the SIGSEGV handler (see Exceptions.c), makes more of the room
+   accessible and lets the access be retried.  An access to a guard
+   area ends execution with a stack overflow or underflow.
+
+   So pushes and pops are plain pointer arithmetic.  JVM_PushFrame still
+   checks, once per call, that the new frame fits within the maximum
+   size; the guard areas catch anything which escapes that check.
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>   /* for the definition of sbrk */
 #include <assert.h>
+#include <sys/mman.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include "ClassFileFormat.h"
 #include "ReadClassFile.h"
 #include "TraceOptions.h"
+#include "EventTrace.h"
+#include "MethodProfile.h"
+#include "Metrics.h"
 #include "MyAlloc.h"
 #include "jvm.h"
 
@@ -15,90 +37,226 @@ DataItem *JVM_Stack;          /* ptr to base of stack */
 DataItem *JVM_Top;            /* ptr to current top element on stack */
 DataItem *JVM_StackLimit;     /* ptr to end of storage for stack */
 int JVM_StackSize;            /* size of stack area, as # of elements */
+Frame *JVM_Frames;            /* ptr to the frame of the first method called */
+Frame *JVM_FrameTop;          /* ptr to the frame of the current method */
+Frame *JVM_FrameLimit;        /* ptr to end of storage for frames */
 void *Fake_System_Out;        /* pretends to be the java/lang/System.out value */
 
+#define STACK_GUARD_SIZE   (64*1024)    /* # bytes in each guard area */
+#define STACK_INITIAL_SIZE (64*1024)    /* # bytes accessible at first */
+
+static uint8_t *stackMapping;         /* start of the lower guard area */
+static uint8_t *stackCommitted;       /* end of the accessible part */
+static uint8_t *stackEnd;             /* start of the upper guard area */
+static long pageSize;
+static int numStackGrowths = 0;
+
+static long numFrames() {
+    return JVM_FrameTop - JVM_Frames;
+}
+
+static long stackAccessibleBytes() {
+    return stackCommitted - (uint8_t *)JVM_Stack;
+}
+
+static uint8_t *roundToPage( uint8_t *p ) {
+    return (uint8_t *)(((uintptr_t)p + pageSize - 1) & ~(uintptr_t)(pageSize - 1));
+}
+
+/* Makes the stack accessible up to end */
+static void commitStack( uint8_t *end ) {
+    if (mprotect(stackCommitted, end - stackCommitted, PROT_READ | PROT_WRITE) != 0) {
+        fprintf(stderr, "unable to extend the JVM stack\n");
+        exit(1);
+    }
+    stackCommitted = end;
+}
+
+/* Handles a fault at addr: returns 1 if addr was in the part of the stack
+   not yet accessible, which has been extended, and 0 if addr is not in
+   the stack; exits if addr is in a guard area */
+int JVM_StackFault( void *addr ) {
+    uint8_t *a = addr;
+    uint8_t *end;
+
+    if (a < stackMapping || a >= stackEnd + STACK_GUARD_SIZE)
+        return 0;
+    if (a < (uint8_t *)JVM_Stack) {
+        fprintf(stderr, "stack underflow, execution terminated\n");
+        exit(1);
+    }
+    if (a >= stackEnd) {
+        fprintf(stderr, "stack overflow, execution must end\n");
+        exit(1);
+    }
+    if (a < stackCommitted)
+        return 0;
+    /* double the accessible part, at least up to addr */
+    end = stackCommitted + (stackCommitted - (uint8_t *)JVM_Stack);
+    if (end <= a)
+        end = roundToPage(a + 1);
+    if (end > stackEnd)
+        end = stackEnd;
+    commitStack(end);
+    numStackGrowths++;
+    return 1;
+}
+
 
 void JVM_Init( int stackSize ) {
     ClassInstance *x;
+    size_t maxBytes;
+
     JVM_StackSize = stackSize;
-    JVM_Stack = SafeCalloc(JVM_StackSize, sizeof(DataItem));
+    pageSize = sysconf(_SC_PAGESIZE);
+    maxBytes = (size_t)roundToPage((uint8_t *)((size_t)stackSize * sizeof(DataItem)));
+    stackMapping = mmap(NULL, maxBytes + 2*STACK_GUARD_SIZE, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stackMapping == MAP_FAILED) {
+        fprintf(stderr, "unable to allocate the JVM stack\n");
+        exit(1);
+    }
+    JVM_Stack = (DataItem *)(stackMapping + STACK_GUARD_SIZE);
+    stackCommitted = (uint8_t *)JVM_Stack;
+    stackEnd = stackCommitted + maxBytes;
+    commitStack(maxBytes < STACK_INITIAL_SIZE? stackEnd : stackCommitted + STACK_INITIAL_SIZE);
     JVM_StackLimit = JVM_Stack + JVM_StackSize - 1;
     JVM_Top = JVM_Stack;
+    /* a method with no locals and no stack can be called recursively
+       without using the JVM stack, so the frames need their own limit */
+    JVM_Frames = SafeCalloc(JVM_StackSize, sizeof(Frame));
+    JVM_FrameLimit = JVM_Frames + JVM_StackSize - 1;
+    JVM_FrameTop = JVM_Frames;
     JVM_Top->uval = UNINIT_PATTERN;  /* fake item on bottom of stack */
-    x = MyHeapAlloc(sizeof(ClassInstance));
+    x = MyHeapAlloc(sizeof(ClassInstance), CODE_INST);
     Fake_System_Out = x;
-    x->kind = CODE_INST;
     x->thisClass = NULL;
     x->instField[0].uval = 0;
+    RegisterGauge("jvm_frames", NULL, "Frames on the JVM stack", numFrames);
+    RegisterGauge("jvm_stack_accessible_bytes", NULL,
+        "Bytes of the JVM stack made accessible so far", stackAccessibleBytes);
 }
 
-void JVM_Push( uint32_t x ) {
-    if (JVM_Top >= JVM_StackLimit) {
+/* Creates a frame for a call of method m in class ct.  The arguments
+   are already on top of the stack and become the first local variables;
+   the remaining local variables are allocated and zeroed in one step.
+   The stack space needed by the method is checked once, here. */
+Frame *JVM_PushFrame( ClassType *ct, method_info *m ) {
+    Frame *f;
+    int extra = m->max_locals - m->nArgs;
+
+    if (extra < 0) extra = 0;
+    if (JVM_Top + extra + m->max_stack >= JVM_StackLimit
+            || JVM_FrameTop >= JVM_FrameLimit) {
         fprintf(stderr, "stack overflow, execution must end\n");
         exit(1);
     }
-    if (tracingExecution & TRACE_STACK)  // PRIX32 is defined in inttypes.h
-        printf("push 0x%" PRIX32 " onto stack; new height = %d\n",
-            (int)x, (int)(JVM_Top-JVM_Stack+1));
-    (++JVM_Top)->uval = x;
+    f = JVM_FrameTop + 1;
+    f->thisClass = ct;
+    f->method = m;
+    f->locals = JVM_Top + 1 - m->nArgs;  /* points locals at first arg */
+    f->pc = m->quickCode;
+    /* the frame is filled in before it becomes the top frame, which
+       the profiler's signal handler may read (see Profiler.c) */
+    atomic_signal_fence(memory_order_release);
+    JVM_FrameTop = f;
+    if (tracingExecution & TRACE_METHODS)
+        ProfileEnter(f);
+    memset(JVM_Top + 1, 0, extra * sizeof(DataItem));
+    JVM_Top += extra;
+    if (tracingExecution & TRACE_STACK) {
+        if (recordingEvents)
+            RecordEvent(EV_PUSH_FRAME, 0, 0, 0);
+        else
+            printf("push frame for method %s; new height = %d\n",
+                GetUTF8(ct->cf, m->name_index), (int)(JVM_Top-JVM_Stack));
+    }
+    return f;
 }
 
-void JVM_PushFloat( float x ) {
-    if (JVM_Top >= JVM_StackLimit) {
-        fprintf(stderr, "stack overflow, execution must end\n");
-        exit(1);
+
+/* Removes the frame of the current method.  Its result, which occupies
+   the top resultSize elements of the stack, is moved down to where the
+   method's first argument was. */
+void JVM_PopFrame( int resultSize ) {
+    DataItem *locals = JVM_FrameTop->locals;
+
+    if (tracingExecution & TRACE_METHODS)
+        ProfileExit(JVM_FrameTop);
+    if ((tracingExecution & TRACE_STACK) && recordingEvents)
+        RecordEvent(EV_POP_FRAME, 0, 0, resultSize);
+    if (resultSize > 0)
+        memmove(locals, JVM_Top + 1 - resultSize, resultSize * sizeof(DataItem));
+    JVM_Top = locals + resultSize - 1;
+    JVM_FrameTop--;
+    if ((tracingExecution & TRACE_STACK) && !recordingEvents)
+        printf("pop frame; new height = %d\n", (int)(JVM_Top-JVM_Stack));
+}
+
+
+/* Reports in the trace the push or pop (kind is EV_PUSH or EV_POP) of
+   the top item of the stack, which is of type 'i' (an int), 'f' or 'r'
+   (a reference); a push is reported after it is done, a pop before */
+static void traceItem( int kind, int type ) {
+    int pushed = (kind == EV_PUSH);
+
+    if (recordingEvents) {
+        RecordEvent(kind, 0, 0, JVM_Top->uval);
+        return;
     }
+    printf(pushed? "push " : "pop ");
+    if (type == 'f')
+        printf("%f", JVM_Top->fval);
+    else if (type == 'r')  // PRIX32 is defined in inttypes.h
+        printf("heap reference 0x%" PRIX32, JVM_Top->pval);
+    else
+        printf("0x%" PRIX32, JVM_Top->uval);
+    printf(" %s stack; new height = %d\n", pushed? "onto" : "from",
+        (int)(JVM_Top-JVM_Stack) - (pushed? 0 : 1));
+}
+
+void JVM_Push( uint32_t x ) {
+    (++JVM_Top)->uval = x;
     if (tracingExecution & TRACE_STACK)
-        printf("push %f onto stack; new height = %d\n",
-            x, (int)(JVM_Top-JVM_Stack+1));
+        traceItem(EV_PUSH, 'i');
+}
+
+void JVM_PushFloat( float x ) {
     (++JVM_Top)->fval = x;
+    if (tracingExecution & TRACE_STACK)
+        traceItem(EV_PUSH, 'f');
 }
 
 void JVM_PushReference( HeapPointer x ) {
-    if (JVM_Top >= JVM_StackLimit) {
-        fprintf(stderr, "stack overflow, execution must end\n");
-        exit(1);
-    }
     assert(x >= 0 && x < MaxHeapPtr);
-    if (tracingExecution & TRACE_STACK)  // PRIX32 is defined in inttypes.h
-        printf("push heap reference 0x%" PRIX32 " onto stack; new height = %d\n",
-            x, (int)(JVM_Top-JVM_Stack+1));
     (++JVM_Top)->pval = x;
+    if (tracingExecution & TRACE_STACK)
+        traceItem(EV_PUSH, 'r');
 }
 
 uint32_t JVM_Pop() {
-    if (JVM_Top <= JVM_Stack) {
-        fprintf(stderr, "stack underflow, execution terminated\n");
-        exit(1);
-    }
-    if (tracingExecution & TRACE_STACK)  // PRIX32 is defined in inttypes.h
-        printf("pop 0x%" PRIX32 " from stack; new height = %d\n",
-            JVM_Top->uval, (int)(JVM_Top-JVM_Stack-1));
+    if (tracingExecution & TRACE_STACK)
+        traceItem(EV_POP, 'i');
     return (JVM_Top--)->uval;
 }
 
 float JVM_PopFloat() {
-    if (JVM_Top <= JVM_Stack) {
-        fprintf(stderr, "stack underflow, execution terminated\n");
-        exit(1);
-    }
     if (tracingExecution & TRACE_STACK)
-        printf("pop %f from stack; new height = %d\n",
-            JVM_Top->fval, (int)(JVM_Top-JVM_Stack-1));
+        traceItem(EV_POP, 'f');
     return (JVM_Top--)->fval;
 }
 
 HeapPointer JVM_PopReference() {
-    if (JVM_Top <= JVM_Stack) {
-        fprintf(stderr, "stack underflow, execution terminated\n");
-        exit(1);
-    }
-    if (tracingExecution & TRACE_STACK)  // PRIX32 is defined in inttypes.h
-        printf("pop heap reference 0x%" PRIX32 " from stack; new height = %d\n",
-            JVM_Top->pval, (int)(JVM_Top-JVM_Stack-1));
+    if (tracingExecution & TRACE_STACK)
+        traceItem(EV_POP, 'r');
     HeapPointer result = (JVM_Top--)->pval;
     assert( result >= 0 && result < MaxHeapPtr);
     return result;
 }
 
-
+void PrintStackStatistics() {
+    printf("\nJVM Stack Statistics\n====================\n\n");
+    printf("  Maximum size = %ld bytes\n", (long)(stackEnd - (uint8_t *)JVM_Stack));
+    printf("  Accessible size = %ld bytes, after %d extensions\n",
+        (long)(stackCommitted - (uint8_t *)JVM_Stack), numStackGrowths);
+}
@@ -69,20 +69,56 @@ typedef struct {
 } ArrayOfSimple;
 
 
-/* a cheat implementation of strings on the heap */
+/* A string is stored entirely on the heap: the characters follow
+   the length, and a 0 byte follows the characters. */
 typedef struct {
     uint32_t kind;          /* holds the chars 'STRG' */
-    char *sval;
+    int32_t  length;        /* number of characters */
+    int32_t  hash;          /* hashCode(), or 0 if not computed yet */
+    char     chars[4];      /* storage is allocated for length+1 chars */
 } StringInstance;
 
-/* a cheat implementation of StringBuilder instances on the heap */
+/* StringBuilder instances; the capacity is the size of the char array */
 typedef struct {
     uint32_t kind;          /* holds the chars 'SBLD' */
-    uint32_t capacity;
-    uint32_t len;
-    char *buffer;
+    uint32_t len;           /* number of characters */
+    HeapPointer value;      /* an ArrayOfSimple of chars */
 } StringBuilderInstance;
 
+/* An exception of one of the classes of java/lang, thrown by the JVM
+   or created by the program (see Exceptions.c) */
+typedef struct {
+    uint32_t kind;          /* holds the chars 'EXCP' */
+    char *className;        /* as in java/lang/ArithmeticException */
+} ExceptionInstance;
+
+/* A method implemented in C; it takes its arguments from the stack
+   and leaves its result there (see NativeClasses.c) */
+typedef void (*NativeMethod)( void );
+
+/* The result of resolving a MethodRef constant used by an invoke op.
+   Each class has an array of these, indexed by the constant pool index
+   of the MethodRef.  The Java method is recorded only for invokestatic
+   and invokespecial, whose targets do not depend on the receiver; a
+   native method is recorded for any kind of invoke op. */
+typedef struct {
+    struct ClassType *owner;          /* class which implements the method */
+    method_info *m;                   /* NULL => not resolved yet */
+    NativeMethod native;              /* non-NULL => a method in C */
+    struct MethodProfile *profile;    /* of the method in C, for -TM */
+} ResolvedMethod;
+
+/* The cache for the checkcast and instanceof ops which refer to one
+   Class constant of a class (see InstanceOf in ClassResolver.c).  It
+   remembers the result of the test for the last class of object seen. */
+typedef struct {
+    uint8_t resolved;                 /* true => target has been resolved */
+    uint8_t lastResult;               /* result of the test for lastClass */
+    struct ClassType *target;         /* NULL => a class in java/... */
+    char *targetName;                 /* name of the target class */
+    struct ClassType *lastClass;      /* class of the last object tested */
+} TypeCheck;
+
 /* One instance of this struct is allocated on the heap for each
    reference type (a class or an array) that is loaded/created by the JVM.
    Some fields are used only if the type is a class, other fields only if
@@ -104,6 +140,14 @@ typedef struct ClassType {
     ClassFile *cf;                    /* the source file info */
     struct ClassType *parent;         /* super class */
     int numInstanceFields;            /* count of instance fields */
+    int numClassFields;               /* size of the classField array */
+    int depth;                        /* # superclasses, except Object */
+    struct ClassType **display;       /* display[i] = ancestor at depth i */
+    int numInterfaces;                /* size of the interfaces array */
+    struct ClassType **interfaces;    /* all interfaces, including inherited */
+    TypeCheck *typeChecks;            /* for checkcast/instanceof, by CP index */
+    ResolvedMethod *resolvedMethods;  /* targets of invoke ops */
+    HeapPointer *internedStrings;     /* strings created by ldc, by CP index */
     DataItem classField[1];           /* storage for static fields */
 } ClassType;
 
@@ -118,12 +162,25 @@ typedef struct {
 } ClassInstance;
 
 
+/* One instance of this struct describes each active invocation of a
+   Java method.  The frames are kept in an array which grows in step with
+   the JVM stack; the local variables and the operand stack of a frame
+   occupy consecutive elements of the JVM stack, starting at locals. */
+typedef struct Frame {
+    ClassType   *thisClass;     /* class which implements the method */
+    method_info *method;        /* the method being executed */
+    DataItem    *locals;        /* local variable #0 of the method */
+    uint8_t     *pc;            /* where execution resumes after a call */
+} Frame;
+
+
 #define CODE_ARRA (0x41525241)   /* the 4 characters 'ARRA' */
 #define CODE_ARRS (0x41525253)   /* the 4 characters 'ARRS' */
 #define CODE_CLAS (0x434C4153)   /* the 4 characters 'CLAS' */
 #define CODE_INST (0x494E5354)   /* the 4 characters 'INST' */
 #define CODE_STRG (0x53545247)   /* the 4 characters 'STRG' */
 #define CODE_SBLD (0x53424C44)   /* the 4 characters 'SBLD' */
+#define CODE_EXCP (0x45584350)   /* the 4 characters 'EXCP' */
 
 
 /* These are all the JVM opcodes in alphabetic order*/
@@ -175,11 +232,53 @@ typedef enum { OP_aaload=0X32, OP_aastore=0X53, OP_aconst_null=0X01, OP_aload=0X
 } JVM_Opcode;
 
 
+/* These opcodes are used only in the pre-decoded copy of a method's
+   bytecode (see Predecode.c).  They take values which are unassigned in
+   the JVM specification, and each one occupies the same number of bytes
+   as the instruction it replaces. */
+typedef enum {
+    OP_getfield_inline=0Xcb,    /* replaces a call of a trivial getter */
+    OP_getfield2_inline=0Xcc,   /* ... of a getter for a long or double */
+    OP_putfield_inline=0Xcd,    /* replaces a call of a trivial setter */
+    OP_putfield2_inline=0Xce,   /* ... of a setter for a long or double */
+    OP_init_inline=0Xcf,        /* replaces a call of an empty constructor */
+    OP_tableswitch_quick=0Xd0,  /* a tableswitch, or a dense lookupswitch,
+                                   with its table in native byte order */
+    OP_lookupswitch_quick=0Xd1, /* a lookupswitch with its pairs in native
+                                   byte order, searched by bisection */
+    OP_arrayloop_quick=0Xd2,    /* replaces the iload at the head of a copy
+                                   or fill loop */
+    /* array accesses which need no null or bounds check, in the order
+       of OP_iaload..OP_saload and OP_iastore..OP_sastore */
+    OP_iaload_quick=0Xd3, OP_laload_quick=0Xd4, OP_faload_quick=0Xd5,
+    OP_daload_quick=0Xd6, OP_aaload_quick=0Xd7, OP_baload_quick=0Xd8,
+    OP_caload_quick=0Xd9, OP_saload_quick=0Xda,
+    OP_iastore_quick=0Xdb, OP_lastore_quick=0Xdc, OP_fastore_quick=0Xdd,
+    OP_dastore_quick=0Xde, OP_aastore_quick=0Xdf, OP_bastore_quick=0Xe0,
+    OP_castore_quick=0Xe1, OP_sastore_quick=0Xe2,
+    /* array accesses whose array is known not to be null, which only
+       check the index, in the same order */
+    OP_iaload_nonnull=0Xe3, OP_laload_nonnull=0Xe4, OP_faload_nonnull=0Xe5,
+    OP_daload_nonnull=0Xe6, OP_aaload_nonnull=0Xe7, OP_baload_nonnull=0Xe8,
+    OP_caload_nonnull=0Xe9, OP_saload_nonnull=0Xea,
+    OP_iastore_nonnull=0Xeb, OP_lastore_nonnull=0Xec, OP_fastore_nonnull=0Xed,
+    OP_dastore_nonnull=0Xee, OP_aastore_nonnull=0Xef, OP_bastore_nonnull=0Xf0,
+    OP_castore_nonnull=0Xf1, OP_sastore_nonnull=0Xf2,
+    OP_arraylength_quick=0Xf3   /* an arraylength of an array known not
+                                   to be null */
+} JVM_QuickOpcode;
+
+
+extern DataItem *JVM_Stack;
 extern DataItem *JVM_Top;
+extern Frame *JVM_Frames;
+extern Frame *JVM_FrameTop;
 extern void *HeapReferencePointer;
 extern void *Fake_System_Out;
 
 extern void JVM_Init( int stackSize );
+extern Frame *JVM_PushFrame( ClassType *ct, method_info *m );
+extern void JVM_PopFrame( int resultSize );
 extern void JVM_Push( uint32_t x );
 extern void JVM_PushFloat( float x );
 extern void JVM_PushReference( HeapPointer x );
@@ -187,6 +286,8 @@ extern void JVM_PushReference( HeapPointer x );
 extern uint32_t JVM_Pop();
 extern float JVM_PopFloat();
 extern HeapPointer JVM_PopReference();
+extern int JVM_StackFault( void *addr );
+extern void PrintStackStatistics();
 
 #endif
 
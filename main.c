@@ -11,11 +11,24 @@
 #include "jvm.h"
 #include "InterpretLoop.h"
 #include "ClassResolver.h"
+#include "Predecode.h"
+#include "JIT.h"
+#include "Exceptions.h"
+#include "ArrayOps.h"
+#include "BoundsCheck.h"
+#include "NativeClasses.h"
 #include "Verifier.h"
 #include "TraceOptions.h"
+#include "EventTrace.h"
+#include "Profiler.h"
+#include "MethodProfile.h"
+#include "PerfCounters.h"
+#include "Timeline.h"
+#include "Metrics.h"
 #include "MyAlloc.h"
 
 static char *pgmName = NULL;
+static uint8_t CFlag = 0;
 
 static char *usageText[] = {
     "Usage:",
@@ -24,6 +37,8 @@ static char *usageText[] = {
     "\t-D\tprint the disassembled classfile",
     "\t-X\tsuppress execution of the classfile",
     "\t-W\tsuppress runtime warning messages",
+    "\t-V\tdo not verify the bytecode of the classes loaded",
+    "\t-B\twrite System.out output at the end of every line",
     "\t-T\ttrace everything",
     "\t-To\ttrace execution of the bytecode ops",
     "\t-Tc\ttrace class loads",
@@ -32,8 +47,25 @@ static char *usageText[] = {
     "\t-Ts\ttrace most stack pushes/pops",
     "\t-Th\ttrace heap usage and gc",
     "\t-Tv\ttrace bytecode verificaton",
+    "\t-TI\ttrace inline caches at invokevirtual sites",
+    "\t-TJ\ttrace the JIT compiler",
+    "\t-TL\tprint the number of iterations of each loop",
+    "\t-TM\tprint the calls and times of each method",
+    "\t-J[nnn]\tcompile methods to machine code after nnn calls",
+    "\t-Jd[nnn]\tas -J, and check compiled code against the interpreter",
     "\t-Snnn\tset max stack size to nnn entries",
     "\t-Hnnn\tset heap size to nnn bytes",
+    "\t-Rfile\trecord the trace selected by -To, -Ti, -Ts and -Th in file,",
+    "\t\tin binary (see TraceDecode)",
+    "\t-Fname\trecord only methods whose name (Class.method) contains name",
+    "\t-Pfile\twrite a sampling profile to file, as collapsed stacks",
+    "\t-Mfile\tas -TM, and write the table to file (JSON if file ends in .json)",
+    "\t-C\tcount hardware events (cycles, cache misses, ...) in each phase",
+    "\t-Cm\tas -C, and count them in each method too (implies -TM)",
+    "\t-Lfile\twrite a timeline of class loads, <clinit>s and gcs to file,",
+    "\t\tas Chrome trace events",
+    "\t-Nfile\twrite the runtime metrics to file at exit and on SIGUSR1,",
+    "\t\tin Prometheus text format (JSON if file ends in .json)",
     NULL
 };
 
@@ -71,24 +103,41 @@ static void callMain( ClassType *ct, int stackSize, int heapSize,
 
 
     // allocate an array for the command line arguments
-    arr = MyHeapAlloc(sizeof(ArrayOfRef)+(jArgCnt-1)*4);
-    arr->kind = CODE_ARRA;
+    arr = MyHeapAlloc(sizeof(ArrayOfRef)+(jArgCnt-1)*4, CODE_ARRA);
     arr->size = jArgCnt;
     ClassType *cta = ResolveClassReferenceByName( "java/lang/String" );
     arr->classRef =  cta==NULL? NULL_HEAP_REFERENCE : MAKE_HEAP_REFERENCE(cta);
     JVM_PushReference(MAKE_HEAP_REFERENCE(arr));
-    for( i = 0;  i < jArgCnt;  i++ ) {
-        StringInstance *p;
-        p = MyHeapAlloc(sizeof(StringInstance));
-        p->kind = CODE_STRG;
-        p->sval = jArgs[i];
-        arr->elements[i] = MAKE_HEAP_REFERENCE(p);
-    }
+    for( i = 0;  i < jArgCnt;  i++ )
+        arr->elements[i] = AllocateString(jArgs[i], strlen(jArgs[i]));
 
+    TimelineBegin("execution", "main %s", ct->cf->cname);
+    PerfEnterPhase(PHASE_EXECUTE);
     InvokeMethod(ct,m,1);
+    PerfEnterPhase(PHASE_OTHER);
+    TimelineEnd();
+    FlushSystemOut();
 
-    if (tracingExecution & TRACE_HEAP)
+    if (tracingExecution & TRACE_HEAP) {
         PrintHeapUsageStatistics();
+        PrintInternStatistics();
+        PrintStackStatistics();
+    }
+    if (CFlag)
+        PrintPerfCounterStatistics();
+    if (tracingExecution & TRACE_ICACHE)
+        PrintInlineCacheStatistics();
+    if (tracingExecution & TRACE_INVOKES) {
+        PrintPredecodeStatistics();
+        PrintExceptionStatistics();
+        PrintArrayOpStatistics();
+    }
+    if (tracingExecution & TRACE_VERIFY)
+        PrintBoundsCheckStatistics();
+    if ((tracingExecution & TRACE_JIT) && JitThreshold > 0)
+        PrintJITStatistics();
+    if (tracingExecution & TRACE_LOOPS)
+        PrintLoopProfile();
     if (tracingExecution & TRACE_CLASS_LOADS)
         PrintFilesRead();
 }
@@ -100,7 +149,11 @@ int main( int argc, char *argv[] ) {
     int stackSize = 1024;
     int heapSize = 10240;
     ClassType *ct;
-    uint8_t DFlag = 0, XFlag = 0;
+    int jitThreshold = 0, jitDifferential = 0;
+    uint8_t DFlag = 0, XFlag = 0, BFlag = 0;
+    char *traceFile = NULL, *traceFilter = NULL, *profileFile = NULL;
+    char *methodProfileFile = NULL, *timelineFile = NULL, *metricsFile = NULL;
+    int perMethodCounts = 0;
 
     pgmName = argv[0];
     for( argNum=1; argNum<argc; argNum++ ) {
@@ -109,7 +162,9 @@ int main( int argc, char *argv[] ) {
             switch(*++cp) {
             case 'D':   DFlag = 1;  break;
             case 'W':   showWarnings = 0;  break;
+            case 'V':   verifyingClasses = 0;  break;
             case 'X':   XFlag = 1;  break;
+            case 'B':   BFlag = 1;  break;
             case 'T':   if (*++cp == '\0') {
                             tracingExecution = TRACE_ALL;
                         } else while(*cp != '\0') {
@@ -128,10 +183,48 @@ int main( int argc, char *argv[] ) {
                                 tracingExecution |= TRACE_HEAP;
                             else if (c == 'v')
                                 tracingExecution |= TRACE_VERIFY;
+                            else if (c == 'I')
+                                tracingExecution |= TRACE_ICACHE;
+                            else if (c == 'J')
+                                tracingExecution |= TRACE_JIT;
+                            else if (c == 'L')
+                                tracingExecution |= TRACE_LOOPS;
+                            else if (c == 'M')
+                                tracingExecution |= TRACE_METHODS;
                         }
                         break;
+            case 'J':   if (*++cp == 'd') {
+                            jitDifferential = 1;  cp++;
+                        }
+                        jitThreshold = (*cp == '\0')?
+                            JIT_DEFAULT_THRESHOLD : atoi(cp);
+                        if (jitThreshold <= 0) usage();
+                        break;
             case 'S':   stackSize = atoi(cp+1);  break;
             case 'H':   heapSize = atoi(cp+1);  break;
+            case 'R':   traceFile = cp+1;
+                        if (*traceFile == '\0') usage();
+                        break;
+            case 'F':   traceFilter = cp+1;  break;
+            case 'M':   methodProfileFile = cp+1;
+                        if (*methodProfileFile == '\0') usage();
+                        tracingExecution |= TRACE_METHODS;
+                        break;
+            case 'C':   CFlag = 1;
+                        if (*++cp == 'm') {
+                            perMethodCounts = 1;
+                            tracingExecution |= TRACE_METHODS;
+                        } else if (*cp != '\0') usage();
+                        break;
+            case 'L':   timelineFile = cp+1;
+                        if (*timelineFile == '\0') usage();
+                        break;
+            case 'N':   metricsFile = cp+1;
+                        if (*metricsFile == '\0') usage();
+                        break;
+            case 'P':   profileFile = cp+1;
+                        if (*profileFile == '\0') usage();
+                        break;
             default:    usage();
             }
         } else {
@@ -143,11 +236,30 @@ int main( int argc, char *argv[] ) {
     // main method of the Java program
 
     if (classname == NULL) usage();
+    if (traceFilter != NULL && traceFile == NULL) usage();
 
+    if (traceFile != NULL)
+        InitEventTrace(traceFile, traceFilter);
     InitMyAlloc(heapSize);
+    InstallFaultHandler();
     JVM_Init(stackSize);
+    InitNativeClasses();
+    SetSystemOutLineMode(BFlag);
+    JIT_Init(jitThreshold, jitDifferential);
     InitVerifier();
+    RegisterClassFileMetrics();
+    RegisterResolverMetrics();
 
+    if (CFlag)
+        InitPerfCounters(perMethodCounts);
+    if (tracingExecution & TRACE_METHODS)
+        InitMethodProfile(stackSize, methodProfileFile);
+    if (profileFile != NULL)
+        StartProfiler(profileFile);
+    if (timelineFile != NULL)
+        InitTimeline(timelineFile);
+    if (metricsFile != NULL)
+        InitMetrics(metricsFile);
     printf("Reading class %s ...\n", classname);
     ct = LoadClass(classname);
     if (ct != NULL) {